@@ -1,105 +1,604 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
-#include <vector>
+#include <map>
+#include <regex>
+#include <sstream>
 #include <string>
-#include <chrono>
-#include <random>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#define close _close
+#define read _read
+#else
+#include <unistd.h>
+#endif
+
+// Benchmarks the production render path: the same Renderer, kernels, downscaler and diff
+// encoder the live loop uses, on a synthetic desktop. It only times them; that they agree
+// with their references is checked by tests/render_tests.cpp.
+//
+// Build with optimizations, record a baseline on this machine, and compare later runs with it:
+//   cmake -S . -B build -DCMAKE_BUILD_TYPE=Release
+//   cmake --build build --target bench-baseline
+//   cmake --build build --target bench-check
+// or run build/bench directly:
+//   --baseline <file>        fail (exit 1) if a case's min and median both regressed past the tolerance
+//   --write-baseline <file>  store this run as the new baseline
+//   --tolerance <fraction>   allowed slowdown (default 0.25)
+//   --filter <text>          only run cases whose name contains <text>
+#include "color.h"
+#include "diff_output.h"
+#include "dither.h"
+#include "downscale.h"
+#include "glyph_table.h"
+#include "luma_kernels.h"
+#include "render.h"
+#include "synthetic_desktop.h"
+#include "thread_pool.h"
+#include "tile_hash.h"
+#include "tone.h"
+
+// Cell grids: a classic terminal, the default grid, and a large terminal on a 4K screen
+const Geometry GRIDS[] = {{80, 24}, {240, 80}, {400, 120}};
+
+// Each case gets this much warmup, then samples until both limits below are met
+const double WARMUP_SECONDS = 0.05;
+const double SAMPLE_SECONDS = 0.25;
+const size_t MIN_SAMPLES = 30;
+const size_t MAX_SAMPLES = 5000;
 
-const int CONSOLE_WIDTH = 240;
-const int CONSOLE_HEIGHT = 80;
-const std::string ASCII_RAMP = "@%#*+=-:. ";
+// Cases this close to the baseline are never reported, whatever the ratio (timer noise)
+const double MIN_REGRESSION_US = 1.0;
 
-// Baseline implementation
-void baseline(const std::vector<unsigned char>& src_data, std::string& output) {
-    output.clear(); // We start with empty string, but reallocation might happen if we don't reserve/reuse correctly in the loop context
-    // In the real app, "std::string ascii_frame" is declared INSIDE the loop, so it's fresh every time.
-    // To simulate that cost, we should probably construct it here, or just clear it but not reserve?
-    // Actually, the current code DOES reserve: "ascii_frame.reserve(...)".
+// Times a case that looks regressed is measured again before it is reported
+const int REGRESSION_RETRIES = 2;
 
-    std::string ascii_frame;
-    ascii_frame.reserve((CONSOLE_WIDTH + 1) * CONSOLE_HEIGHT);
+// Baseline timings of one case
+struct Baseline {
+    double min_us;
+    double median_us;
+};
 
-    for (int y = 0; y < CONSOLE_HEIGHT - 1; ++y) {
-        const size_t row_offset = static_cast<size_t>(y) * CONSOLE_WIDTH * 4;
-        for (int x = 0; x < CONSOLE_WIDTH; ++x) {
-            const size_t pixel_offset = row_offset + (x * 4);
-            const unsigned char b = src_data[pixel_offset];
-            const unsigned char g = src_data[pixel_offset + 1];
-            const unsigned char r = src_data[pixel_offset + 2];
+struct Result {
+    std::string name;
+    double min_us;
+    double median_us;
+    double p99_us;
+    size_t samples;
+};
 
-            const unsigned int gray = (static_cast<unsigned int>(r) * 13933 +
-                                       static_cast<unsigned int>(g) * 46871 +
-                                       static_cast<unsigned int>(b) * 4732) >> 16;
+/**
+ * @brief Times `fn` once per sample after a warmup and summarizes the distribution.
+ */
+template <typename Fn>
+Result measure(const std::string& name, Fn&& fn) {
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point warmup_end = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                                            std::chrono::duration<double>(WARMUP_SECONDS));
+    do {
+        fn();
+    } while (Clock::now() < warmup_end);
 
-            const int ramp_index = (gray * (ASCII_RAMP.length() - 1)) / 255;
-            ascii_frame += ASCII_RAMP[ramp_index];
+    std::vector<double> samples;
+    samples.reserve(MAX_SAMPLES);
+    double total = 0.0;
+    while (samples.size() < MAX_SAMPLES && (samples.size() < MIN_SAMPLES || total < SAMPLE_SECONDS * 1e6)) {
+        const Clock::time_point start = Clock::now();
+        fn();
+        const double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        samples.push_back(us);
+        total += us;
+    }
+    std::sort(samples.begin(), samples.end());
+    const size_t n = samples.size();
+    const size_t p99 = static_cast<size_t>(std::ceil(0.99 * n)) - 1;
+    return {name, samples.front(), samples[n / 2], samples[p99], n};
+}
+
+/**
+ * @brief Pipe whose read end is drained by a thread, so writes cost what a terminal's pty would
+ * (a copy into the kernel and a wake-up) rather than what the null device does (nothing).
+ */
+class OutputPipe {
+public:
+    OutputPipe() = default;
+    ~OutputPipe() {
+        if (write_) std::fclose(write_);
+        if (drain_.joinable()) drain_.join();
+    }
+    OutputPipe(const OutputPipe&) = delete;
+    OutputPipe& operator=(const OutputPipe&) = delete;
+
+    bool open() {
+        int fds[2];
+#ifdef _WIN32
+        if (_pipe(fds, 1 << 16, _O_BINARY) != 0) return false;
+#else
+        if (pipe(fds) != 0) return false;
+#endif
+        write_ = fdopen(fds[1], "wb");
+        if (!write_) {
+            close(fds[0]);
+            close(fds[1]);
+            return false;
         }
-        ascii_frame += '\n';
+        const int read_fd = fds[0];
+        drain_ = std::thread([read_fd] {
+            char buffer[1 << 16];
+            while (read(read_fd, buffer, sizeof(buffer)) > 0) {
+            }
+            close(read_fd);
+        });
+        return true;
     }
-    output = ascii_frame;
+
+    std::FILE* file() { return write_; }
+
+private:
+    std::FILE* write_ = nullptr;
+    std::thread drain_;
+};
+
+std::string grid_name(const Geometry& grid) {
+    return std::to_string(grid.width) + "x" + std::to_string(grid.height);
 }
 
-// Optimization: Lookup table + Buffer reuse
-void optimized(const std::vector<unsigned char>& src_data, std::string& buffer, const std::vector<char>& lookup_table) {
-    buffer.clear();
-    // Assuming buffer is already reserved outside.
+// Timings by case name from a baseline written by --write-baseline
+bool load_baseline(const std::string& path, std::map<std::string, Baseline>& cases) {
+    std::ifstream file(path);
+    if (!file) return false;
+    std::stringstream text;
+    text << file.rdbuf();
+    const std::string json = text.str();
+    const std::regex entry("\"([^\"]+)\"\\s*:\\s*\\{\\s*\"min_us\"\\s*:\\s*([-+0-9.eE]+)\\s*,"
+                           "\\s*\"median_us\"\\s*:\\s*([-+0-9.eE]+)");
+    for (std::sregex_iterator it(json.begin(), json.end(), entry), end; it != end; ++it) {
+        cases[(*it)[1]] = {std::strtod((*it)[2].str().c_str(), nullptr), std::strtod((*it)[3].str().c_str(), nullptr)};
+    }
+    return true;
+}
 
-    for (int y = 0; y < CONSOLE_HEIGHT - 1; ++y) {
-        const size_t row_offset = static_cast<size_t>(y) * CONSOLE_WIDTH * 4;
-        for (int x = 0; x < CONSOLE_WIDTH; ++x) {
-            const size_t pixel_offset = row_offset + (x * 4);
-            // We can also optimize pixel access by pointers? Maybe later.
-            const unsigned char b = src_data[pixel_offset];
-            const unsigned char g = src_data[pixel_offset + 1];
-            const unsigned char r = src_data[pixel_offset + 2];
+/**
+ * @brief True if `r` is slower than `base` by more than `tolerance` in both its min and median.
+ * Noise from other processes only ever adds time, so a real regression moves the minimum as
+ * well as the median; requiring both keeps a busy machine from failing.
+ */
+bool regressed(const Result& r, const Baseline& base, double tolerance) {
+    return r.min_us > base.min_us * (1.0 + tolerance) + MIN_REGRESSION_US &&
+           r.median_us > base.median_us * (1.0 + tolerance) + MIN_REGRESSION_US;
+}
 
-            const unsigned int gray = (static_cast<unsigned int>(r) * 13933 +
-                                       static_cast<unsigned int>(g) * 46871 +
-                                       static_cast<unsigned int>(b) * 4732) >> 16;
+bool write_baseline(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream file(path);
+    file << std::fixed << std::setprecision(2) << "{\n  \"cases\": {\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        file << "    \"" << r.name << "\": {\"min_us\": " << r.min_us << ", \"median_us\": " << r.median_us
+             << ", \"p99_us\": " << r.p99_us << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  }\n}\n";
+    return static_cast<bool>(file);
+}
 
-            buffer += lookup_table[gray];
+int main(int argc, char* argv[]) {
+    std::string baseline_path;
+    std::string write_path;
+    std::string filter;
+    double tolerance = 0.25;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 < argc && arg == "--baseline") {
+            baseline_path = argv[++i];
+        } else if (i + 1 < argc && arg == "--write-baseline") {
+            write_path = argv[++i];
+        } else if (i + 1 < argc && arg == "--tolerance") {
+            tolerance = std::strtod(argv[++i], nullptr);
+        } else if (i + 1 < argc && arg == "--filter") {
+            filter = argv[++i];
+        } else {
+            std::cerr << "Usage: bench [--baseline <file>] [--write-baseline <file>] [--tolerance <fraction>]"
+                         " [--filter <text>]\n";
+            return 2;
         }
-        buffer += '\n';
     }
-}
+#if defined(__GNUC__) && !defined(__OPTIMIZE__)
+    std::cerr << "Warning: built without optimizations; configure with -DCMAKE_BUILD_TYPE=Release.\n";
+#endif
 
-int main() {
-    // Setup data
-    std::vector<unsigned char> src_data(CONSOLE_WIDTH * CONSOLE_HEIGHT * 4);
-    std::mt19937 rng(42);
-    std::uniform_int_distribution<int> dist(0, 255);
-    for (auto& byte : src_data) byte = static_cast<unsigned char>(dist(rng));
+    const char* kernel_name = nullptr;
+    select_ascii_row_kernel(&kernel_name);
+    // The threads-N cases only show scaling up to this many
+    std::cout << "Conversion kernel: " << kernel_name << ", " << std::thread::hardware_concurrency()
+              << " hardware thread(s)\n\n";
 
-    // Precompute lookup table
-    std::vector<char> lookup_table(256);
-    for (int i = 0; i < 256; ++i) {
-        lookup_table[i] = ASCII_RAMP[(i * (ASCII_RAMP.length() - 1)) / 255];
+    const std::vector<unsigned char> desktop = synthetic_desktop(0);
+    const std::vector<unsigned char> desktop_next = synthetic_desktop(1);
+    const ImageView desktop_view = {desktop.data(), DESKTOP_WIDTH, DESKTOP_HEIGHT,
+                                   static_cast<size_t>(DESKTOP_WIDTH) * 4};
+    const ImageView desktop_next_view = {desktop_next.data(), DESKTOP_WIDTH, DESKTOP_HEIGHT,
+                                        static_cast<size_t>(DESKTOP_WIDTH) * 4};
+    // The same desktop as a decoder would hand it over: packed RGB, no alpha
+    std::vector<unsigned char> desktop_rgb(static_cast<size_t>(DESKTOP_WIDTH) * DESKTOP_HEIGHT * 3);
+    for (size_t i = 0; i < desktop_rgb.size() / 3; ++i) {
+        desktop_rgb[i * 3] = desktop[i * 4 + 2];
+        desktop_rgb[i * 3 + 1] = desktop[i * 4 + 1];
+        desktop_rgb[i * 3 + 2] = desktop[i * 4];
     }
+    const ImageView desktop_rgb_view = {desktop_rgb.data(), DESKTOP_WIDTH, DESKTOP_HEIGHT,
+                                       static_cast<size_t>(DESKTOP_WIDTH) * 3, PixelFormat::Rgb24};
 
-    std::string result_baseline;
-    std::string result_optimized;
-    result_optimized.reserve((CONSOLE_WIDTH + 1) * CONSOLE_HEIGHT);
+    ThreadPool pool;
+    AreaDownscaler scaler(&pool);
+    std::vector<Result> results;
+    int status = 0;
+    std::map<std::string, Baseline> baseline;
+    if (!baseline_path.empty() && !load_baseline(baseline_path, baseline)) {
+        std::cerr << "Error: Cannot read baseline '" << baseline_path
+                  << "'; record one first with --write-baseline (the bench-baseline target)." << std::endl;
+        return 1;
+    }
+    auto run = [&](const std::string& name, auto&& fn) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) return;
+        results.push_back(measure(name, fn));
+        // A burst of load from elsewhere can cover one case's whole sampling window; keep the
+        // better of a few tries before calling it a regression
+        auto it = baseline.find(name);
+        for (int retry = 0; it != baseline.end() && retry < REGRESSION_RETRIES &&
+                            regressed(results.back(), it->second, tolerance);
+             ++retry) {
+            const Result again = measure(name, fn);
+            if (again.median_us < results.back().median_us) results.back() = again;
+        }
+        const Result& r = results.back();
+        std::cout << std::left << std::setw(34) << r.name << std::right << std::fixed << std::setprecision(1)
+                  << " min " << std::setw(9) << r.min_us << " us  median " << std::setw(9) << r.median_us
+                  << " us  p99 " << std::setw(9) << r.p99_us << " us  (" << r.samples << " samples)" << std::endl;
+    };
 
-    const int ITERATIONS = 1000;
+    // The live loop's status bar, so frames have the same shape as on screen
+    const std::string status_line = " [ AsciiScreen ] Mode: normal | FPS: 60 | [P]ause [Q]uit";
+    std::vector<char> buffer;
+    for (const Geometry& grid : GRIDS) {
+        const std::string size = grid_name(grid);
+        std::vector<unsigned char> cells(static_cast<size_t>(grid.width) * grid.height * 4);
+        std::vector<unsigned char> cells_next(cells.size());
+        // As in the live loop, the last row of the capture lies under the status bar
+        const ImageView picture = {cells.data(), grid.width, grid.height - 1, static_cast<size_t>(grid.width) * 4};
+        const ImageView picture_next = {cells_next.data(), grid.width, grid.height - 1,
+                                       static_cast<size_t>(grid.width) * 4};
+
+        run("scale/" + size, [&] { scaler.scale(desktop_view, grid.width, grid.height, cells.data()); });
+        run("scale/rgb24/" + size, [&] { scaler.scale(desktop_rgb_view, grid.width, grid.height, cells.data()); });
+        scaler.scale(desktop_view, grid.width, grid.height, cells.data());
+        scaler.scale(desktop_next_view, grid.width, grid.height, cells_next.data());
+
+        // Every ramp, through the renderer into a caller-provided buffer
+        for (const AsciiRamp& ramp : ASCII_RAMPS) {
+            Renderer renderer(ramp.glyphs);
+            buffer.resize(renderer.max_frame_bytes(picture.width, picture.height, true));
+            run(std::string("convert/") + ramp.name + "/" + size,
+                [&] { renderer.render(picture, buffer.data(), buffer.size(), &status_line); });
+        }
+
+        struct ColorCase { const char* name; ColorMode mode; };
+        for (const ColorCase& c : {ColorCase{"16", ColorMode::Ansi16}, ColorCase{"256", ColorMode::Ansi256},
+                                   ColorCase{"truecolor", ColorMode::Rgb24}}) {
+            Renderer renderer(find_ramp("normal")->glyphs, GlyphEncoding::Utf8, c.mode);
+            buffer.resize(renderer.max_frame_bytes(picture.width, picture.height, true));
+            run(std::string("convert/color-") + c.name + "/" + size,
+                [&] { renderer.render(picture, buffer.data(), buffer.size(), &status_line); });
+        }
+
+        // Change detection: hashing a frame, then hashing and converting one where nothing
+        // changed or one tile did (a ticking clock on a dashboard), against convert/normal
+        {
+            TileHasher tiles;
+            run("tiles/hash/" + size, [&] { tiles.update(picture); });
+            Renderer renderer(find_ramp("normal")->glyphs);
+            buffer.resize(renderer.max_frame_bytes(picture.width, picture.height, true));
+            tiles.update(picture);
+            renderer.render(picture, tiles, buffer.data(), buffer.size(), &status_line);
+            run("convert/unchanged/" + size, [&] {
+                tiles.update(picture);
+                renderer.render(picture, tiles, buffer.data(), buffer.size(), &status_line);
+            });
+            std::vector<unsigned char> ticking(cells);
+            const ImageView ticking_view = {ticking.data(), picture.width, picture.height, picture.stride};
+            run("convert/one-tile/" + size, [&] {
+                ticking[0] ^= 0xFF;
+                tiles.update(ticking_view);
+                renderer.render(ticking_view, tiles, buffer.data(), buffer.size(), &status_line);
+            });
+        }
 
-    // Benchmark Baseline
-    auto start = std::chrono::high_resolution_clock::now();
-    for (int i = 0; i < ITERATIONS; ++i) {
-        baseline(src_data, result_baseline);
+        // Dithering the shortest ramp, to compare with convert/minimalist
+        struct DitherCase { const char* name; DitherMode mode; };
+        for (const DitherCase& c : {DitherCase{"bayer", DitherMode::Bayer},
+                                    DitherCase{"fs", DitherMode::FloydSteinberg}}) {
+            Renderer renderer(find_ramp("minimalist")->glyphs);
+            renderer.set_dither(c.mode, &pool);
+            buffer.resize(renderer.max_frame_bytes(picture.width, picture.height, true));
+            run(std::string("convert/dither-") + c.name + "/" + size,
+                [&] { renderer.render(picture, buffer.data(), buffer.size(), &status_line); });
+        }
+
+        // Contrast stretch: the histogram counted during conversion, against convert/normal
+        struct ToneCase { const char* name; ToneMode mode; };
+        for (const ToneCase& c : {ToneCase{"auto", ToneMode::Auto}, ToneCase{"equalize", ToneMode::Equalize}}) {
+            Renderer renderer(find_ramp("normal")->glyphs);
+            renderer.set_tone(c.mode, true);
+            buffer.resize(renderer.max_frame_bytes(picture.width, picture.height, true));
+            run(std::string("convert/contrast-") + c.name + "/" + size,
+                [&] { renderer.render(picture, buffer.data(), buffer.size(), &status_line); });
+        }
+
+        // Sub-cell modes: several pixels per cell, classified or packed into one glyph
+        struct CellCase { const char* name; CellMode cells; ColorMode color; };
+        for (const CellCase& c : {CellCase{"shapes", CellMode::Shape, ColorMode::Mono},
+                                  CellCase{"braille", CellMode::Braille, ColorMode::Mono},
+                                  CellCase{"halfblock", CellMode::HalfBlock, ColorMode::Mono},
+                                  CellCase{"halfblock-truecolor", CellMode::HalfBlock, ColorMode::Rgb24}}) {
+            Renderer renderer(find_ramp("normal")->glyphs, GlyphEncoding::Utf8, c.color, ColorLayer::Foreground, c.cells);
+            const Geometry samples = renderer.image_size(grid);
+            std::vector<unsigned char> sampled(static_cast<size_t>(samples.width) * samples.height * 4);
+            scaler.scale(desktop_view, samples.width, samples.height, sampled.data());
+            const ImageView sampled_picture = {sampled.data(), samples.width, samples.height - renderer.cell_height(),
+                                              static_cast<size_t>(samples.width) * 4};
+            buffer.resize(renderer.max_frame_bytes(sampled_picture.width, sampled_picture.height, true));
+            run(std::string("convert/") + c.name + "/" + size,
+                [&] { renderer.render(sampled_picture, buffer.data(), buffer.size(), &status_line); });
+        }
+
+        // Conversion split into bands over 1, 2 and 4 threads
+        for (const CellCase& c : {CellCase{"truecolor", CellMode::Ramp, ColorMode::Rgb24},
+                                  CellCase{"shapes", CellMode::Shape, ColorMode::Mono},
+                                  CellCase{"braille", CellMode::Braille, ColorMode::Mono}}) {
+            Renderer renderer(find_ramp("normal")->glyphs, GlyphEncoding::Utf8, c.color, ColorLayer::Foreground, c.cells);
+            const Geometry samples = renderer.image_size(grid);
+            std::vector<unsigned char> sampled(static_cast<size_t>(samples.width) * samples.height * 4);
+            scaler.scale(desktop_view, samples.width, samples.height, sampled.data());
+            const ImageView sampled_picture = {sampled.data(), samples.width, samples.height - renderer.cell_height(),
+                                              static_cast<size_t>(samples.width) * 4};
+            buffer.resize(renderer.max_frame_bytes(sampled_picture.width, sampled_picture.height, true));
+            double one_thread_us = 0.0;
+            for (size_t threads : {1, 2, 4}) {
+                ThreadPool convert_pool(threads);
+                renderer.set_pool(&convert_pool);
+                const std::string name = std::string("convert/threads-") + std::to_string(threads) + "/" + c.name +
+                                         "/" + size;
+                run(name, [&] { renderer.render(sampled_picture, buffer.data(), buffer.size(), &status_line); });
+                renderer.set_pool(nullptr);
+                if (results.empty() || results.back().name != name) continue;
+                if (threads == 1) {
+                    one_thread_us = results.back().median_us;
+                } else if (one_thread_us > 0.0) {
+                    std::cout << "  " << std::setprecision(2) << one_thread_us / results.back().median_us
+                              << "x the speed of one thread" << std::endl;
+                }
+            }
+        }
+
+        // Output: a full frame through stdio into a pipe drained by another thread (standing
+        // in for the terminal), and a diff between two consecutive frames encoded as
+        // positioned ANSI runs
+        Renderer renderer(find_ramp("normal")->glyphs);
+        std::string frame_a;
+        std::string frame_b;
+        renderer.render(picture, frame_a, &status_line);
+        renderer.render(picture_next, frame_b, &status_line);
+        OutputPipe sink;
+        if (sink.open()) {
+            run("output/full/" + size, [&] {
+                std::fwrite("\033[H", 1, 3, sink.file());
+                std::fwrite(frame_a.data(), 1, frame_a.size(), sink.file());
+                std::fflush(sink.file());
+            });
+        }
+        FrameDiffer differ;
+        std::vector<DiffRun> runs;
+        std::string encoded;
+        bool flip = false;
+        run("output/diff/" + size, [&] {
+            const std::string& next = flip ? frame_a : frame_b;
+            flip = !flip;
+            encoded.clear();
+            if (differ.diff(next, runs)) append_ansi_runs(next, runs, encoded);
+        });
+
+        // Colored half blocks set two colors per cell; the diff has to follow both
+        Renderer half(find_ramp("normal")->glyphs, GlyphEncoding::Utf8, ColorMode::Rgb24, ColorLayer::Foreground,
+                      CellMode::HalfBlock);
+        const Geometry samples = half.image_size(grid);
+        std::vector<unsigned char> half_cells(static_cast<size_t>(samples.width) * samples.height * 4);
+        std::vector<unsigned char> half_cells_next(half_cells.size());
+        scaler.scale(desktop_view, samples.width, samples.height, half_cells.data());
+        scaler.scale(desktop_next_view, samples.width, samples.height, half_cells_next.data());
+        const int half_height = samples.height - half.cell_height();
+        half.render({half_cells.data(), samples.width, half_height, static_cast<size_t>(samples.width) * 4}, frame_a,
+                    &status_line);
+        half.render({half_cells_next.data(), samples.width, half_height, static_cast<size_t>(samples.width) * 4},
+                    frame_b, &status_line);
+        run("output/diff-halfblock/" + size, [&] {
+            const std::string& next = flip ? frame_a : frame_b;
+            flip = !flip;
+            encoded.clear();
+            if (differ.diff(next, runs)) append_ansi_runs(next, runs, encoded);
+        });
+    }
+
+    // Each conversion kernel on its own, in every pixel format, with and without counting levels
+    struct KernelCase { const char* name; PixelFormat format; AsciiRowFn fn; bool count; };
+    std::vector<KernelCase> kernels = {{"scalar", PixelFormat::Bgra, ascii_row_scalar<PixelFormat::Bgra>, false}};
+    kernels.push_back({"scalar-counted", PixelFormat::Bgra, ascii_row_scalar<PixelFormat::Bgra>, true});
+#ifdef SCRN_X86
+    kernels.push_back({"sse2", PixelFormat::Bgra, ascii_row_sse2<PixelFormat::Bgra>, false});
+    kernels.push_back({"sse2-counted", PixelFormat::Bgra, ascii_row_sse2<PixelFormat::Bgra>, true});
+    if (cpu_has_avx2()) {
+        kernels.push_back({"avx2", PixelFormat::Bgra, ascii_row_avx2<PixelFormat::Bgra>, false});
+        kernels.push_back({"avx2-counted", PixelFormat::Bgra, ascii_row_avx2<PixelFormat::Bgra>, true});
+    }
+    kernels.push_back({"rgba-sse2", PixelFormat::Rgba, ascii_row_sse2<PixelFormat::Rgba>, false});
+    if (cpu_has_avx2()) kernels.push_back({"rgba-avx2", PixelFormat::Rgba, ascii_row_avx2<PixelFormat::Rgba>, false});
+#endif
+    kernels.push_back({"rgb24-scalar", PixelFormat::Rgb24, ascii_row_scalar<PixelFormat::Rgb24>, false});
+    kernels.push_back({"gray8-scalar", PixelFormat::Gray8, ascii_row_scalar<PixelFormat::Gray8>, false});
+    {
+        const Geometry grid = GRIDS[1];
+        const size_t pixels = static_cast<size_t>(grid.width) * grid.height;
+        std::vector<unsigned char> cells(pixels * 4);
+        scaler.scale(desktop_view, grid.width, grid.height, cells.data());
+        // The same cells in every format
+        std::vector<unsigned char> formats[PIXEL_FORMATS];
+        formats[static_cast<int>(PixelFormat::Bgra)] = cells;
+        std::vector<unsigned char>& rgba = formats[static_cast<int>(PixelFormat::Rgba)];
+        std::vector<unsigned char>& rgb = formats[static_cast<int>(PixelFormat::Rgb24)];
+        std::vector<unsigned char>& gray = formats[static_cast<int>(PixelFormat::Gray8)];
+        rgba.resize(pixels * 4);
+        rgb.resize(pixels * 3);
+        gray.resize(pixels);
+        for (size_t i = 0; i < pixels; ++i) {
+            const unsigned char* p = &cells[i * 4];
+            const unsigned char swapped[4] = {p[2], p[1], p[0], p[3]};
+            std::memcpy(&rgba[i * 4], swapped, 4);
+            std::memcpy(&rgb[i * 3], swapped, 3);
+        }
+        luma_row_scalar<PixelFormat::Bgra>(cells.data(), pixels, gray.data());
+
+        std::vector<uint32_t> levels(LEVEL_HISTOGRAMS * LEVEL_BINS);
+
+        const GlyphTable table(find_ramp("normal")->glyphs);
+        const size_t row_stride = grid.width + 1;
+        std::string frame(row_stride * grid.height, '\n');
+        for (const KernelCase& k : kernels) {
+            const unsigned char* source = formats[static_cast<int>(k.format)].data();
+            const size_t source_stride = grid.width * bytes_per_pixel(k.format);
+            auto convert = [&] {
+                for (int y = 0; y < grid.height; ++y) {
+                    k.fn(source + y * source_stride, grid.width, table.ascii_lut(), &frame[y * row_stride],
+                         k.count ? levels.data() : nullptr);
+                }
+            };
+            run(std::string("kernel/") + k.name + "/" + grid_name(grid), convert);
+        }
     }
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration_baseline = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
 
-    // Benchmark Optimized
-    start = std::chrono::high_resolution_clock::now();
-    for (int i = 0; i < ITERATIONS; ++i) {
-        optimized(src_data, result_optimized, lookup_table);
+    // The braille packing kernels, on 2x4 samples per cell
+    struct BrailleCase { const char* name; BrailleRowFn fn; };
+    std::vector<BrailleCase> packers = {{"scalar", braille_row_scalar}};
+#ifdef SCRN_X86
+    packers.push_back({"sse2", braille_row_sse2});
+    if (cpu_has_avx2()) packers.push_back({"avx2", braille_row_avx2});
+#endif
+    {
+        const Geometry grid = GRIDS[1];
+        const int samples = grid.width * 2;
+        std::vector<unsigned char> pixels(static_cast<size_t>(samples) * grid.height * 4 * 4);
+        scaler.scale(desktop_view, samples, grid.height * 4, pixels.data());
+        std::vector<unsigned char> luma(static_cast<size_t>(samples) * grid.height * 4);
+        for (int y = 0; y < grid.height * 4; ++y) {
+            luma_row_scalar<PixelFormat::Bgra>(&pixels[static_cast<size_t>(y) * samples * 4], samples, &luma[static_cast<size_t>(y) * samples]);
+        }
+        std::vector<unsigned char> patterns(static_cast<size_t>(grid.width) * grid.height);
+        for (const BrailleCase& k : packers) {
+            auto pack = [&] {
+                for (int y = 0; y < grid.height; ++y) {
+                    const unsigned char* rows[4];
+                    for (int r = 0; r < 4; ++r) rows[r] = &luma[static_cast<size_t>(y * 4 + r) * samples];
+                    k.fn(rows, grid.width, Renderer::DOT_THRESHOLD, &patterns[static_cast<size_t>(y) * grid.width]);
+                }
+            };
+            run(std::string("kernel/braille-") + k.name + "/" + grid_name(grid), pack);
+        }
     }
-    end = std::chrono::high_resolution_clock::now();
-    auto duration_optimized = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
 
-    std::cout << "Baseline: " << duration_baseline / ITERATIONS << " us per frame\n";
-    std::cout << "Optimized: " << duration_optimized / ITERATIONS << " us per frame\n";
-    std::cout << "Speedup: " << (double)duration_baseline / duration_optimized << "x\n";
+    // The tile hashing kernels, over the desktop itself
+    struct TileCase { const char* name; TileRowFn fn; };
+    std::vector<TileCase> hashers = {{"scalar", tile_row_scalar}};
+#ifdef SCRN_X86
+    hashers.push_back({"sse2", tile_row_sse2});
+    if (cpu_has_avx2()) hashers.push_back({"avx2", tile_row_avx2});
+#endif
+    {
+        const size_t columns = DESKTOP_WIDTH / TileHasher::TILE_WIDTH;
+        const uint64_t keys[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+        std::vector<uint64_t> hashes(columns * 2);
+        for (const TileCase& k : hashers) {
+            auto hash = [&] {
+                std::fill(hashes.begin(), hashes.end(), 0);
+                for (int y = 0; y < DESKTOP_HEIGHT; ++y) k.fn(desktop_view.row(y), columns, keys, hashes.data());
+            };
+            run(std::string("kernel/tiles-") + k.name + "/" + std::to_string(DESKTOP_WIDTH) + "x" +
+                    std::to_string(DESKTOP_HEIGHT),
+                hash);
+        }
+    }
 
-    return 0;
+    // The Floyd-Steinberg kernels, serially over one luma plane per grid
+    struct DiffusionCase { const char* name; DiffusionKernel kernel; };
+    std::vector<DiffusionCase> diffusers = {{"scalar", {diffuse_strip_scalar, 1}}};
+#ifdef SCRN_X86
+    diffusers.push_back({"sse2", {diffuse_strip_sse2, 16}});
+    if (cpu_has_avx2()) diffusers.push_back({"avx2", {diffuse_strip_avx2, 32}});
+#endif
+    for (const Geometry& grid : GRIDS) {
+        const size_t pixels = static_cast<size_t>(grid.width) * grid.height;
+        std::vector<unsigned char> cells(pixels * 4);
+        scaler.scale(desktop_view, grid.width, grid.height, cells.data());
+        std::vector<unsigned char> luma(pixels);
+        luma_row_scalar<PixelFormat::Bgra>(cells.data(), pixels, luma.data());
+        for (const DiffusionCase& k : diffusers) {
+            Ditherer ditherer(DitherMode::FloydSteinberg, find_ramp("minimalist")->size);
+            ditherer.set_diffusion_kernel(k.kernel);
+            ditherer.resize(grid.width, grid.height);
+            run(std::string("kernel/fs-") + k.name + "/" + grid_name(grid), [&] {
+                for (int y = 0; y < grid.height; ++y) {
+                    std::memcpy(ditherer.row(y), &luma[static_cast<size_t>(y) * grid.width], grid.width);
+                }
+                ditherer.apply(0, grid.height);
+            });
+        }
+    }
+
+    if (!write_path.empty()) {
+        if (!write_baseline(write_path, results)) {
+            std::cerr << "Error: Failed to write '" << write_path << "'." << std::endl;
+            return 1;
+        }
+        std::cout << "\nWrote baseline to " << write_path << "\n";
+    }
+
+    if (!baseline_path.empty()) {
+        std::cout << "\nAgainst " << baseline_path << " (tolerance " << tolerance * 100 << "%):\n";
+        int regressions = 0;
+        for (const Result& r : results) {
+            auto it = baseline.find(r.name);
+            if (it == baseline.end()) {
+                std::cout << "  " << r.name << ": not in baseline\n";
+                continue;
+            }
+            const Baseline& base = it->second;
+            if (regressed(r, base, tolerance)) {
+                std::cout << "  REGRESSION " << r.name << ": min " << r.min_us << " us vs " << base.min_us
+                          << " us, median " << r.median_us << " us vs " << base.median_us << " us\n";
+                ++regressions;
+            }
+        }
+        if (regressions) {
+            std::cout << regressions << " case(s) regressed." << std::endl;
+            status = 1;
+        } else {
+            std::cout << "  no regressions" << std::endl;
+        }
+    }
+    return status;
 }
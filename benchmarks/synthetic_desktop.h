@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+// The desktop the benchmarks and tests draw their frames from, so both exercise the
+// renderer on the same mix of text, flat areas, gradients and photo content.
+
+// Size of the synthetic desktop
+const int DESKTOP_WIDTH = 1920;
+const int DESKTOP_HEIGHT = 1080;
+
+inline void fill_rect(std::vector<unsigned char>& image, int x0, int y0, int w, int h, unsigned char b, unsigned char g,
+               unsigned char r) {
+    const int x1 = std::min(x0 + w, DESKTOP_WIDTH);
+    const int y1 = std::min(y0 + h, DESKTOP_HEIGHT);
+    for (int y = std::max(y0, 0); y < y1; ++y) {
+        for (int x = std::max(x0, 0); x < x1; ++x) {
+            unsigned char* p = &image[(static_cast<size_t>(y) * DESKTOP_WIDTH + x) * 4];
+            p[0] = b;
+            p[1] = g;
+            p[2] = r;
+            p[3] = 255;
+        }
+    }
+}
+
+// Lines of pseudo-text: words of 8x16 character cells, each with a few dark strokes
+inline void draw_text(std::vector<unsigned char>& image, int x0, int y0, int w, int h, int lines, std::mt19937& rng) {
+    std::uniform_int_distribution<int> word_length(2, 9);
+    std::uniform_int_distribution<int> stroke(0, 6);
+    for (int line = 0; line < lines && (line + 1) * 20 <= h; ++line) {
+        int x = x0 + 8;
+        const int y = y0 + 6 + line * 20;
+        while (true) {
+            const int chars = word_length(rng);
+            if (x + chars * 8 > x0 + w - 8) break;
+            for (int c = 0; c < chars; ++c, x += 8) {
+                // A vertical stem, a bar and a bowl-ish mark, placed per character
+                fill_rect(image, x + 1 + stroke(rng) / 2, y + 2, 1, 11, 40, 40, 40);
+                fill_rect(image, x + 1, y + 4 + stroke(rng), 5, 1, 40, 40, 40);
+                if (stroke(rng) > 2) fill_rect(image, x + 3, y + 8, 3, 4, 70, 70, 70);
+            }
+            x += 8;
+        }
+    }
+}
+
+/**
+ * @brief Draws a desktop: gradient wallpaper, taskbar, a text editor, a terminal and a photo.
+ * @param variant 1 moves the photo window and adds a typed line, as the next frame would.
+ */
+inline std::vector<unsigned char> synthetic_desktop(int variant) {
+    std::vector<unsigned char> image(static_cast<size_t>(DESKTOP_WIDTH) * DESKTOP_HEIGHT * 4);
+    for (int y = 0; y < DESKTOP_HEIGHT; ++y) {
+        for (int x = 0; x < DESKTOP_WIDTH; ++x) {
+            unsigned char* p = &image[(static_cast<size_t>(y) * DESKTOP_WIDTH + x) * 4];
+            p[0] = static_cast<unsigned char>(120 + 100 * y / DESKTOP_HEIGHT);
+            p[1] = static_cast<unsigned char>(60 + 40 * x / DESKTOP_WIDTH);
+            p[2] = static_cast<unsigned char>(30 + 20 * std::sin(x * 0.004 + y * 0.003));
+            p[3] = 255;
+        }
+    }
+    std::mt19937 rng(7);
+
+    // Taskbar with icons
+    fill_rect(image, 0, DESKTOP_HEIGHT - 40, DESKTOP_WIDTH, 40, 32, 32, 32);
+    for (int i = 0; i < 12; ++i) {
+        fill_rect(image, 60 + i * 48, DESKTOP_HEIGHT - 32, 24, 24, static_cast<unsigned char>(i * 40),
+                  static_cast<unsigned char>(200 - i * 15), static_cast<unsigned char>(90 + i * 13));
+    }
+
+    // Editor: title bar, light client area full of text
+    fill_rect(image, 80, 60, 900, 700, 90, 90, 90);
+    fill_rect(image, 81, 61, 898, 30, 200, 120, 40);
+    fill_rect(image, 81, 91, 898, 668, 250, 250, 250);
+    draw_text(image, 81, 91, 898, 668, variant ? 33 : 32, rng);
+
+    // Terminal: dark client area with light text
+    fill_rect(image, 1000, 120, 820, 500, 60, 60, 60);
+    fill_rect(image, 1001, 121, 818, 30, 70, 70, 70);
+    fill_rect(image, 1001, 151, 818, 468, 20, 20, 20);
+    for (int line = 0; line < 22; ++line) {
+        fill_rect(image, 1010, 158 + line * 21, 40 + static_cast<int>(rng() % 700), 9, 200, 200, 200);
+    }
+
+    // Photo viewer: smooth, colorful content that changes every cell
+    const int photo_x = variant ? 640 : 600;
+    fill_rect(image, photo_x, 640, 760, 30, 200, 120, 40);
+    for (int y = 670; y < 1030; ++y) {
+        for (int x = photo_x; x < photo_x + 760; ++x) {
+            unsigned char* p = &image[(static_cast<size_t>(y) * DESKTOP_WIDTH + x) * 4];
+            p[0] = static_cast<unsigned char>(128 + 100 * std::sin(x * 0.02) * std::cos(y * 0.03));
+            p[1] = static_cast<unsigned char>(128 + 90 * std::sin((x + y) * 0.015));
+            p[2] = static_cast<unsigned char>(128 + 110 * std::cos(x * 0.011 - y * 0.027));
+        }
+    }
+    return image;
+}
@@ -0,0 +1,137 @@
+#include "byte_stream.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Pipe reads are batched into chunks of at least this size
+const size_t READ_CHUNK = 1 << 20;
+
+} // namespace
+
+std::unique_ptr<ByteStream> ByteStream::open(const std::string& path, std::string& error) {
+    std::unique_ptr<ByteStream> stream(new ByteStream());
+    if (path == "-") {
+#ifdef _WIN32
+        // Frames are binary; text mode would translate CR/LF pairs inside them
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        stream->file_ = stdin;
+        return stream;
+    }
+
+    // Optimization: Map regular files so frames are read in place
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && GetFileType(file) == FILE_TYPE_DISK) {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+            if (view) {
+                stream->file_handle_ = file;
+                stream->mapping_handle_ = mapping;
+                stream->map_ = static_cast<const unsigned char*>(view);
+                stream->map_size_ = static_cast<size_t>(size.QuadPart);
+                return stream;
+            }
+            if (mapping) CloseHandle(mapping);
+        }
+        CloseHandle(file);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void* view = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+                // Frames are consumed front to back exactly once
+                madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                stream->map_ = static_cast<const unsigned char*>(view);
+                stream->map_size_ = static_cast<size_t>(st.st_size);
+                ::close(fd); // the mapping keeps the file alive
+                return stream;
+            }
+        }
+        ::close(fd);
+    }
+#endif
+
+    // FIFOs, devices and empty files: plain buffered reads
+    stream->file_ = std::fopen(path.c_str(), "rb");
+    if (!stream->file_) {
+        error = "Cannot open input '" + path + "'";
+        return nullptr;
+    }
+    stream->owns_file_ = true;
+    return stream;
+}
+
+ByteStream::~ByteStream() {
+    if (map_) {
+#ifdef _WIN32
+        UnmapViewOfFile(map_);
+        CloseHandle(mapping_handle_);
+        CloseHandle(file_handle_);
+#else
+        munmap(const_cast<unsigned char*>(map_), map_size_);
+#endif
+    }
+    if (owns_file_) std::fclose(file_);
+}
+
+bool ByteStream::fill(size_t n) {
+    if (end_ - begin_ >= n) return true;
+    // Slide what is left to the front, then top up in large chunks
+    if (begin_ > 0) {
+        memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+    }
+    const size_t wanted = n > READ_CHUNK ? n : READ_CHUNK;
+    if (buffer_.size() < wanted) buffer_.resize(wanted);
+    while (end_ < n) {
+        const size_t got = std::fread(buffer_.data() + end_, 1, buffer_.size() - end_, file_);
+        if (got == 0) return false;
+        end_ += got;
+    }
+    return true;
+}
+
+const unsigned char* ByteStream::read(size_t n) {
+    if (map_) {
+        if (map_size_ - consumed_ < n) return nullptr;
+        const unsigned char* p = map_ + consumed_;
+        consumed_ += n;
+        return p;
+    }
+    if (!fill(n)) return nullptr;
+    const unsigned char* p = buffer_.data() + begin_;
+    begin_ += n;
+    consumed_ += n;
+    return p;
+}
+
+int ByteStream::peek() {
+    if (map_) return consumed_ < map_size_ ? map_[consumed_] : -1;
+    if (!fill(1)) return -1;
+    return buffer_[begin_];
+}
+
+int ByteStream::get() {
+    const unsigned char* p = read(1);
+    return p ? *p : -1;
+}
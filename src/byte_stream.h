@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Sequential reader over a whole file or stdin.
+ *
+ * Regular files are memory-mapped, so read() hands out pointers straight into the page
+ * cache and a frame is never copied on its way in. Pipes and stdin fall back to buffered
+ * reads into a buffer that grows to the largest request.
+ */
+class ByteStream {
+public:
+    /**
+     * @brief Opens `path` for reading; "-" reads stdin.
+     * @return Null with `error` set on failure.
+     */
+    static std::unique_ptr<ByteStream> open(const std::string& path, std::string& error);
+
+    ~ByteStream();
+    ByteStream(const ByteStream&) = delete;
+    ByteStream& operator=(const ByteStream&) = delete;
+
+    /**
+     * @brief Consumes the next `n` bytes.
+     * @return Pointer to them, valid until the next call; null if fewer than `n` remain.
+     */
+    const unsigned char* read(size_t n);
+
+    // Next byte without consuming it, or -1 at the end
+    int peek();
+    // Consumes and returns the next byte, or -1 at the end
+    int get();
+
+    // True when the stream is memory-mapped (random access is free)
+    bool mapped() const { return map_ != nullptr; }
+
+    // Whole contents of a mapped stream, for random access; null for pipes
+    const unsigned char* data() const { return map_; }
+
+    // Total size of a mapped stream; 0 for pipes
+    size_t size() const { return map_size_; }
+
+    // Bytes consumed so far
+    size_t position() const { return consumed_; }
+
+private:
+    ByteStream() = default;
+    bool fill(size_t n);
+
+    // Memory-mapped file
+    const unsigned char* map_ = nullptr;
+    size_t map_size_ = 0;
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#endif
+
+    // Buffered fallback
+    std::FILE* file_ = nullptr;
+    bool owns_file_ = false;
+    std::vector<unsigned char> buffer_;
+    size_t begin_ = 0; // first unconsumed byte in buffer_
+    size_t end_ = 0;   // one past the last valid byte in buffer_
+
+    size_t consumed_ = 0;
+};
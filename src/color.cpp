@@ -0,0 +1,190 @@
+#include "color.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "glyph_table.h"
+
+const char ColorQuantizer::RESET_SGR[5] = "\033[0m";
+
+namespace {
+
+struct Rgb {
+    int r, g, b;
+};
+
+// xterm's default values for the 16 standard colors
+const Rgb ANSI16_PALETTE[16] = {
+    {0, 0, 0},       {205, 0, 0},     {0, 205, 0},     {205, 205, 0},
+    {0, 0, 238},     {205, 0, 205},   {0, 205, 205},   {229, 229, 229},
+    {127, 127, 127}, {255, 0, 0},     {0, 255, 0},     {255, 255, 0},
+    {92, 92, 255},   {255, 0, 255},   {0, 255, 255},   {255, 255, 255},
+};
+
+// Channel levels of the 6x6x6 cube in the 256-color palette (indices 16-231)
+const int CUBE_LEVELS[6] = {0, 95, 135, 175, 215, 255};
+
+// Squared distance, weighted roughly by how sensitive the eye is to each channel
+inline int color_distance(const Rgb& a, const Rgb& b) {
+    const int dr = a.r - b.r;
+    const int dg = a.g - b.g;
+    const int db = a.b - b.b;
+    return 3 * dr * dr + 4 * dg * dg + 2 * db * db;
+}
+
+int nearest_ansi16(const Rgb& c) {
+    int best = 0;
+    int best_dist = color_distance(c, ANSI16_PALETTE[0]);
+    for (int i = 1; i < 16; ++i) {
+        const int d = color_distance(c, ANSI16_PALETTE[i]);
+        if (d < best_dist) {
+            best = i;
+            best_dist = d;
+        }
+    }
+    return best;
+}
+
+int nearest_cube_level(int v) {
+    int best = 0;
+    for (int i = 1; i < 6; ++i) {
+        if (std::abs(CUBE_LEVELS[i] - v) < std::abs(CUBE_LEVELS[best] - v)) best = i;
+    }
+    return best;
+}
+
+int nearest_ansi256(const Rgb& c) {
+    // Closest point of the color cube...
+    const int ri = nearest_cube_level(c.r);
+    const int gi = nearest_cube_level(c.g);
+    const int bi = nearest_cube_level(c.b);
+    const Rgb cube = {CUBE_LEVELS[ri], CUBE_LEVELS[gi], CUBE_LEVELS[bi]};
+
+    // ...against the closest step of the gray ramp (indices 232-255: 8, 18, ..., 238)
+    const int mean = (c.r + c.g + c.b) / 3;
+    int gray_step = (mean - 8 + 5) / 10;
+    if (gray_step < 0) gray_step = 0;
+    if (gray_step > 23) gray_step = 23;
+    const int gray_level = 8 + 10 * gray_step;
+    const Rgb gray = {gray_level, gray_level, gray_level};
+
+    if (color_distance(c, gray) < color_distance(c, cube)) return 232 + gray_step;
+    return 16 + 36 * ri + 6 * gi + bi;
+}
+
+inline char* write_decimal(int v, char* out) {
+    if (v >= 100) *out++ = static_cast<char>('0' + v / 100);
+    if (v >= 10) *out++ = static_cast<char>('0' + (v / 10) % 10);
+    *out++ = static_cast<char>('0' + v % 10);
+    return out;
+}
+
+// Expands a 5-bit cube coordinate back to 8 bits
+inline int expand5(int v) { return (v << 3) | (v >> 2); }
+
+} // namespace
+
+ColorQuantizer::ColorQuantizer(ColorMode mode, ColorLayer layer)
+    : mode_(mode), layer_(layer), cube_(32 * 32 * 32) {
+    for (int r = 0; r < 32; ++r) {
+        for (int g = 0; g < 32; ++g) {
+            for (int b = 0; b < 32; ++b) {
+                const int index = (r << 10) | (g << 5) | b;
+                const Rgb c = {expand5(r), expand5(g), expand5(b)};
+                switch (mode) {
+                case ColorMode::Ansi16:
+                    cube_[index] = static_cast<uint16_t>(nearest_ansi16(c));
+                    break;
+                case ColorMode::Ansi256:
+                    cube_[index] = static_cast<uint16_t>(nearest_ansi256(c));
+                    break;
+                default:
+                    cube_[index] = static_cast<uint16_t>(index);
+                    break;
+                }
+            }
+        }
+    }
+
+    for (int v = 0; v < 32; ++v) {
+        char* out = write_decimal(expand5(v), &channel_text_[v * 4]);
+        *out++ = ';';
+        channel_text_length_[v] = static_cast<uint8_t>(out - &channel_text_[v * 4]);
+    }
+
+    if (mode == ColorMode::Ansi16 || mode == ColorMode::Ansi256) {
+        const bool bg = layer == ColorLayer::Background;
+        palette_sgr_.assign(256 * SGR_SLOT, 0);
+        palette_sgr_length_.assign(256, 0);
+        for (int i = 0; i < (mode == ColorMode::Ansi16 ? 16 : 256); ++i) {
+            char* slot = &palette_sgr_[i * SGR_SLOT];
+            char* out = slot;
+            *out++ = '\033';
+            *out++ = '[';
+            if (mode == ColorMode::Ansi16) {
+                // 30-37 / 40-47, bright colors 90-97 / 100-107
+                out = write_decimal((i < 8 ? 30 : 90) + (bg ? 10 : 0) + (i & 7), out);
+            } else {
+                memcpy(out, bg ? "48;5;" : "38;5;", 5);
+                out = write_decimal(i, out + 5);
+            }
+            *out++ = 'm';
+            palette_sgr_length_[i] = static_cast<uint8_t>(out - slot);
+        }
+    }
+}
+
+char* ColorQuantizer::write_sgr(uint16_t key, char* out) const {
+    if (mode_ != ColorMode::Rgb24) {
+        // Fixed-size copy of the padded slot, advanced by its real length
+        memcpy(out, &palette_sgr_[key * SGR_SLOT], MAX_SGR_BYTES);
+        return out + palette_sgr_length_[key];
+    }
+    // Truecolor has too many keys to pre-encode, but only 32 levels per channel: each
+    // channel is a fixed 4-byte copy of its pre-encoded decimal text plus separator
+    memcpy(out, layer_ == ColorLayer::Background ? "\033[48;2;" : "\033[38;2;", 7);
+    out += 7;
+    const int channels[3] = {key >> 10, (key >> 5) & 31, key & 31};
+    for (int c : channels) {
+        memcpy(out, &channel_text_[c * 4], 4);
+        out += channel_text_length_[c];
+    }
+    out[-1] = 'm';
+    return out;
+}
+
+size_t ColorQuantizer::row_capacity(const GlyphTable& glyphs, size_t cells) {
+    return cells * (MAX_SGR_BYTES + glyphs.max_width()) + GlyphTable::ROW_SLACK;
+}
+
+template <PixelFormat F>
+char* ColorQuantizer::write_row(const unsigned char* pixels, const unsigned char* gray, size_t count,
+                                const GlyphTable& glyphs, char* out) const {
+    return write_runs<F>(pixels, count,
+                         [&](size_t begin, size_t end, char* o) { return glyphs.write_row(gray + begin, end - begin, o); },
+                         out);
+}
+
+template char* ColorQuantizer::write_row<PixelFormat::Bgra>(const unsigned char*, const unsigned char*, size_t,
+                                                            const GlyphTable&, char*) const;
+template char* ColorQuantizer::write_row<PixelFormat::Rgba>(const unsigned char*, const unsigned char*, size_t,
+                                                            const GlyphTable&, char*) const;
+template char* ColorQuantizer::write_row<PixelFormat::Rgb24>(const unsigned char*, const unsigned char*, size_t,
+                                                             const GlyphTable&, char*) const;
+template char* ColorQuantizer::write_row<PixelFormat::Gray8>(const unsigned char*, const unsigned char*, size_t,
+                                                             const GlyphTable&, char*) const;
+
+bool parse_color_mode(const char* name, ColorMode& mode) {
+    if (strcmp(name, "truecolor") == 0 || strcmp(name, "24bit") == 0) {
+        mode = ColorMode::Rgb24;
+    } else if (strcmp(name, "256") == 0) {
+        mode = ColorMode::Ansi256;
+    } else if (strcmp(name, "16") == 0) {
+        mode = ColorMode::Ansi16;
+    } else if (strcmp(name, "none") == 0) {
+        mode = ColorMode::Mono;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "image_view.h"
+
+class GlyphTable;
+
+enum class ColorMode {
+    Mono,
+    Ansi16,    // SGR 30-37 / 90-97
+    Ansi256,   // xterm 256-color palette
+    Rgb24,     // 24-bit SGR, quantized to 5 bits per channel
+};
+
+enum class ColorLayer {
+    Foreground,
+    Background,
+};
+
+/**
+ * @brief Maps pixels to quantized terminal colors and their SGR escapes.
+ *
+ * Colors are looked up in a 32x32x32 cube built at startup (5 bits per channel), so a
+ * cell costs one table load. Cells with equal keys render identically, which is what lets
+ * the renderer coalesce runs and only emit an escape when the key changes.
+ */
+class ColorQuantizer {
+public:
+    // Longest escape: "\033[48;2;255;255;255m"
+    static const size_t MAX_SGR_BYTES = 19;
+    // Reset to the terminal's default colors
+    static const char RESET_SGR[5];
+
+    ColorQuantizer(ColorMode mode, ColorLayer layer);
+
+    ColorMode mode() const { return mode_; }
+
+    // Quantized color key of one pixel in format F
+    template <PixelFormat F = PixelFormat::Bgra>
+    uint16_t key(const unsigned char* pixel) const {
+        using Layout = PixelLayout<F>;
+        return cube_[((pixel[Layout::RED] >> 3) << 10) | ((pixel[Layout::GREEN] >> 3) << 5) | (pixel[Layout::BLUE] >> 3)];
+    }
+
+    /**
+     * @brief Writes the SGR escape for `key`.
+     * @param out Must have room for MAX_SGR_BYTES.
+     * @return One past the last byte written.
+     */
+    char* write_sgr(uint16_t key, char* out) const;
+
+    /**
+     * @brief Worst-case bytes for a colored row of `cells` cells (every cell changes color).
+     */
+    static size_t row_capacity(const GlyphTable& glyphs, size_t cells);
+
+    /**
+     * @brief Writes one row of glyphs, emitting an escape only where the color changes.
+     * The row starts with its own escape so rows can be redrawn independently.
+     * @param pixels Source pixels for the row in format F (color).
+     * @param gray Luma for the row (glyph).
+     * @param out Must have room for row_capacity(glyphs, count) bytes.
+     * @return One past the last byte written.
+     */
+    template <PixelFormat F = PixelFormat::Bgra>
+    char* write_row(const unsigned char* pixels, const unsigned char* gray, size_t count,
+                    const GlyphTable& glyphs, char* out) const;
+
+    /**
+     * @brief write_row() with glyphs chosen by the caller.
+     * @param write_cells Called as `write_cells(begin, end, out)` for each run of one color;
+     *                    writes the glyphs of cells [begin, end) and returns one past them.
+     */
+    template <PixelFormat F = PixelFormat::Bgra, typename WriteCells>
+    char* write_runs(const unsigned char* pixels, size_t count, WriteCells&& write_cells, char* out) const {
+        const size_t bytes = PixelLayout<F>::BYTES;
+        size_t x = 0;
+        while (x < count) {
+            // Run coalescing: consecutive cells of the same quantized color share one escape,
+            // and their glyphs are written in one pass
+            const uint16_t k = key<F>(pixels + x * bytes);
+            size_t end = x + 1;
+            while (end < count && key<F>(pixels + end * bytes) == k) ++end;
+            out = write_sgr(k, out);
+            out = write_cells(x, end, out);
+            x = end;
+        }
+        return out;
+    }
+
+private:
+    ColorMode mode_;
+    ColorLayer layer_;
+    std::vector<uint16_t> cube_;
+    // Pre-encoded escapes for palette modes, SGR_SLOT bytes each
+    static const size_t SGR_SLOT = 20;
+    std::vector<char> palette_sgr_;
+    std::vector<uint8_t> palette_sgr_length_;
+    // Decimal text of each 5-bit channel level followed by ';', for truecolor escapes
+    char channel_text_[32 * 4];
+    uint8_t channel_text_length_[32];
+};
+
+/**
+ * @brief Parses "truecolor", "256" or "16" (also "none"); returns false if unknown.
+ */
+bool parse_color_mode(const char* name, ColorMode& mode);
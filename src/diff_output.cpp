@@ -0,0 +1,172 @@
+#include "diff_output.h"
+
+#include <cstring>
+
+namespace {
+
+// Approximate size of "\033[row;colH"; unchanged gaps up to this many cells are re-sent
+// rather than paying for another escape.
+const int MERGE_GAP = 8;
+
+// Length of the UTF-8 sequence starting with `lead`. Stray or invalid bytes count as
+// one-byte cells so a corrupt frame still diffs deterministically.
+inline size_t utf8_length(unsigned char lead) {
+    if (lead < 0x80) return 1;
+    if ((lead >> 5) == 0x6) return 2;
+    if ((lead >> 4) == 0xE) return 3;
+    if ((lead >> 3) == 0x1E) return 4;
+    return 1;
+}
+
+// Length of the CSI escape ("\033[" ... final byte) at `p`, or 0 if there is none.
+inline size_t escape_length(const std::string& s, size_t p, size_t end) {
+    if (s[p] != '\033' || p + 1 >= end || s[p + 1] != '[') return 0;
+    for (size_t i = p + 2; i < end; ++i) {
+        const unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x40 && c <= 0x7E) return i + 1 - p;
+    }
+    return end - p;
+}
+
+// Which color an SGR escape of `length` bytes at `p` sets: 40-49 and 100-107 are backgrounds,
+// an empty or 0 parameter resets both
+enum class Layer { Foreground, Background, Reset };
+
+inline Layer sgr_layer(const std::string& s, size_t p, size_t length) {
+    if (length <= 3 || (length == 4 && s[p + 2] == '0')) return Layer::Reset;
+    if (s[p + 2] == '4' || (s[p + 2] == '1' && s[p + 3] == '0')) return Layer::Background;
+    return Layer::Foreground;
+}
+
+// Color escape in effect: offset and length in its frame, none if the length is 0
+struct Sgr {
+    size_t offset = 0;
+    size_t length = 0;
+};
+
+// Records the escape at `p` as the one in effect for its layer
+inline void apply_sgr(const std::string& s, size_t p, size_t length, Sgr& fore, Sgr& back) {
+    switch (sgr_layer(s, p, length)) {
+    case Layer::Foreground:
+        fore = {p, length};
+        break;
+    case Layer::Background:
+        back = {p, length};
+        break;
+    case Layer::Reset:
+        fore = back = Sgr();
+        break;
+    }
+}
+
+inline bool same_sgr(const std::string& a, const Sgr& x, const std::string& b, const Sgr& y) {
+    return x.length == y.length && memcmp(a.data() + x.offset, b.data() + y.offset, y.length) == 0;
+}
+
+inline size_t line_end(const std::string& s, size_t from) {
+    size_t end = s.find('\n', from);
+    return end == std::string::npos ? s.size() : end;
+}
+
+} // namespace
+
+bool FrameDiffer::diff(const std::string& frame, std::vector<DiffRun>& runs) {
+    runs.clear();
+    bool full = !has_previous_;
+
+    size_t po = 0; // start of the current row in the previous frame
+    size_t pn = 0; // start of the current row in the new frame
+    for (int row = 0; !full && (po < previous_.size() || pn < frame.size()); ++row) {
+        if (po >= previous_.size() || pn >= frame.size()) {
+            full = true; // row count changed
+            break;
+        }
+        const size_t pe = line_end(previous_, po);
+        const size_t ne = line_end(frame, pn);
+
+        // Bolt: Most rows of a static screen are byte-identical; skip them without walking cells
+        if (pe - po != ne - pn || memcmp(previous_.data() + po, frame.data() + pn, ne - pn) != 0) {
+            size_t i = po;
+            size_t j = pn;
+            int col = 0;
+            int gap = 0;
+            bool in_run = false;
+            DiffRun run = {};
+            // Colors in effect in each frame; none at row start
+            Sgr fore_o, back_o;
+            Sgr fore_n, back_n;
+            while (true) {
+                for (size_t len; i < pe && (len = escape_length(previous_, i, pe)) > 0; i += len) {
+                    apply_sgr(previous_, i, len, fore_o, back_o);
+                }
+                for (size_t len; j < ne && (len = escape_length(frame, j, ne)) > 0; j += len) {
+                    apply_sgr(frame, j, len, fore_n, back_n);
+                }
+                if (j >= ne) break;
+
+                size_t ln = utf8_length(static_cast<unsigned char>(frame[j]));
+                if (ln > ne - j) ln = ne - j;
+                size_t lo = 0;
+                if (i < pe) {
+                    lo = utf8_length(static_cast<unsigned char>(previous_[i]));
+                    if (lo > pe - i) lo = pe - i;
+                }
+                const bool same = lo == ln && memcmp(previous_.data() + i, frame.data() + j, ln) == 0 &&
+                                  same_sgr(previous_, fore_o, frame, fore_n) &&
+                                  same_sgr(previous_, back_o, frame, back_n);
+                if (!same) {
+                    if (!in_run) {
+                        run = {row, col, j, 0, fore_n.offset, fore_n.length, back_n.offset, back_n.length};
+                        in_run = true;
+                    }
+                    // Extends over any bridged gap as well
+                    run.length = j + ln - run.offset;
+                    gap = 0;
+                } else if (in_run && ++gap > MERGE_GAP) {
+                    runs.push_back(run);
+                    in_run = false;
+                }
+                i += lo;
+                j += ln;
+                ++col;
+            }
+            if (in_run) runs.push_back(run);
+            // A shorter row would leave stale cells behind that no run covers
+            if (i < pe) full = true;
+        }
+        po = pe + 1;
+        pn = ne + 1;
+    }
+
+    if (!full) {
+        // Fall back when the escapes would cost more than half of just redrawing
+        size_t payload = 0;
+        for (const DiffRun& run : runs) payload += run.length + MERGE_GAP;
+        full = payload * 2 > frame.size();
+    }
+    if (full) runs.clear();
+
+    previous_ = frame;
+    has_previous_ = true;
+    return !full;
+}
+
+void append_ansi_runs(const std::string& frame, const std::vector<DiffRun>& runs, std::string& out) {
+    // Runs are drawn out of order, so in a colored frame each one restores its own color
+    const bool colored = frame.find('\033') != std::string::npos;
+    for (const DiffRun& run : runs) {
+        // Escapes are 1-based
+        out += "\033[";
+        out += std::to_string(run.row + 1);
+        out += ';';
+        out += std::to_string(run.col + 1);
+        out += 'H';
+        if (run.sgr_length > 0 || run.back_length > 0) {
+            out.append(frame, run.sgr_offset, run.sgr_length);
+            out.append(frame, run.back_offset, run.back_length);
+        } else if (colored) {
+            out += "\033[0m";
+        }
+        out.append(frame, run.offset, run.length);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// A run of changed cells on one row, pointing into the bytes of the new frame.
+struct DiffRun {
+    int row;            // 0-based terminal row
+    int col;            // 0-based terminal column of the first cell
+    size_t offset;      // byte offset of the run in the new frame
+    size_t length;      // byte length of the run
+    size_t sgr_offset;  // foreground color escape in effect at the first cell, if sgr_length > 0
+    size_t sgr_length;
+    size_t back_offset; // background color escape in effect at the first cell, if back_length > 0
+    size_t back_length;
+};
+
+/**
+ * @brief Compares each frame with the last one emitted and reports only the changed runs.
+ *
+ * Frames are rows of cells separated by '\n'. Cells are compared as whole UTF-8 sequences,
+ * so multi-byte glyphs are never split. ANSI escapes (colored frames) are not cells: they set
+ * the color of the cells after them, which is compared along with the glyph. Foreground and
+ * background escapes are tracked separately, as half blocks set both for one cell. Each row is
+ * expected to set its own color before its first colored cell. Unchanged gaps shorter than
+ * a cursor-positioning escape are folded into the surrounding run, since re-sending them is
+ * cheaper.
+ */
+class FrameDiffer {
+    std::string previous_;
+    bool has_previous_ = false;
+
+public:
+    /**
+     * @brief Diffs `frame` against the previously emitted one and remembers it as emitted.
+     * @param runs Receives the changed runs (cleared first).
+     * @return False when a full redraw is needed instead: the first frame, a change in
+     *         geometry, or more than half of the cells changed.
+     */
+    bool diff(const std::string& frame, std::vector<DiffRun>& runs);
+
+    /**
+     * @brief Forgets the previous frame so the next one is drawn in full
+     * (e.g. after something else wrote to the console).
+     */
+    void reset() { has_previous_ = false; }
+};
+
+/**
+ * @brief Appends the runs as ANSI cursor-positioning escapes followed by their bytes.
+ * Each run of a colored frame is prefixed with the colors in effect at its first cell.
+ */
+void append_ansi_runs(const std::string& frame, const std::vector<DiffRun>& runs, std::string& out);
@@ -0,0 +1,781 @@
+#include "dither.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+#include "luma_kernels.h"
+#include "thread_pool.h"
+
+#ifdef SCRN_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+bool parse_dither_mode(const char* name, DitherMode& mode) {
+    if (std::strcmp(name, "none") == 0) {
+        mode = DitherMode::Off;
+    } else if (std::strcmp(name, "bayer") == 0) {
+        mode = DitherMode::Bayer;
+    } else if (std::strcmp(name, "fs") == 0) {
+        mode = DitherMode::FloydSteinberg;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void bayer_row_scalar(unsigned char* gray, size_t count, const unsigned char* offsets) {
+    for (size_t x = 0; x < count; ++x) {
+        const unsigned int v = gray[x] + offsets[x & 31];
+        gray[x] = static_cast<unsigned char>(v > 255 ? 255 : v);
+    }
+}
+
+#ifdef SCRN_X86
+void bayer_row_sse2(unsigned char* gray, size_t count, const unsigned char* offsets) {
+    // The offsets repeat every 8 pixels, so any 16 of them fit every 16-pixel step
+    const __m128i add = _mm_loadu_si128(reinterpret_cast<const __m128i*>(offsets));
+    size_t x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m128i* p = reinterpret_cast<__m128i*>(gray + x);
+        _mm_storeu_si128(p, _mm_adds_epu8(_mm_loadu_si128(p), add));
+    }
+    bayer_row_scalar(gray + x, count - x, offsets);
+}
+
+SCRN_TARGET_AVX2
+void bayer_row_avx2(unsigned char* gray, size_t count, const unsigned char* offsets) {
+    const __m256i add = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(offsets));
+    size_t x = 0;
+    for (; x + 32 <= count; x += 32) {
+        __m256i* p = reinterpret_cast<__m256i*>(gray + x);
+        _mm256_storeu_si256(p, _mm256_adds_epu8(_mm256_loadu_si256(p), add));
+    }
+    _mm256_zeroupper();
+    bayer_row_sse2(gray + x, count - x, offsets);
+}
+#endif
+
+BayerRowFn select_bayer_row_kernel(const char** name) {
+#ifdef SCRN_X86
+    if (cpu_has_avx2()) {
+        if (name) *name = "avx2";
+        return bayer_row_avx2;
+    }
+    if (name) *name = "sse2";
+    return bayer_row_sse2;
+#else
+    if (name) *name = "scalar";
+    return bayer_row_scalar;
+#endif
+}
+
+namespace {
+
+// Error byte << 8 to its shares in 1/256ths of a step, by rounding multiply-high: 8 * weight
+const int CARRY_SHARE = 56;                // 7/16, to the next pixel
+const int BELOW_SHARES[3] = {8, 24, 40};   // 1/16, 3/16 and 5/16: below right, below left, below
+
+// Scalar counterparts of the SIMD multiply-highs: `a` as a 16-bit lane, times a constant
+inline int mulhi_unsigned(int a, int b) { return static_cast<int>((static_cast<uint32_t>(a) & 0xFFFF) * static_cast<uint32_t>(b) >> 16); }
+// Rounded to nearest, as _mm_mulhrs_epi16
+inline int mulhi_round(int a, int b) { return ((static_cast<int16_t>(a) * b >> 14) + 1) >> 1; }
+
+// `rounded` is the 8.8 sum plus half a step; its low byte is ignored
+inline int snap_level(int rounded, int scale, int shift) {
+    const int level = mulhi_unsigned(rounded | 0xFF, scale) >> shift;
+    return level > 255 ? 255 : level;
+}
+
+inline void wait_ready(const std::atomic<int>* ready, int columns) {
+    while (ready->load(std::memory_order_acquire) < columns) std::this_thread::yield();
+}
+
+} // namespace
+
+DiffusionRamp::DiffusionRamp(size_t levels) {
+    // A single glyph has nothing to dither between, and with a glyph per level nothing is lost
+    if (levels < 2 || levels > 255) return;
+    steps = static_cast<int>(levels - 1);
+    // Rounded up, so that 255 << 8 comes out as exactly `steps` and white leaves no error
+    scale = static_cast<uint16_t>((steps * 65536 + 254) / 255);
+    // Levels of glyph g start at ceil(255g / steps); a multiply-high and a shift land in
+    // them for every glyph with a scale searched around 255 / steps. With the low byte set
+    // rather than cleared, one OR is all that separates the glyph from the sum.
+    bool found = false;
+    for (int shift = 0; shift <= 8 && !found; ++shift) {
+        const int base = (65280 << shift) / steps;
+        for (int m = base - 2; m <= base + 2 && !found; ++m) {
+            if (m <= 0 || m > 65535) continue;
+            found = true;
+            for (int g = 0; g <= steps && found; ++g) found = snap_level(g << 8, m, shift) * steps / 255 == g;
+            if (found) {
+                snap_scale = static_cast<uint16_t>(m);
+                snap_shift = shift;
+            }
+        }
+    }
+}
+
+void diffuse_strip_scalar(const DiffusionRamp& ramp, const DiffusionStrip& strip) {
+    const int width = strip.width;
+    // Rows in between hand their errors down through two rows of scratch, taking turns
+    int16_t* handoff = reinterpret_cast<int16_t*>(strip.scratch);
+    const size_t period = static_cast<size_t>(width) + 1;
+    for (int r = 0; r < strip.count; ++r) {
+        unsigned char* row = strip.pixels + r * static_cast<size_t>(width);
+        const bool first = r == 0;
+        const bool last = r == strip.count - 1;
+        const int16_t* in = first ? strip.above : handoff + ((r - 1) & 1) * period + 1;
+        int16_t* below = last ? strip.below : handoff + (r & 1) * period + 1;
+        // Bolt: The errors the last two pixels left below stay in registers, so each pixel
+        // below is written once, complete, rather than read and updated three times
+        int carry = 0; // 7/16 of the error of pixel x - 1
+        int right = 0; // 1/16 of it, for below right of pixel x - 1
+        int part = 0;  // 5/16 of it plus 1/16 of pixel x - 2's, for below pixel x - 1
+        for (int begin = 0; begin < width; begin += DIFFUSION_BLOCK) {
+            const int end = begin + DIFFUSION_BLOCK < width ? begin + DIFFUSION_BLOCK : width;
+            if (first) wait_ready(strip.above_ready, end);
+            for (int x = begin; x < end; ++x) {
+                // Only the carry from the left is on the dependency chain. The sum is taken
+                // modulo 65536 like a 16-bit lane; the masks below only see its low 16 bits.
+                const int sum = mulhi_unsigned(row[x] << 8, ramp.scale) + in[x] + carry;
+                const int fraction = static_cast<int16_t>(static_cast<uint16_t>(sum) << 8);
+                carry = mulhi_round(fraction, CARRY_SHARE);
+                row[x] = static_cast<unsigned char>(
+                    snap_level(sum + 128, ramp.snap_scale, ramp.snap_shift));
+                below[x - 1] = static_cast<int16_t>(mulhi_round(fraction, BELOW_SHARES[1]) + part);
+                part = mulhi_round(fraction, BELOW_SHARES[2]) + right;
+                right = mulhi_round(fraction, BELOW_SHARES[0]);
+            }
+            // Pixel end - 1 is still owed error from pixel end
+            if (end == width) below[end - 1] = static_cast<int16_t>(part);
+            if (last) strip.below_ready->store(end == width ? width : end - 1, std::memory_order_release);
+        }
+    }
+}
+
+#ifdef SCRN_X86
+namespace {
+
+// Rows of the lane kernels' strips: one per 16-bit lane, in two vectors
+const int SSE2_ROWS = 16;
+const int AVX2_ROWS = 32;
+
+// How a strip runs as bands of a lane kernel's rows
+struct LaneBands {
+    int lead;     // steps from the first row of a band starting to the last one
+    int period;   // steps from one band to the next
+    int steps;    // until the last row is done and has carried its errors down
+    int out_from; // step from which the last row of the last band carries into `below`
+    int out_until; // step from which the last lane has no row whose errors are used
+    size_t span;  // steps rounded up to whole transposed blocks: bytes per lane
+    int third;    // period / 3 rounded up: where column 0 of a band is in the lane masks
+    int masks;    // entries in each of the three lane mask tables, whole vectors of them
+};
+
+inline LaneBands lane_bands(int rows, int width, int count) {
+    LaneBands b;
+    b.lead = diffusion_lead(rows);
+    b.period = diffusion_period(rows, width);
+    const int bands = (count + rows - 1) / rows;
+    const int last = (bands - 1) * b.period;
+    // A partial last band carries nothing below and stops when its last row is done
+    const int tail = count - (bands - 1) * rows;
+    b.steps = last + width + (tail == rows ? b.lead : diffusion_lead(tail) - 1);
+    b.out_from = last + b.lead;
+    // The last lane is idle in a partial last band, and before the first band starts
+    b.out_until = tail == rows ? b.steps : (last ? b.out_from - 1 : 0);
+    b.span = (static_cast<size_t>(last) + width + b.lead + 31) & ~size_t(31);
+    b.third = (b.period + 2) / 3;
+    b.masks = (b.third + rows + 7) & ~7;
+    return b;
+}
+
+// The scratch holds one block of the lanes transposed, then the errors handed from one band
+// to the next, one per step
+inline int16_t* lane_handoff(unsigned char* scratch, int rows) {
+    return reinterpret_cast<int16_t*>(scratch + rows * DIFFUSION_BLOCK);
+}
+
+// Lane l is within its row at step t when lane 0 was, 3l steps before: when column t - 3l of
+// the band, modulo the period, is below the width. Each step's lanes are then a run of one
+// table per step modulo 3, holding lane 0's columns backwards from `third` onwards, so
+// masking a step takes a load per vector instead of comparing every lane.
+inline int16_t* lane_masks(unsigned char* scratch, int rows, const LaneBands& b) {
+    return lane_handoff(scratch, rows) + b.span;
+}
+
+inline const int16_t* lane_mask(const int16_t* masks, const LaneBands& b, int column) {
+    return masks + column % 3 * b.masks + b.third - column / 3;
+}
+
+void fill_lane_masks(int16_t* masks, const LaneBands& b, int width) {
+    static_assert(DIFFUSION_LAG == 3, "lane delays");
+    const __m128i period = _mm_set1_epi16(static_cast<short>(b.period));
+    const __m128i last = _mm_set1_epi16(static_cast<short>(b.period - 1));
+    const __m128i limit = _mm_set1_epi16(static_cast<short>(width));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i back = _mm_setr_epi16(0, 3, 6, 9, 12, 15, 18, 21);
+    for (int residue = 0; residue < 3; ++residue) {
+        // Entry j is column residue + 3 * (third - j), from a period past the start to a
+        // lead before it
+        for (int j = 0; j < b.masks; j += 8) {
+            __m128i column = _mm_sub_epi16(_mm_set1_epi16(static_cast<short>(residue + 3 * (b.third - j))), back);
+            column = _mm_add_epi16(column, _mm_and_si128(_mm_cmpgt_epi16(zero, column), period));
+            column = _mm_sub_epi16(column, _mm_and_si128(_mm_cmpgt_epi16(column, last), period));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(masks + residue * b.masks + j), _mm_cmpgt_epi16(limit, column));
+        }
+    }
+}
+
+// Transposes 16x16 bytes: out[j] receives byte j of each of the 16 rows in[i]
+void transpose_16x16(const unsigned char* const* in, unsigned char* const* out) {
+    __m128i a[16];
+    __m128i b[16];
+    for (int i = 0; i < 16; ++i) a[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[i]));
+    // Each pass interleaves neighboring rows in units twice as wide as the last
+    for (int i = 0; i < 8; ++i) {
+        b[i] = _mm_unpacklo_epi8(a[2 * i], a[2 * i + 1]);
+        b[i + 8] = _mm_unpackhi_epi8(a[2 * i], a[2 * i + 1]);
+    }
+    for (int i = 0; i < 8; ++i) {
+        a[i] = _mm_unpacklo_epi16(b[2 * i], b[2 * i + 1]);
+        a[i + 8] = _mm_unpackhi_epi16(b[2 * i], b[2 * i + 1]);
+    }
+    for (int i = 0; i < 8; ++i) {
+        b[i] = _mm_unpacklo_epi32(a[2 * i], a[2 * i + 1]);
+        b[i + 8] = _mm_unpackhi_epi32(a[2 * i], a[2 * i + 1]);
+    }
+    for (int i = 0; i < 8; ++i) {
+        a[i] = _mm_unpacklo_epi64(b[2 * i], b[2 * i + 1]);
+        a[i + 8] = _mm_unpackhi_epi64(b[2 * i], b[2 * i + 1]);
+    }
+    // The passes leave the columns in bit-reversed order
+    static const int COLUMN[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+    for (int i = 0; i < 16; ++i) _mm_storeu_si128(reinterpret_cast<__m128i*>(out[COLUMN[i]]), a[i]);
+}
+
+// transpose_16x16() of two blocks at once, one per 128-bit half. With `high`, the rows in[i]
+// are 32 bytes and out[j] and high[j] receive bytes j and 16 + j of each; without, in[i] and
+// in_high[i] are the 16-byte halves of a row and out[j] receives all 32 bytes j of them.
+SCRN_TARGET_AVX2
+void transpose_2x16x16(const unsigned char* const* in, const unsigned char* const* in_high, unsigned char* const* out,
+                       unsigned char* const* high) {
+    __m256i a[16];
+    __m256i b[16];
+    for (int i = 0; i < 16; ++i) {
+        if (in_high) {
+            a[i] = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in[i]))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_high[i])), 1);
+        } else {
+            a[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in[i]));
+        }
+    }
+    for (int i = 0; i < 8; ++i) {
+        b[i] = _mm256_unpacklo_epi8(a[2 * i], a[2 * i + 1]);
+        b[i + 8] = _mm256_unpackhi_epi8(a[2 * i], a[2 * i + 1]);
+    }
+    for (int i = 0; i < 8; ++i) {
+        a[i] = _mm256_unpacklo_epi16(b[2 * i], b[2 * i + 1]);
+        a[i + 8] = _mm256_unpackhi_epi16(b[2 * i], b[2 * i + 1]);
+    }
+    for (int i = 0; i < 8; ++i) {
+        b[i] = _mm256_unpacklo_epi32(a[2 * i], a[2 * i + 1]);
+        b[i + 8] = _mm256_unpackhi_epi32(a[2 * i], a[2 * i + 1]);
+    }
+    for (int i = 0; i < 8; ++i) {
+        a[i] = _mm256_unpacklo_epi64(b[2 * i], b[2 * i + 1]);
+        a[i + 8] = _mm256_unpackhi_epi64(b[2 * i], b[2 * i + 1]);
+    }
+    static const int COLUMN[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+    for (int i = 0; i < 16; ++i) {
+        if (high) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out[COLUMN[i]]), _mm256_castsi256_si128(a[i]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(high[COLUMN[i]]), _mm256_extracti128_si256(a[i], 1));
+        } else {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[COLUMN[i]]), a[i]);
+        }
+    }
+}
+
+// Transposes a block of DIFFUSION_BLOCK steps from `begin` so the pixels of each step, one
+// per row, are consecutive bytes
+void skew_block_sse2(const unsigned char* lanes, size_t span, int begin, unsigned char* block) {
+    const unsigned char* in[16];
+    unsigned char* out[16];
+    for (int t = 0; t < DIFFUSION_BLOCK; t += 16) {
+        for (int i = 0; i < 16; ++i) {
+            in[i] = lanes + i * span + begin + t;
+            out[i] = block + (t + i) * SSE2_ROWS;
+        }
+        transpose_16x16(in, out);
+    }
+}
+
+void unskew_block_sse2(const unsigned char* block, size_t span, int begin, unsigned char* lanes) {
+    const unsigned char* in[16];
+    unsigned char* out[16];
+    for (int t = 0; t < DIFFUSION_BLOCK; t += 16) {
+        for (int i = 0; i < 16; ++i) {
+            in[i] = block + (t + i) * SSE2_ROWS;
+            out[i] = lanes + i * span + begin + t;
+        }
+        transpose_16x16(in, out);
+    }
+}
+
+// The AVX2 kernel's steps hold rows 0-7, 16-23, 8-15 and 24-31, the order the unpacks to
+// 16 bits and the pack back work in within 128-bit halves. Row of each byte of a half:
+inline int avx2_row(int half, int i) { return half * 8 + (i < 8 ? i : i + 8); }
+
+// The second half, rows 8-15 and 24-31, only when the strip has rows there
+SCRN_TARGET_AVX2
+void skew_block_avx2(const unsigned char* lanes, size_t span, int begin, int halves, unsigned char* block) {
+    static_assert(DIFFUSION_BLOCK == 32, "one transpose per half");
+    const unsigned char* in[16];
+    unsigned char* out[16];
+    unsigned char* high[16];
+    for (int half = 0; half < halves; ++half) {
+        for (int i = 0; i < 16; ++i) {
+            in[i] = lanes + avx2_row(half, i) * span + begin;
+            out[i] = block + i * AVX2_ROWS + half * 16;
+            high[i] = block + (16 + i) * AVX2_ROWS + half * 16;
+        }
+        transpose_2x16x16(in, nullptr, out, high);
+    }
+}
+
+SCRN_TARGET_AVX2
+void unskew_block_avx2(const unsigned char* block, size_t span, int begin, int halves, unsigned char* lanes) {
+    const unsigned char* in[16];
+    const unsigned char* in_high[16];
+    unsigned char* out[16];
+    for (int half = 0; half < halves; ++half) {
+        for (int i = 0; i < 16; ++i) {
+            in[i] = block + i * AVX2_ROWS + half * 16;
+            in_high[i] = block + (16 + i) * AVX2_ROWS + half * 16;
+            out[i] = lanes + avx2_row(half, i) * span + begin;
+        }
+        transpose_2x16x16(in, in_high, out, nullptr);
+    }
+}
+
+// Steps of a lane kernel with the same masking and the same errors in and out
+struct LaneSteps {
+    int begin;
+    int end;
+    int band;          // first step of the band the first row is in
+    const int16_t* in; // the first row takes in[t] at step t
+    int16_t* out;      // the last row carries down to out[t - out_shift]; null if nowhere
+    int out_shift;
+};
+
+// Runs a lane kernel's `diffuse` over all the steps of a strip in blocks, masking the lanes
+// outside their row only in the steps where some are. Each block is transposed by `skew`
+// before and back by `unskew` after, so the transposed steps stay in L1 whatever the size.
+template <class Skew, class Diffuse, class Unskew>
+inline void diffuse_bands(const DiffusionStrip& strip, const LaneBands& b, int16_t* handoff, Skew&& skew,
+                          Diffuse&& diffuse, Unskew&& unskew) {
+    const int width = strip.width;
+    for (int begin = 0; begin < b.steps; begin += DIFFUSION_BLOCK) {
+        const int end = begin + DIFFUSION_BLOCK < b.steps ? begin + DIFFUSION_BLOCK : b.steps;
+        skew(begin);
+        // The first band's first row reads column t of the strip above at step t
+        if (begin < width) wait_ready(strip.above_ready, end < width ? end : width);
+        for (int t = begin; t < end;) {
+            const int band = t / b.period * b.period;
+            const int column = t - band;
+            // All lanes are within their rows from when the last one starts until the first
+            // one ends, if that comes later
+            const bool masked = column < b.lead - 1 || column >= width;
+            int stop = band + (column < b.lead - 1 ? b.lead - 1 : (masked ? b.period : width));
+            if (t < b.out_from) stop = std::min(stop, b.out_from);
+            if (t < b.out_until) stop = std::min(stop, b.out_until);
+            LaneSteps steps = {t, std::min(stop, end), band, band ? handoff : strip.above, strip.below, b.out_from};
+            if (t < b.out_from) {
+                // Into the handoff, where the next band's first row takes it a period later
+                steps.out = handoff;
+                steps.out_shift = b.lead - b.period;
+            }
+            if (t >= b.out_until) steps.out = nullptr;
+            if (masked) {
+                diffuse(steps, std::true_type());
+            } else {
+                diffuse(steps, std::false_type());
+            }
+            t = steps.end;
+        }
+        unskew(begin);
+        strip.below_ready->store(std::min(width, std::max(0, end - b.out_from)), std::memory_order_release);
+    }
+}
+
+// The state a vector of rows carries from one step to the next
+struct VectorSse2 {
+    __m128i carry;   // 7/16 of the error each row left last step
+    __m128i right;   // 1/16 of it, for below right
+    __m128i part;    // 5/16 of it plus 1/16 of the one before, for below
+    __m128i below_1; // error each row carried down last step
+    __m128i below_2; // and the step before: the column the row underneath needs now
+};
+
+// DiffusionRamp broadcast to lanes. SSE2 has no _mm_mulhrs_epi16; (a * 4b >> 16) + 1 >> 1
+// is the same, so the shares are kept times 4.
+struct RampSse2 {
+    __m128i scale, carry_share, below_shares[3], one;
+    __m128i half, low_byte, snap_scale, snap_shift;
+    explicit RampSse2(const DiffusionRamp& ramp)
+        : scale(_mm_set1_epi16(static_cast<short>(ramp.scale))), carry_share(_mm_set1_epi16(4 * CARRY_SHARE)),
+          below_shares{_mm_set1_epi16(4 * BELOW_SHARES[0]), _mm_set1_epi16(4 * BELOW_SHARES[1]),
+                       _mm_set1_epi16(4 * BELOW_SHARES[2])},
+          one(_mm_set1_epi16(1)), half(_mm_set1_epi16(128)), low_byte(_mm_set1_epi16(0xFF)),
+          snap_scale(_mm_set1_epi16(static_cast<short>(ramp.snap_scale))), snap_shift(_mm_cvtsi32_si128(ramp.snap_shift)) {}
+
+    __m128i share(__m128i fraction, __m128i times_4) const {
+        return _mm_srai_epi16(_mm_add_epi16(_mm_mulhi_epi16(fraction, times_4), one), 1);
+    }
+};
+
+// One step of one vector, as diffuse_strip_scalar() does a pixel: `levels` are the pixels
+// << 8, `in` the error from above. Lanes outside `valid` (columns outside the row) leave no
+// error. Returns the snapped levels; without `Shifted` the ramp's snap shift is 0.
+template <bool Masked, bool Shifted>
+inline __m128i diffuse_vector_sse2(const RampSse2& k, VectorSse2& v, __m128i levels, __m128i in, __m128i valid) {
+    const __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mulhi_epu16(levels, k.scale), in), v.carry);
+    __m128i fraction = _mm_slli_epi16(sum, 8);
+    if (Masked) fraction = _mm_and_si128(fraction, valid);
+    v.carry = k.share(fraction, k.carry_share);
+    v.below_2 = v.below_1;
+    v.below_1 = _mm_add_epi16(k.share(fraction, k.below_shares[1]), v.part);
+    v.part = _mm_add_epi16(k.share(fraction, k.below_shares[2]), v.right);
+    v.right = k.share(fraction, k.below_shares[0]);
+    const __m128i glyph = _mm_or_si128(_mm_add_epi16(sum, k.half), k.low_byte);
+    const __m128i snapped = _mm_mulhi_epu16(glyph, k.snap_scale);
+    return Shifted ? _mm_srl_epi16(snapped, k.snap_shift) : snapped;
+}
+
+template <bool Masked, bool Shifted>
+void diffuse_steps_sse2(const RampSse2& k, VectorSse2 (&lanes)[2], const LaneSteps& steps, const LaneBands& b,
+                        const int16_t* masks, unsigned char* block) {
+    const __m128i zero = _mm_setzero_si128();
+    // Lane masks of this step and the next two; three steps on, one entry further back
+    const int column = steps.begin - steps.band;
+    const int16_t* mask[3] = {lane_mask(masks, b, column), lane_mask(masks, b, column + 1),
+                              lane_mask(masks, b, column + 2)};
+    const int16_t* in = steps.in;
+    int16_t* out = steps.out ? steps.out - steps.out_shift : nullptr;
+    VectorSse2 v0 = lanes[0];
+    VectorSse2 v1 = lanes[1];
+    unsigned char* at = block + steps.begin % DIFFUSION_BLOCK * SSE2_ROWS;
+    for (int t = steps.begin; t < steps.end; ++t, at += SSE2_ROWS) {
+        // Row r takes what row r - 1 carried down to its column; row 0 what the band above did
+        const __m128i in_0 = _mm_insert_epi16(_mm_slli_si128(v0.below_2, 2), in[t], 0);
+        const __m128i in_1 = _mm_or_si128(_mm_slli_si128(v1.below_2, 2), _mm_srli_si128(v0.below_2, 14));
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(at));
+        const __m128i valid_0 = Masked ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask[0])) : zero;
+        const __m128i valid_1 = Masked ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask[0] + 8)) : zero;
+        const __m128i snapped_0 = diffuse_vector_sse2<Masked, Shifted>(k, v0, _mm_unpacklo_epi8(zero, pixels), in_0, valid_0);
+        const __m128i snapped_1 = diffuse_vector_sse2<Masked, Shifted>(k, v1, _mm_unpackhi_epi8(zero, pixels), in_1, valid_1);
+        // Snapped levels stay below 32768, so the signed saturation clamps them to 255
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(at), _mm_packus_epi16(snapped_0, snapped_1));
+        if (out) out[t] = static_cast<int16_t>(_mm_extract_epi16(v1.below_1, 7));
+        if (Masked) {
+            const int16_t* next = mask[0] - 1;
+            mask[0] = mask[1];
+            mask[1] = mask[2];
+            mask[2] = next;
+        }
+    }
+    lanes[0] = v0;
+    lanes[1] = v1;
+}
+
+struct VectorAvx2 {
+    __m256i carry;
+    __m256i right;
+    __m256i part;
+    __m256i below_1;
+    __m256i below_2;
+};
+
+struct RampAvx2 {
+    __m256i scale, carry_share, below_shares[3];
+    __m256i half, low_byte, snap_scale;
+    __m128i snap_shift;
+};
+
+SCRN_TARGET_AVX2
+RampAvx2 broadcast_avx2(const DiffusionRamp& ramp) {
+    return {_mm256_set1_epi16(static_cast<short>(ramp.scale)),
+            _mm256_set1_epi16(CARRY_SHARE),
+            {_mm256_set1_epi16(BELOW_SHARES[0]), _mm256_set1_epi16(BELOW_SHARES[1]), _mm256_set1_epi16(BELOW_SHARES[2])},
+            _mm256_set1_epi16(128),
+            _mm256_set1_epi16(0xFF),
+            _mm256_set1_epi16(static_cast<short>(ramp.snap_scale)),
+            _mm_cvtsi32_si128(ramp.snap_shift)};
+}
+
+template <bool Masked, bool Shifted>
+SCRN_TARGET_AVX2 inline __m256i diffuse_vector_avx2(const RampAvx2& k, VectorAvx2& v, __m256i levels, __m256i in,
+                                                    __m256i valid) {
+    const __m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_mulhi_epu16(levels, k.scale), in), v.carry);
+    __m256i fraction = _mm256_slli_epi16(sum, 8);
+    if (Masked) fraction = _mm256_and_si256(fraction, valid);
+    v.carry = _mm256_mulhrs_epi16(fraction, k.carry_share);
+    v.below_2 = v.below_1;
+    v.below_1 = _mm256_add_epi16(_mm256_mulhrs_epi16(fraction, k.below_shares[1]), v.part);
+    v.part = _mm256_add_epi16(_mm256_mulhrs_epi16(fraction, k.below_shares[2]), v.right);
+    v.right = _mm256_mulhrs_epi16(fraction, k.below_shares[0]);
+    const __m256i glyph = _mm256_or_si256(_mm256_add_epi16(sum, k.half), k.low_byte);
+    const __m256i snapped = _mm256_mulhi_epu16(glyph, k.snap_scale);
+    return Shifted ? _mm256_srl_epi16(snapped, k.snap_shift) : snapped;
+}
+
+template <bool Masked, bool Shifted>
+SCRN_TARGET_AVX2 void diffuse_steps_avx2(const RampAvx2& k, VectorAvx2 (&lanes)[2], const LaneSteps& steps,
+                                         const LaneBands& b, const int16_t* masks, unsigned char* block) {
+    const __m256i zero = _mm256_setzero_si256();
+    const int column = steps.begin - steps.band;
+    const int16_t* mask[3] = {lane_mask(masks, b, column), lane_mask(masks, b, column + 1),
+                              lane_mask(masks, b, column + 2)};
+    const int16_t* in = steps.in;
+    int16_t* out = steps.out ? steps.out - steps.out_shift : nullptr;
+    VectorAvx2 v0 = lanes[0];
+    VectorAvx2 v1 = lanes[1];
+    unsigned char* at = block + steps.begin % DIFFUSION_BLOCK * AVX2_ROWS;
+    for (int t = steps.begin; t < steps.end; ++t, at += AVX2_ROWS) {
+        // One lane up, across the 128-bit halves and from the end of the vector before; row 0
+        // takes column t of the band above, the last of the 16 ending there
+        const __m256i in_16 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + t - 15));
+        const __m256i in_0 = _mm256_alignr_epi8(v0.below_2, _mm256_permute2x128_si256(v0.below_2, in_16, 0x03), 14);
+        const __m256i in_1 = _mm256_alignr_epi8(v1.below_2, _mm256_permute2x128_si256(v1.below_2, v0.below_2, 0x03), 14);
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(at));
+        const __m256i valid_0 = Masked ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask[0])) : zero;
+        const __m256i valid_1 = Masked ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask[0] + 16)) : zero;
+        const __m256i snapped_0 = diffuse_vector_avx2<Masked, Shifted>(k, v0, _mm256_unpacklo_epi8(zero, pixels), in_0, valid_0);
+        const __m256i snapped_1 = diffuse_vector_avx2<Masked, Shifted>(k, v1, _mm256_unpackhi_epi8(zero, pixels), in_1, valid_1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(at), _mm256_packus_epi16(snapped_0, snapped_1));
+        if (out) out[t] = static_cast<int16_t>(_mm256_extract_epi16(v1.below_1, 15));
+        if (Masked) {
+            const int16_t* next = mask[0] - 1;
+            mask[0] = mask[1];
+            mask[1] = mask[2];
+            mask[2] = next;
+        }
+    }
+    lanes[0] = v0;
+    lanes[1] = v1;
+}
+
+} // namespace
+
+void diffuse_strip_sse2(const DiffusionRamp& ramp, const DiffusionStrip& strip) {
+    const LaneBands b = lane_bands(SSE2_ROWS, strip.width, strip.count);
+    unsigned char* lanes = strip.pixels;
+    unsigned char* block = strip.scratch;
+    int16_t* masks = lane_masks(strip.scratch, SSE2_ROWS, b);
+    fill_lane_masks(masks, b, strip.width);
+    const RampSse2 k(ramp);
+    VectorSse2 state[2];
+    std::memset(state, 0, sizeof(state));
+    diffuse_bands(
+        strip, b, lane_handoff(strip.scratch, SSE2_ROWS),
+        [&](int begin) { skew_block_sse2(lanes, b.span, begin, block); },
+        [&](const LaneSteps& steps, auto masked) {
+            // Bolt: Ramps of up to 176 glyphs snap without a shift, which takes two uops a vector
+            if (ramp.snap_shift) {
+                diffuse_steps_sse2<decltype(masked)::value, true>(k, state, steps, b, masks, block);
+            } else {
+                diffuse_steps_sse2<decltype(masked)::value, false>(k, state, steps, b, masks, block);
+            }
+        },
+        [&](int begin) { unskew_block_sse2(block, b.span, begin, lanes); });
+}
+
+SCRN_TARGET_AVX2
+void diffuse_strip_avx2(const DiffusionRamp& ramp, const DiffusionStrip& strip) {
+    const LaneBands b = lane_bands(AVX2_ROWS, strip.width, strip.count);
+    unsigned char* lanes = strip.pixels;
+    unsigned char* block = strip.scratch;
+    const int halves = strip.count > 8 ? 2 : 1;
+    int16_t* masks = lane_masks(strip.scratch, AVX2_ROWS, b);
+    fill_lane_masks(masks, b, strip.width);
+    const RampAvx2 k = broadcast_avx2(ramp);
+    VectorAvx2 state[2];
+    std::memset(state, 0, sizeof(state));
+    diffuse_bands(
+        strip, b, lane_handoff(strip.scratch, AVX2_ROWS),
+        [&](int begin) { skew_block_avx2(lanes, b.span, begin, halves, block); },
+        [&](const LaneSteps& steps, auto masked) {
+            if (ramp.snap_shift) {
+                diffuse_steps_avx2<decltype(masked)::value, true>(k, state, steps, b, masks, block);
+            } else {
+                diffuse_steps_avx2<decltype(masked)::value, false>(k, state, steps, b, masks, block);
+            }
+        },
+        [&](int begin) { unskew_block_avx2(block, b.span, begin, halves, lanes); });
+    _mm256_zeroupper();
+}
+#endif
+
+size_t diffusion_row_offset(int rows, int width, int count, int i) {
+    if (rows == 1) return static_cast<size_t>(i) * width;
+#ifdef SCRN_X86
+    const LaneBands b = lane_bands(rows, width, count);
+    const int lane = i % rows;
+    return lane * (b.span + DIFFUSION_LAG) + static_cast<size_t>(i / rows) * b.period;
+#else
+    (void)count;
+    return 0;
+#endif
+}
+
+size_t diffusion_pixel_bytes(int rows, int width, int count) {
+    if (rows == 1) return static_cast<size_t>(count) * width;
+#ifdef SCRN_X86
+    // Every lane, to the end of the last block the kernel transposes
+    return rows * lane_bands(rows, width, count).span;
+#else
+    return 0;
+#endif
+}
+
+size_t diffusion_scratch_bytes(int rows, int width, int count) {
+    // Two rows of errors handed from one row to the next
+    if (rows == 1) return 2 * (static_cast<size_t>(width) + 1) * sizeof(int16_t);
+#ifdef SCRN_X86
+    // A block of the lanes transposed, the errors handed between bands and the lane masks
+    const LaneBands b = lane_bands(rows, width, count);
+    return static_cast<size_t>(rows) * DIFFUSION_BLOCK + sizeof(int16_t) * b.span +
+           3 * static_cast<size_t>(b.masks) * sizeof(int16_t);
+#else
+    (void)count;
+    return 0;
+#endif
+}
+
+DiffusionKernel select_diffusion_kernel(const char** name) {
+#ifdef SCRN_X86
+    if (cpu_has_avx2()) {
+        if (name) *name = "avx2";
+        return {diffuse_strip_avx2, AVX2_ROWS};
+    }
+    if (name) *name = "sse2";
+    return {diffuse_strip_sse2, SSE2_ROWS};
+#else
+    if (name) *name = "scalar";
+    return {diffuse_strip_scalar, 1};
+#endif
+}
+
+Ditherer::Ditherer(DitherMode mode, size_t levels, ThreadPool* pool)
+    : mode_(mode), pool_(pool), bayer_row_(select_bayer_row_kernel()),
+      ramp_(mode == DitherMode::FloydSteinberg ? levels : 0), diffusion_(select_diffusion_kernel()) {
+    static const unsigned char BAYER_8X8[8][8] = {
+        {0, 32, 8, 40, 2, 34, 10, 42},  {48, 16, 56, 24, 50, 18, 58, 26},
+        {12, 44, 4, 36, 14, 46, 6, 38}, {60, 28, 52, 20, 62, 30, 54, 22},
+        {3, 35, 11, 43, 1, 33, 9, 41},  {51, 19, 59, 27, 49, 17, 57, 25},
+        {15, 47, 7, 39, 13, 45, 5, 37}, {63, 31, 55, 23, 61, 29, 53, 21},
+    };
+    // One glyph step in gray levels; a single glyph has nothing to dither between
+    const int steps = levels > 1 ? static_cast<int>(levels - 1) : 0;
+    const double step = steps ? 255.0 / steps : 0.0;
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 32; ++x) {
+            // Centered in each of the 64 sub-steps, so the mean offset is half a step and
+            // the floor in the lookup rounds to nearest on average
+            offsets_[y][x] = static_cast<unsigned char>((BAYER_8X8[y][x & 7] + 0.5) * step / 64);
+        }
+    }
+}
+
+int Ditherer::strip_rows(int height) const {
+    // Bolt: One thread runs all rows as one strip, starting its lanes on the first rows once;
+    // several take strips of one band each, which follow one another on as many threads
+    return pool_ && pool_->size() > 1 ? diffusion_.rows : height;
+}
+
+void Ditherer::resize(int width, int height) {
+    if (width == width_ && height == height_) return;
+    width_ = width;
+    height_ = height;
+    row_offsets_.resize(height > 0 ? height : 0);
+    if (mode_ != DitherMode::FloydSteinberg) {
+        for (int y = 0; y < height; ++y) row_offsets_[y] = static_cast<size_t>(y) * width;
+        plane_.resize(row_offsets_.size() * (width > 0 ? width : 0));
+        return;
+    }
+    // Bolt: Each strip's rows go where its kernel diffuses them, so the luma written into
+    // them and the levels read back are never copied into the kernel's lanes and out again
+    const int rows = strip_rows(height);
+    size_t bytes = 0;
+    for (int y = 0; y < height; y += rows) {
+        const int count = std::min(rows, height - y);
+        for (int i = 0; i < count; ++i) {
+            row_offsets_[y + i] = bytes + diffusion_row_offset(diffusion_.rows, width, count, i);
+        }
+        bytes += diffusion_pixel_bytes(diffusion_.rows, width, count);
+    }
+    plane_.resize(bytes);
+}
+
+void Ditherer::apply(int row_begin, int row_end) {
+    const int width = width_;
+    if (width <= 0 || row_begin >= row_end) return;
+    if (mode_ == DitherMode::Bayer) {
+        // Bolt: Branch-free; the kernel is one saturating add per pixel
+        for (int y = row_begin; y < row_end; ++y) bayer_row_(row(y), width, offsets_[y & 7]);
+        return;
+    }
+    if (mode_ != DitherMode::FloydSteinberg || !ramp_.steps) return;
+
+    const int height = height_;
+    const size_t workers = pool_ ? pool_->size() : 1;
+    const int rows = strip_rows(height);
+    const int strips = (height + rows - 1) / rows;
+    // Room for the kernels' reads before column 0 and up to a period past it
+    const size_t front = 16;
+    const size_t padded = front + diffusion_period(diffusion_.rows, width);
+    errors_.assign((strips + 1) * padded, 0);
+    if (progress_.size() < static_cast<size_t>(strips) + 1) progress_.resize(strips + 1);
+    progress_[0].ready.store(width, std::memory_order_relaxed);
+    for (int s = 1; s <= strips; ++s) progress_[s].ready.store(0, std::memory_order_relaxed);
+    if (strip_scratch_.size() < workers) strip_scratch_.resize(workers);
+    const size_t scratch = diffusion_scratch_bytes(diffusion_.rows, width, std::min(rows, height));
+
+    auto diffuse = [&](size_t s, size_t worker) {
+        std::vector<unsigned char>& buffer = strip_scratch_[worker];
+        if (buffer.size() < scratch) buffer.resize(scratch);
+        const int y = static_cast<int>(s) * rows;
+        const DiffusionStrip strip = {row(y),
+                                      std::min(rows, height - y),
+                                      width,
+                                      &errors_[s * padded + front],
+                                      &errors_[(s + 1) * padded + front],
+                                      &progress_[s].ready,
+                                      &progress_[s + 1].ready,
+                                      buffer.data()};
+        diffusion_.fn(ramp_, strip);
+    };
+    if (strips == 1) {
+        diffuse(0, 0);
+        return;
+    }
+    // Bolt: One strip per chunk. Chunks are claimed in order, so the strip a thread waits on
+    // has already been claimed by a running thread and the wavefront cannot deadlock
+    pool_->parallel_for(strips, strips, [&](size_t begin, size_t end, size_t worker) {
+        for (size_t s = begin; s < end; ++s) diffuse(s, worker);
+    });
+}
+
+void Ditherer::apply(unsigned char* plane, size_t stride, int width, int height) {
+    if (width <= 0 || height <= 0) return;
+    resize(width, height);
+    for (int y = 0; y < height; ++y) std::memcpy(row(y), plane + y * stride, width);
+    apply(0, height);
+    for (int y = 0; y < height; ++y) std::memcpy(plane + y * stride, row(y), width);
+}
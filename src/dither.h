@@ -0,0 +1,233 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "simd_config.h"
+
+class ThreadPool;
+
+// How gray levels between two glyphs are spread over neighboring cells
+enum class DitherMode {
+    Off,            // not "None": X11 defines that as a macro
+    Bayer,          // ordered: an 8x8 threshold matrix added before the lookup
+    FloydSteinberg, // error diffusion, rows processed as a wavefront across threads
+};
+
+/**
+ * @brief Parses "none", "bayer" or "fs"; returns false if unknown.
+ */
+bool parse_dither_mode(const char* name, DitherMode& mode);
+
+/**
+ * @brief Adds one row of Bayer offsets to `count` luma values, saturating at 255.
+ * @param offsets 32 offsets that repeat across the row.
+ */
+using BayerRowFn = void (*)(unsigned char* gray, size_t count, const unsigned char* offsets);
+
+void bayer_row_scalar(unsigned char* gray, size_t count, const unsigned char* offsets);
+#ifdef SCRN_X86
+// 16 pixels per step.
+void bayer_row_sse2(unsigned char* gray, size_t count, const unsigned char* offsets);
+// 32 pixels per step. Only call when cpu_has_avx2() is true.
+void bayer_row_avx2(unsigned char* gray, size_t count, const unsigned char* offsets);
+#endif
+
+/**
+ * @brief Bayer counterpart of select_ascii_row_kernel().
+ */
+BayerRowFn select_bayer_row_kernel(const char** name = nullptr);
+
+/**
+ * @brief Floyd-Steinberg arithmetic for one ramp, shared by the diffusion kernels so they
+ * produce the same pixels.
+ *
+ * Sums and errors are in glyph steps, 8.8 fixed point. A multiply-high scales a pixel's level
+ * to steps, and the errors carried into it are added with 16-bit wraparound: no error is
+ * more than half a step, and the shares a pixel receives add up to at most one error, so the
+ * sum stays within half a step of the ramp and its 16 bits are unambiguous. The nearest
+ * glyph is the sum rounded, and the error is the signed low byte left over, which rounding
+ * multiply-highs weight 7/16 for the next pixel and 1/16, 3/16 and 5/16 for the row below.
+ * Every value fits a 16-bit lane, and no clamp, division, table or branch is on the path
+ * from one pixel to the next.
+ */
+struct DiffusionRamp {
+    int steps = 0;      // glyph steps, 0 if the ramp leaves nothing to diffuse
+    uint16_t scale = 0; // level << 8 to 8.8 glyph steps, by multiply-high; exact at 255
+    // Nearest glyph g to a level the lookup maps back to it, exactly, from any 8.8 value
+    // that rounds to it: ((g << 8 | 255) * snap_scale >> 16) >> snap_shift, saturated to 255
+    uint16_t snap_scale = 0;
+    int snap_shift = 0;
+
+    explicit DiffusionRamp(size_t levels = 0);
+};
+
+// Columns each row of a strip runs behind the row above, so the error it needs is final
+const int DIFFUSION_LAG = 3;
+// Columns a diffusion kernel processes between progress updates
+const int DIFFUSION_BLOCK = 32;
+
+/**
+ * @brief Steps from the first row of a kernel's `rows` rows to its last one finishing.
+ */
+inline int diffusion_lead(int rows) { return DIFFUSION_LAG * (rows - 1) + 1; }
+
+/**
+ * @brief Steps from one band of a kernel's `rows` rows to the next, within a strip: each row
+ * finishes and is one column past its end before its lane moves on to the row `rows` further
+ * down, and the band's first row finds the errors of the band above it already final.
+ */
+inline int diffusion_period(int rows, int width) {
+    return (width > diffusion_lead(rows) ? width : diffusion_lead(rows)) + 1;
+}
+
+/**
+ * @brief Where a kernel of `rows` rows wants row `i` of a strip of `count` rows of `width`
+ * pixels, as an offset into the strip's pixels. The scalar kernel takes plain rows. The lane
+ * kernels take row i in lane i % rows, one period further along for each band and delayed by
+ * DIFFUSION_LAG columns per lane, so they diffuse the rows where they are; whatever the bytes
+ * between the rows hold never reaches a pixel.
+ */
+size_t diffusion_row_offset(int rows, int width, int count, int i);
+
+/**
+ * @brief Bytes the pixels of such a strip take, the gaps between rows included.
+ */
+size_t diffusion_pixel_bytes(int rows, int width, int count);
+
+/**
+ * @brief Rows for a diffusion kernel, diffused in place where diffusion_row_offset() puts
+ * them. The kernel runs them in bands of its rows, back to back, so a thread pays once for
+ * the rows of a band starting one after another. The kernel reads the error (in 1/256ths of
+ * a glyph step) the row above carries into each column from `above`, from above[-15] to
+ * above[diffusion_period() - 1] (only the first `width` are used), and writes the error its
+ * last row carries down to below[-1] to below[width - 1]. Readiness is published as the
+ * number of leading columns of `below` that are final, so the strip underneath can follow
+ * on another thread. A strip whose count is not a multiple of the kernel's rows must be the
+ * last: what it leaves below is unspecified.
+ */
+struct DiffusionStrip {
+    unsigned char* pixels; // diffusion_pixel_bytes()
+    int count;
+    int width;
+    const int16_t* above;
+    int16_t* below;
+    const std::atomic<int>* above_ready;
+    std::atomic<int>* below_ready;
+    unsigned char* scratch; // diffusion_scratch_bytes() for the kernel
+};
+
+using DiffuseStripFn = void (*)(const DiffusionRamp& ramp, const DiffusionStrip& strip);
+
+struct DiffusionKernel {
+    DiffuseStripFn fn;
+    int rows; // per band
+};
+
+// One row per band.
+void diffuse_strip_scalar(const DiffusionRamp& ramp, const DiffusionStrip& strip);
+#ifdef SCRN_X86
+// 16 rows per band, one per 16-bit lane.
+void diffuse_strip_sse2(const DiffusionRamp& ramp, const DiffusionStrip& strip);
+// 32 rows per band, one per 16-bit lane. Only call when cpu_has_avx2() is true.
+void diffuse_strip_avx2(const DiffusionRamp& ramp, const DiffusionStrip& strip);
+#endif
+
+/**
+ * @brief Scratch a strip of `count` rows of `width` pixels needs, for a kernel of `rows` rows.
+ */
+size_t diffusion_scratch_bytes(int rows, int width, int count);
+
+/**
+ * @brief Floyd-Steinberg counterpart of select_ascii_row_kernel().
+ */
+DiffusionKernel select_diffusion_kernel(const char** name = nullptr);
+
+/**
+ * @brief Dithers luma planes for a ramp of `levels` glyphs before they go through the
+ * ramp's lookup table (level i -> glyph i * (levels - 1) / 255).
+ *
+ * Bayer adds a position-dependent offset below one glyph step, so the floor in the lookup
+ * rounds each pixel up with the probability of its distance to the next glyph; it costs one
+ * saturating add per pixel. Floyd-Steinberg snaps pixels to the gray level of the nearest
+ * glyph and carries the error right and down (see DiffusionRamp). A row may only pass a
+ * pixel once the row above is further along, so rows run as a diagonal wavefront: within a
+ * strip across SIMD lanes, and with a pool, strips follow one another on several threads.
+ *
+ * Like a Renderer, a Ditherer keeps scratch and serves one thread; copies get their own.
+ */
+class Ditherer {
+public:
+    /**
+     * @param levels Glyphs in the ramp (2 for on/off dots).
+     * @param pool Runs Floyd-Steinberg strips concurrently; null for the calling thread only.
+     */
+    Ditherer(DitherMode mode, size_t levels, ThreadPool* pool = nullptr);
+
+    DitherMode mode() const { return mode_; }
+
+    /**
+     * @brief Replaces the Floyd-Steinberg kernel select_diffusion_kernel() picked, e.g. to
+     * compare kernels. The plane has to be sized again.
+     */
+    void set_diffusion_kernel(const DiffusionKernel& kernel) {
+        diffusion_ = kernel;
+        width_ = -1;
+    }
+
+    /**
+     * @brief Sizes the plane the Ditherer dithers to `width` x `height`. Its rows are laid
+     * out for the Floyd-Steinberg kernel, so it diffuses them without copying them around;
+     * write the levels through row() and read them back the same way. A plane of the same
+     * size keeps its layout.
+     */
+    void resize(int width, int height);
+
+    /**
+     * @brief Row `y` of the plane, `width` bytes. Rows are not evenly spaced.
+     */
+    unsigned char* row(int y) { return plane_.data() + row_offsets_[y]; }
+
+    /**
+     * @brief Dithers rows [row_begin, row_end) of the plane in place. Floyd-Steinberg carries
+     * errors down the whole plane, so it takes all of its rows at once.
+     */
+    void apply(int row_begin, int row_end);
+
+    /**
+     * @brief Dithers a `width` x `height` plane in place; rows are `stride` bytes apart. It is
+     * copied into the Ditherer's plane and back.
+     */
+    void apply(unsigned char* plane, size_t stride, int width, int height);
+
+private:
+    // Per-strip progress of the wavefront, one cache line each so strips don't contend
+    struct alignas(64) StripProgress {
+        std::atomic<int> ready{0};
+        StripProgress() = default;
+        StripProgress(const StripProgress&) {}
+        StripProgress& operator=(const StripProgress&) { return *this; }
+    };
+
+    // Rows of the strips Floyd-Steinberg runs as, on one thread or several
+    int strip_rows(int height) const;
+
+    DitherMode mode_;
+    ThreadPool* pool_;
+    BayerRowFn bayer_row_;
+    unsigned char offsets_[8][32]; // Bayer matrix rows, repeated to 32 columns
+    DiffusionRamp ramp_;
+    DiffusionKernel diffusion_;
+
+    int width_ = 0;
+    int height_ = 0;
+    std::vector<unsigned char> plane_;
+    std::vector<size_t> row_offsets_; // where each row of the plane starts in it
+
+    // Floyd-Steinberg scratch: errors carried into each strip (x16, padded for the lead)
+    std::vector<int16_t> errors_;
+    std::vector<StripProgress> progress_;
+    std::vector<std::vector<unsigned char>> strip_scratch_; // per worker
+};
@@ -0,0 +1,181 @@
+#include "downscale.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "simd_config.h"
+#include "thread_pool.h"
+
+#ifdef SCRN_X86
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Pixel pairs summed in 16-bit lanes before widening: 256 * 255 still fits.
+const int MAX_PAIRS_16BIT = 256;
+
+using AccumulateRowFn = void (*)(const unsigned char* row, const std::vector<AreaDownscaler::Span>& columns,
+                                 uint32_t* acc);
+
+#ifdef SCRN_X86
+/**
+ * @brief accumulate_row for the four-byte formats: two pixels per 16-bit add.
+ */
+template <PixelFormat F>
+void accumulate_row_sse2(const unsigned char* row, const std::vector<AreaDownscaler::Span>& columns, uint32_t* acc) {
+    const __m128i zero = _mm_setzero_si128();
+    for (const AreaDownscaler::Span& span : columns) {
+        const unsigned char* p = row + static_cast<size_t>(span.start) * 4;
+        __m128i sum32 = _mm_setzero_si128();
+        int k = 0;
+        while (k + 2 <= span.count) {
+            // Two pixels per add: 8 bytes widened to [b g r a b g r a] in 16-bit lanes
+            __m128i sum16 = _mm_setzero_si128();
+            const int stop = std::min(span.count, k + 2 * MAX_PAIRS_16BIT);
+            for (; k + 2 <= stop; k += 2) {
+                const __m128i px = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + k * 4));
+                sum16 = _mm_add_epi16(sum16, _mm_unpacklo_epi8(px, zero));
+            }
+            // Fold both pixels of the pair into 32-bit channel sums
+            sum32 = _mm_add_epi32(sum32, _mm_unpacklo_epi16(sum16, zero));
+            sum32 = _mm_add_epi32(sum32, _mm_unpackhi_epi16(sum16, zero));
+        }
+        if (k < span.count) {
+            int last;
+            memcpy(&last, p + k * 4, 4);
+            const __m128i px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(last), zero);
+            sum32 = _mm_add_epi32(sum32, _mm_unpacklo_epi16(px, zero));
+        }
+        // Sums are in memory order; RGBA swaps red and blue once per span
+        if constexpr (F == PixelFormat::Rgba) sum32 = _mm_shuffle_epi32(sum32, _MM_SHUFFLE(3, 0, 1, 2));
+        __m128i* out = reinterpret_cast<__m128i*>(acc);
+        _mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out), sum32));
+        acc += 4;
+    }
+}
+#endif
+
+/**
+ * @brief Adds the per-channel sums of every column span of one source row into `acc`, in
+ * BGRA order whatever the source format. Formats without alpha come out opaque.
+ */
+template <PixelFormat F>
+void accumulate_row(const unsigned char* row, const std::vector<AreaDownscaler::Span>& columns, uint32_t* acc) {
+    using Layout = PixelLayout<F>;
+#ifdef SCRN_X86
+    if constexpr (Layout::BYTES == 4) {
+        accumulate_row_sse2<F>(row, columns, acc);
+        return;
+    }
+#endif
+    for (const AreaDownscaler::Span& span : columns) {
+        const unsigned char* p = row + static_cast<size_t>(span.start) * Layout::BYTES;
+        // Locals, since stores through `acc` could alias the pixels and stay in the loop
+        uint32_t blue = 0, green = 0, red = 0, alpha = 0;
+        for (int k = 0; k < span.count; ++k, p += Layout::BYTES) {
+            blue += p[Layout::BLUE];
+            green += p[Layout::GREEN];
+            red += p[Layout::RED];
+            alpha += Layout::BYTES == 4 ? p[3] : 255;
+        }
+        acc[0] += blue;
+        acc[1] += green;
+        acc[2] += red;
+        acc[3] += alpha;
+        acc += 4;
+    }
+}
+
+AccumulateRowFn accumulate_row_kernel(PixelFormat format) {
+    switch (format) {
+    case PixelFormat::Rgba:
+        return accumulate_row<PixelFormat::Rgba>;
+    case PixelFormat::Rgb24:
+        return accumulate_row<PixelFormat::Rgb24>;
+    case PixelFormat::Gray8:
+        return accumulate_row<PixelFormat::Gray8>;
+    default:
+        return accumulate_row<PixelFormat::Bgra>;
+    }
+}
+
+} // namespace
+
+AreaDownscaler::AreaDownscaler(ThreadPool* pool) : pool_(pool) {}
+
+void AreaDownscaler::rebuild(int src_width, int src_height, int dst_width, int dst_height) {
+    auto make_spans = [](int src, int dst, std::vector<Span>& spans) {
+        spans.resize(dst);
+        for (int i = 0; i < dst; ++i) {
+            int start = static_cast<int>(static_cast<int64_t>(i) * src / dst);
+            int end = static_cast<int>(static_cast<int64_t>(i + 1) * src / dst);
+            // Upscaling: every output still needs one source pixel
+            if (start >= src) start = src - 1;
+            if (end <= start) end = start + 1;
+            spans[i] = {start, end - start};
+        }
+    };
+    make_spans(src_width, dst_width, columns_);
+    make_spans(src_height, dst_height, rows_);
+
+    column_scale_.resize(dst_width);
+    for (int i = 0; i < dst_width; ++i) column_scale_[i] = 1.0f / columns_[i].count;
+
+    const size_t threads = pool_ ? pool_->size() : 1;
+    accumulators_.assign(threads, std::vector<uint32_t>(static_cast<size_t>(dst_width) * 4));
+
+    src_width_ = src_width;
+    src_height_ = src_height;
+    dst_width_ = dst_width;
+    dst_height_ = dst_height;
+}
+
+void AreaDownscaler::scale_rows(const ImageView& src, int y_begin, int y_end, unsigned char* dst,
+                                std::vector<uint32_t>& acc) const {
+    const AccumulateRowFn accumulate = accumulate_row_kernel(src.format);
+    for (int y = y_begin; y < y_end; ++y) {
+        const Span& rows = rows_[y];
+        std::fill(acc.begin(), acc.end(), 0);
+        for (int sy = rows.start; sy < rows.start + rows.count; ++sy) {
+            accumulate(src.row(sy), columns_, acc.data());
+        }
+
+        // Divide by the box area and store as bytes
+        const float row_scale = 1.0f / rows.count;
+        unsigned char* out = dst + static_cast<size_t>(y) * dst_width_ * 4;
+#ifdef SCRN_X86
+        const __m128i* sums = reinterpret_cast<const __m128i*>(acc.data());
+        for (int x = 0; x < dst_width_; ++x) {
+            const __m128 mean = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(sums + x)),
+                                           _mm_set1_ps(column_scale_[x] * row_scale));
+            const __m128i v = _mm_cvtps_epi32(mean); // rounds to nearest
+            const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(v, v), v);
+            const int px = _mm_cvtsi128_si32(bytes);
+            memcpy(out + x * 4, &px, 4);
+        }
+#else
+        for (int x = 0; x < dst_width_; ++x) {
+            const float scale = column_scale_[x] * row_scale;
+            for (int c = 0; c < 4; ++c) {
+                out[x * 4 + c] = static_cast<unsigned char>(acc[x * 4 + c] * scale + 0.5f);
+            }
+        }
+#endif
+    }
+}
+
+void AreaDownscaler::scale(const ImageView& src, int dst_width, int dst_height, unsigned char* dst) {
+    if (src.width != src_width_ || src.height != src_height_ || dst_width != dst_width_ || dst_height != dst_height_) {
+        rebuild(src.width, src.height, dst_width, dst_height);
+    }
+
+    if (!pool_) {
+        scale_rows(src, 0, dst_height, dst, accumulators_[0]);
+        return;
+    }
+    // Bands of output rows; each reads a disjoint set of source rows
+    pool_->parallel_for(dst_height, pool_->size(), [&](size_t begin, size_t end, size_t worker) {
+        scale_rows(src, static_cast<int>(begin), static_cast<int>(end), dst, accumulators_[worker]);
+    });
+}
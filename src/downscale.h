@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "image_view.h"
+
+class ThreadPool;
+
+/**
+ * @brief Box-filter (area-average) downscaler from a full-resolution frame to the cell grid.
+ *
+ * Each output pixel is the mean of the source rectangle it covers. The per-column and
+ * per-row source spans are computed once per geometry; a frame then costs one pass over
+ * the source: spans are summed horizontally with SIMD adds, the row sums accumulated
+ * vertically, and output rows split into bands across the thread pool. The row sum is
+ * instantiated per source format, so PPM or gray frames are read as they are.
+ */
+class AreaDownscaler {
+public:
+    // Source span [start, start + count) covered by one output column or row
+    struct Span {
+        int start;
+        int count;
+    };
+
+    /**
+     * @param pool Threads to split row bands across; null runs on the calling thread.
+     */
+    explicit AreaDownscaler(ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Scales `src`, in any PixelFormat, into `dst`, a tightly packed dst_width x
+     * dst_height BGRA buffer.
+     */
+    void scale(const ImageView& src, int dst_width, int dst_height, unsigned char* dst);
+
+private:
+    void rebuild(int src_width, int src_height, int dst_width, int dst_height);
+    void scale_rows(const ImageView& src, int y_begin, int y_end, unsigned char* dst, std::vector<uint32_t>& acc) const;
+
+    ThreadPool* pool_;
+    int src_width_ = 0;
+    int src_height_ = 0;
+    int dst_width_ = 0;
+    int dst_height_ = 0;
+    std::vector<Span> columns_;
+    std::vector<Span> rows_;
+    std::vector<float> column_scale_; // 1 / column span width
+    // One row accumulator (dst_width x 4 channels) per worker thread
+    std::vector<std::vector<uint32_t>> accumulators_;
+};
@@ -0,0 +1,174 @@
+#include "frame_pool.h"
+
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+void secure_wipe(void* data, size_t size) {
+    if (!data || !size) return;
+#ifdef _WIN32
+    SecureZeroMemory(data, size);
+#elif defined(__GLIBC__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+    explicit_bzero(data, size);
+#else
+    // Stores through a volatile pointer can't be dropped as dead
+    volatile unsigned char* p = static_cast<volatile unsigned char*>(data);
+    while (size--) *p++ = 0;
+#endif
+}
+
+FramePool& FramePool::shared() {
+    static FramePool pool;
+    return pool;
+}
+
+FramePool::FramePool() : blocks_(new Descriptor[MAX_BLOCKS]) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    page_ = info.dwPageSize;
+#else
+    const long page = sysconf(_SC_PAGESIZE);
+    page_ = page > 0 ? static_cast<size_t>(page) : 4096;
+#endif
+    for (auto& head : heads_) head.store(0, std::memory_order_relaxed);
+}
+
+FramePool::~FramePool() {
+    // Blocks were wiped when they were released; unmapping also unlocks them
+    for (const Slab& slab : slabs_) {
+#ifdef _WIN32
+        VirtualFree(slab.data, 0, MEM_RELEASE);
+#else
+        munmap(slab.data, slab.bytes);
+#endif
+    }
+}
+
+int FramePool::class_of(size_t bytes) const {
+    int size_class = 0;
+    while (size_class < CLASSES && class_bytes(size_class) < bytes) ++size_class;
+    return size_class;
+}
+
+void FramePool::push(int size_class, uint32_t id) {
+    std::atomic<uint64_t>& head = heads_[size_class];
+    uint64_t top = head.load(std::memory_order_relaxed);
+    uint64_t replacement;
+    do {
+        blocks_[id - 1].next.store(static_cast<uint32_t>(top), std::memory_order_relaxed);
+        replacement = ((top >> 32) + 1) << 32 | id;
+    } while (!head.compare_exchange_weak(top, replacement, std::memory_order_release, std::memory_order_relaxed));
+}
+
+uint32_t FramePool::pop(int size_class) {
+    std::atomic<uint64_t>& head = heads_[size_class];
+    uint64_t top = head.load(std::memory_order_acquire);
+    while (true) {
+        const uint32_t id = static_cast<uint32_t>(top);
+        if (!id) return 0;
+        // Another thread may take this block first; then the tag has moved on and the
+        // exchange fails, whatever `next` was read
+        const uint32_t next = blocks_[id - 1].next.load(std::memory_order_relaxed);
+        const uint64_t replacement = ((top >> 32) + 1) << 32 | next;
+        if (head.compare_exchange_weak(top, replacement, std::memory_order_acquire, std::memory_order_acquire)) {
+            return id;
+        }
+    }
+}
+
+bool FramePool::grow(int size_class) {
+    std::lock_guard<std::mutex> lock(grow_mutex_);
+    const size_t block_bytes = class_bytes(size_class);
+    const size_t bytes = block_bytes > SLAB_BYTES ? block_bytes : SLAB_BYTES;
+    const size_t count = bytes / block_bytes;
+    if (block_count_ + count > MAX_BLOCKS) return false;
+
+#ifdef _WIN32
+    void* data = VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!data) return false;
+    const bool locked = VirtualLock(data, bytes) != 0;
+#else
+    void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) return false;
+    // Sentinel: Keep screen contents out of swap and core dumps
+    const bool locked = mlock(data, bytes) == 0;
+#ifdef MADV_DONTDUMP
+    madvise(data, bytes, MADV_DONTDUMP);
+#endif
+#endif
+    slabs_.push_back({data, bytes});
+    mapped_.fetch_add(bytes, std::memory_order_relaxed);
+    if (locked) locked_.fetch_add(bytes, std::memory_order_relaxed);
+
+    for (size_t i = 0; i < count; ++i) {
+        Descriptor& block = blocks_[block_count_++];
+        block.data = static_cast<unsigned char*>(data) + i * block_bytes;
+        push(size_class, block_count_);
+    }
+    return true;
+}
+
+FramePool::Block FramePool::acquire(size_t bytes) {
+    Block block;
+    const int size_class = class_of(bytes ? bytes : 1);
+    if (size_class >= CLASSES) return block;
+    uint32_t id = pop(size_class);
+    // Map more only when the class ran dry; a block another thread releases meanwhile is
+    // picked up by the retry
+    while (!id) {
+        if (!grow(size_class)) return block;
+        id = pop(size_class);
+    }
+    block.data = blocks_[id - 1].data;
+    block.capacity = class_bytes(size_class);
+    block.id = id;
+    return block;
+}
+
+void FramePool::release(const Block& block, size_t used) {
+    if (!block.id) return;
+    // Sentinel: Wipe before the block can be handed to anyone else
+    secure_wipe(block.data, used < block.capacity ? used : block.capacity);
+    push(class_of(block.capacity), block.id);
+}
+
+void FramePool::reserve(size_t bytes, size_t count) {
+    // Take them all at once so none is handed back out before the last is acquired
+    std::vector<Block> blocks;
+    for (size_t i = 0; i < count; ++i) {
+        blocks.push_back(acquire(bytes));
+        if (!blocks.back().id) break;
+    }
+    for (const Block& block : blocks) release(block, 0);
+}
+
+SecureBuffer::~SecureBuffer() {
+    FramePool::shared().release(block_, size_);
+}
+
+void SecureBuffer::resize(size_t new_size) {
+    if (new_size <= block_.capacity && block_.id) {
+        if (new_size < size_) {
+            // Wipe the data we are about to discard
+            secure_wipe(block_.data + new_size, size_ - new_size);
+        }
+        size_ = new_size;
+        return;
+    }
+    if (new_size == 0) return;
+    FramePool& pool = FramePool::shared();
+    const FramePool::Block block = pool.acquire(new_size);
+    if (!block.id) throw std::bad_alloc();
+    // New blocks are already zero past what is copied, as a vector's new elements would be
+    if (size_) std::memcpy(block.data, block_.data, size_);
+    pool.release(block_, size_);
+    block_ = block;
+    size_ = new_size;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Overwrites `size` bytes with zeros in a way the compiler can't optimize out
+ * (SecureZeroMemory on Windows, explicit_bzero elsewhere).
+ */
+void secure_wipe(void* data, size_t size);
+
+/**
+ * @brief Process-wide pool of page-aligned, locked buffers for screen contents.
+ *
+ * Buffers come in power-of-two size classes from one page up, carved out of slabs that
+ * are mapped once and kept until the pool is destroyed. Slabs are locked into memory
+ * (mlock/VirtualLock) so captured pixels never reach swap, and on Linux are left out of
+ * core dumps. Locking is best effort: past RLIMIT_MEMLOCK (or the working set on Windows)
+ * slabs stay unlocked, which locked_bytes() shows.
+ *
+ * Buffers are handed out and back through a lock-free free list per size class, so
+ * capture and render threads recycle them without allocating or taking a lock; only
+ * mapping a new slab does. A released buffer is wiped before it goes back on its list,
+ * so every buffer handed out is all zeros.
+ */
+class FramePool {
+public:
+    // Small buffers are carved out of slabs this large; larger ones get a slab each
+    static const size_t SLAB_BYTES = 1 << 20;
+    // Most buffers the pool tracks
+    static const uint32_t MAX_BLOCKS = 1 << 14;
+
+    struct Block {
+        unsigned char* data = nullptr;
+        size_t capacity = 0;
+        uint32_t id = 0; // 0 for no block
+    };
+
+    // The pool SecureBuffer draws from
+    static FramePool& shared();
+
+    FramePool();
+    ~FramePool();
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    /**
+     * @brief Hands out a zeroed buffer of at least `bytes` bytes.
+     * @return A block with no data if the system is out of memory or the pool is full.
+     */
+    Block acquire(size_t bytes);
+
+    /**
+     * @brief Wipes the first `used` bytes of `block` and puts it back for reuse.
+     */
+    void release(const Block& block, size_t used);
+
+    /**
+     * @brief Makes sure `count` buffers of `bytes` bytes are ready, so the first frames
+     * don't map slabs.
+     */
+    void reserve(size_t bytes, size_t count);
+
+    // Bytes mapped for slabs so far, and how many of them are locked in memory
+    size_t mapped_bytes() const { return mapped_.load(std::memory_order_relaxed); }
+    size_t locked_bytes() const { return locked_.load(std::memory_order_relaxed); }
+
+private:
+    // Page-sized up to page << (CLASSES - 1)
+    static const int CLASSES = 24;
+
+    struct Descriptor {
+        unsigned char* data = nullptr;
+        std::atomic<uint32_t> next{0}; // id of the block below on the free list
+    };
+    struct Slab {
+        void* data;
+        size_t bytes;
+    };
+
+    int class_of(size_t bytes) const;
+    size_t class_bytes(int size_class) const { return page_ << size_class; }
+    // Maps a slab for `size_class` and puts its blocks on the free list
+    bool grow(int size_class);
+    void push(int size_class, uint32_t id);
+    uint32_t pop(int size_class);
+
+    size_t page_;
+    // Indexed by id - 1; allocated once so a concurrent pop can always read a descriptor
+    std::unique_ptr<Descriptor[]> blocks_;
+    uint32_t block_count_ = 0; // guarded by grow_mutex_
+    // Top of each free list: the block's id, and a tag in the upper half that changes on
+    // every update so a pop can't be fooled by a block that left and came back (ABA)
+    std::atomic<uint64_t> heads_[CLASSES];
+    std::mutex grow_mutex_;
+    std::vector<Slab> slabs_;
+    std::atomic<size_t> mapped_{0};
+    std::atomic<size_t> locked_{0};
+};
+
+/**
+ * @brief Byte buffer for screen contents, backed by FramePool.
+ *
+ * The memory is locked, and wiped whenever the buffer shrinks, moves to a larger block or
+ * is destroyed. Steady state reuses the same block, and a buffer given up returns to the
+ * pool for the next one rather than to the heap.
+ */
+class SecureBuffer {
+public:
+    SecureBuffer() = default;
+    ~SecureBuffer();
+    // Prevent accidental copying which would leave unwiped duplicates
+    SecureBuffer(const SecureBuffer&) = delete;
+    SecureBuffer& operator=(const SecureBuffer&) = delete;
+
+    /**
+     * @brief Resizes like std::vector::resize (throws std::bad_alloc when out of memory).
+     */
+    void resize(size_t new_size);
+    unsigned char* data() { return block_.data; }
+    const unsigned char* data() const { return block_.data; }
+    size_t size() const { return size_; }
+
+private:
+    FramePool::Block block_;
+    size_t size_ = 0;
+};
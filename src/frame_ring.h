@@ -0,0 +1,123 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+/**
+ * @brief Bounded ring of reusable frame slots handed between two pipeline stages.
+ *
+ * The producer acquires a free slot, fills it and publishes it; the consumer takes
+ * the newest published slot and releases it when done. Slots are allocated once and
+ * recycled, so buffers keep their capacity and steady state never allocates.
+ *
+ * Stale frames are dropped rather than queued: `take_latest` recycles every published
+ * slot except the newest, and `acquire` reclaims the oldest unconsumed slot when no
+ * free one is left, so a slow consumer never stalls the producer.
+ */
+template <typename T>
+class FrameRing {
+    std::unique_ptr<T[]> slots_;
+    std::deque<size_t> free_;
+    std::deque<size_t> ready_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t dropped_ = 0;
+    bool closed_ = false;
+
+public:
+    explicit FrameRing(size_t capacity) : slots_(new T[capacity]) {
+        for (size_t i = 0; i < capacity; ++i) free_.push_back(i);
+    }
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    T& operator[](size_t slot) { return slots_[slot]; }
+
+    /**
+     * @brief Gets a slot for the producer to fill.
+     * Blocks only while the consumer holds every slot.
+     * @return False once the ring has been closed.
+     */
+    bool acquire(size_t& slot) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return closed_ || !free_.empty() || !ready_.empty(); });
+        if (closed_) return false;
+        if (!free_.empty()) {
+            slot = free_.front();
+            free_.pop_front();
+        } else {
+            // Nobody consumed this frame in time; overwrite it with a fresher one
+            slot = ready_.front();
+            ready_.pop_front();
+            ++dropped_;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Hands a filled slot to the consumer.
+     */
+    void publish(size_t slot) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_.push_back(slot);
+        }
+        cv_.notify_all();
+    }
+
+    /**
+     * @brief Waits for the newest published slot, recycling any older ones.
+     * @return False once the ring has been closed.
+     */
+    bool take_latest(size_t& slot) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return closed_ || !ready_.empty(); });
+        if (closed_) return false;
+        while (ready_.size() > 1) {
+            free_.push_back(ready_.front());
+            ready_.pop_front();
+            ++dropped_;
+        }
+        slot = ready_.front();
+        ready_.pop_front();
+        lock.unlock();
+        cv_.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief Returns a slot taken with `take_latest` (or an unused acquired one).
+     */
+    void release(size_t slot) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.push_back(slot);
+        }
+        cv_.notify_all();
+    }
+
+    /**
+     * @brief Wakes all waiters and makes further acquire/take calls fail.
+     */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    // Published slots the consumer has not taken yet
+    size_t ready() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return ready_.size();
+    }
+
+    size_t dropped() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dropped_;
+    }
+};
@@ -0,0 +1,60 @@
+#include "frame_scheduler.h"
+
+#include <thread>
+
+namespace {
+
+FrameScheduler::Clock::duration interval_for(double fps) {
+    return std::chrono::duration_cast<FrameScheduler::Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+}
+
+} // namespace
+
+FrameScheduler::FrameScheduler(double fps)
+    : interval_(interval_for(fps)), full_interval_(interval_), idle_interval_(interval_for(IDLE_FPS)) {
+    // A requested rate below the idle rate is never raised
+    if (idle_interval_ < full_interval_) idle_interval_ = full_interval_;
+    deadline_ = Clock::now();
+    frame_start_ = deadline_;
+    last_step_ = deadline_;
+}
+
+void FrameScheduler::wait() {
+    const Clock::time_point now = Clock::now();
+    if (now - deadline_ > interval_) {
+        // Fell more than a frame behind: drop the missed slots rather than run them back to back
+        deadline_ = now;
+    } else {
+        std::this_thread::sleep_until(deadline_);
+    }
+    frame_start_ = deadline_ > now ? deadline_ : now;
+    deadline_ += interval_;
+}
+
+void FrameScheduler::frame_done(double dirty) {
+    dirty_ += (dirty - dirty_) * 0.25;
+    if (dirty > 0) {
+        if (interval_ != full_interval_) {
+            // Back to the full rate right away, not after the idle interval runs out
+            interval_ = full_interval_;
+            deadline_ = frame_start_ + interval_;
+        }
+        last_step_ = frame_start_;
+        return;
+    }
+    if (interval_ < idle_interval_ && frame_start_ - last_step_ >= std::chrono::seconds(1)) {
+        interval_ *= 2;
+        if (interval_ > idle_interval_) interval_ = idle_interval_;
+        deadline_ = frame_start_ + interval_;
+        last_step_ = frame_start_;
+    }
+}
+
+void FrameScheduler::frame_partial() {
+    ++partial_;
+    deadline_ += interval_;
+}
+
+double FrameScheduler::fps() const {
+    return 1.0 / std::chrono::duration<double>(interval_).count();
+}
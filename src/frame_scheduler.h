@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Paces live capture against absolute deadlines.
+ *
+ * Frame k is due at a fixed point on the schedule, so the time spent capturing and drawing
+ * never accumulates into drift. A frame that overruns its slot by more than a whole interval
+ * restarts the schedule from now instead of bursting through the missed slots.
+ *
+ * While the screen stays unchanged the interval is doubled once per second, down to
+ * IDLE_FPS, and it snaps back to the full rate on the first change, so an idle desktop
+ * costs a few captures per second instead of the full rate.
+ */
+class FrameScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Lowest rate an unchanging screen is sampled at
+    static constexpr double IDLE_FPS = 4.0;
+
+    /**
+     * @param fps Full frame rate, used while the screen is changing.
+     */
+    explicit FrameScheduler(double fps);
+
+    /**
+     * @brief Sleeps until the next frame is due.
+     */
+    void wait();
+
+    /**
+     * @brief Reports the frame captured after wait(): the fraction of the screen (e.g. of its
+     * tiles) that changed since the previous one, 0 for none.
+     */
+    void frame_done(double dirty);
+
+    /**
+     * @brief Reports that the slot was skipped because the last frame's output had not drained yet.
+     */
+    void frame_skipped() { ++skipped_; }
+
+    /**
+     * @brief Reports that the terminal took only part of the frame (non-blocking output); the
+     * next deadline moves back one interval to give it time to drain.
+     */
+    void frame_partial();
+
+    // Rate the schedule currently runs at (lower than the full rate while idle)
+    double fps() const;
+
+    // Changed fraction of recent frames, smoothed over the last few
+    double dirty_fraction() const { return dirty_; }
+
+    // Slots skipped so far because output was backed up
+    uint64_t skipped() const { return skipped_; }
+
+    // Frames the terminal took only part of at first
+    uint64_t partial() const { return partial_; }
+
+private:
+    Clock::duration interval_;      // current spacing between deadlines
+    Clock::duration full_interval_; // spacing at the requested rate
+    Clock::duration idle_interval_; // longest spacing while idle
+    Clock::time_point deadline_;    // when the next frame is due
+    Clock::time_point frame_start_; // when the last wait() returned
+    Clock::time_point last_step_;   // last change, or last time the idle rate was lowered
+    uint64_t skipped_ = 0;
+    uint64_t partial_ = 0;
+    double dirty_ = 0.0;
+};
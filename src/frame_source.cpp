@@ -0,0 +1,367 @@
+#include "frame_source.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "byte_stream.h"
+
+namespace {
+
+// Sentinel: Reject absurd headers before they turn into huge allocations or overflows
+const int MAX_DIMENSION = 16384;
+
+inline bool is_space(int c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; }
+
+// Reads up to (and consumes) the next '\n'; false at the end of the input
+bool read_line(ByteStream& in, std::string& line) {
+    line.clear();
+    int c = in.get();
+    if (c < 0) return false;
+    while (c >= 0 && c != '\n') {
+        line += static_cast<char>(c);
+        c = in.get();
+    }
+    return true;
+}
+
+// Parses a dimension in [1, MAX_DIMENSION]; false on anything else
+bool parse_dimension(const std::string& text, int& value) {
+    if (text.empty() || text.size() > 5) return false;
+    for (char c : text) {
+        if (c < '0' || c > '9') return false;
+    }
+    value = std::atoi(text.c_str());
+    return value > 0 && value <= MAX_DIMENSION;
+}
+
+inline unsigned char clamp_byte(int v) {
+    return static_cast<unsigned char>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// --- Raw BGRA ---
+
+// Frames already in the renderer's layout; with a mapped file they are handed out in place.
+class RawBgraSource : public FrameSource {
+    std::unique_ptr<ByteStream> in_;
+    int width_;
+    int height_;
+
+public:
+    RawBgraSource(std::unique_ptr<ByteStream> in, int width, int height)
+        : in_(std::move(in)), width_(width), height_(height) {}
+
+    const char* format() const override { return "raw BGRA"; }
+
+    bool next(ImageView& frame) override {
+        if (in_->peek() < 0) return false;
+        const size_t stride = static_cast<size_t>(width_) * 4;
+        const unsigned char* data = in_->read(stride * height_);
+        if (!data) {
+            error_ = "Truncated frame at byte " + std::to_string(in_->position());
+            return false;
+        }
+        frame = {data, width_, height_, stride};
+        return true;
+    }
+};
+
+// --- PPM / PAM ---
+
+// Concatenated P6/P7 images, the format of e.g. `ffmpeg -f image2pipe -c:v ppm`.
+// Each image carries its own header, so the size may change between frames.
+class PnmSource : public FrameSource {
+    std::unique_ptr<ByteStream> in_;
+    std::vector<unsigned char> pixels_;
+    unsigned char scale_[256]; // sample value -> 0..255 for the current maxval
+    int scale_maxval_ = 0;
+
+    // Next whitespace-separated header token, skipping '#' comments
+    bool read_token(std::string& token) {
+        token.clear();
+        int c = in_->get();
+        while (c >= 0 && (is_space(c) || c == '#')) {
+            if (c == '#') {
+                while (c >= 0 && c != '\n') c = in_->get();
+            }
+            c = in_->get();
+        }
+        while (c >= 0 && !is_space(c)) {
+            token += static_cast<char>(c);
+            c = in_->get();
+        }
+        // The single whitespace byte after the last header token has been consumed
+        return !token.empty();
+    }
+
+    bool set_maxval(const std::string& text) {
+        int maxval = 0;
+        if (!parse_dimension(text, maxval) || maxval > 255) {
+            error_ = "Unsupported maxval '" + text + "' (only 8-bit samples are supported)";
+            return false;
+        }
+        if (maxval != scale_maxval_) {
+            for (int v = 0; v < 256; ++v) scale_[v] = clamp_byte((v * 255 + maxval / 2) / maxval);
+            scale_maxval_ = maxval;
+        }
+        return true;
+    }
+
+    bool read_ppm_header(int& width, int& height, int& depth) {
+        std::string w, h, maxval;
+        if (!read_token(w) || !read_token(h) || !read_token(maxval) ||
+            !parse_dimension(w, width) || !parse_dimension(h, height)) {
+            error_ = "Malformed PPM header";
+            return false;
+        }
+        depth = 3;
+        return set_maxval(maxval);
+    }
+
+    bool read_pam_header(int& width, int& height, int& depth) {
+        width = height = depth = 0;
+        std::string line;
+        while (true) {
+            if (!read_line(*in_, line)) {
+                error_ = "Truncated PAM header";
+                return false;
+            }
+            const size_t split = line.find(' ');
+            const size_t value_start = split == std::string::npos ? split : line.find_first_not_of(' ', split);
+            const std::string key = line.substr(0, split);
+            const std::string value = value_start == std::string::npos ? "" : line.substr(value_start);
+            if (key == "ENDHDR") break;
+            if (key == "WIDTH") {
+                if (!parse_dimension(value, width)) width = 0;
+            } else if (key == "HEIGHT") {
+                if (!parse_dimension(value, height)) height = 0;
+            } else if (key == "DEPTH") {
+                if (!parse_dimension(value, depth)) depth = 0;
+            } else if (key == "MAXVAL") {
+                if (!set_maxval(value)) return false;
+            }
+            // TUPLTYPE and comments are implied by DEPTH for the types we accept
+        }
+        if (width == 0 || height == 0 || scale_maxval_ == 0) {
+            error_ = "Malformed PAM header";
+            return false;
+        }
+        // GRAYSCALE, GRAYSCALE_ALPHA, RGB, RGB_ALPHA
+        if (depth < 1 || depth > 4) {
+            error_ = "Unsupported PAM depth " + std::to_string(depth);
+            return false;
+        }
+        return true;
+    }
+
+public:
+    explicit PnmSource(std::unique_ptr<ByteStream> in) : in_(std::move(in)) {}
+
+    const char* format() const override { return "PPM/PAM"; }
+
+    bool next(ImageView& frame) override {
+        while (is_space(in_->peek())) in_->get();
+        if (in_->peek() < 0) return false;
+
+        std::string magic;
+        read_token(magic);
+        int width = 0, height = 0, depth = 0;
+        if (magic == "P6") {
+            if (!read_ppm_header(width, height, depth)) return false;
+        } else if (magic == "P7") {
+            if (!read_pam_header(width, height, depth)) return false;
+        } else {
+            error_ = "Expected a P6 or P7 image at byte " + std::to_string(in_->position());
+            return false;
+        }
+
+        const size_t pixels = static_cast<size_t>(width) * height;
+        const unsigned char* src = in_->read(pixels * depth);
+        if (!src) {
+            error_ = "Truncated image data";
+            return false;
+        }
+
+        // Bolt: 8-bit RGB, RGBA and gray images are handed to the downscaler as they are, in
+        // place when the stream is mapped; it reads each layout directly
+        const PixelFormat format = depth == 4 ? PixelFormat::Rgba : depth == 3 ? PixelFormat::Rgb24 : PixelFormat::Gray8;
+        const size_t stride = static_cast<size_t>(width) * depth;
+        if (scale_maxval_ == 255 && depth != 2) {
+            frame = {src, width, height, stride, format};
+            return true;
+        }
+
+        // Other maxvals are rescaled, and gray + alpha loses its alpha since the screen never
+        // has any
+        const int channels = depth == 2 ? 1 : depth;
+        pixels_.resize(pixels * channels);
+        unsigned char* dst = pixels_.data();
+        for (size_t i = 0; i < pixels; ++i, src += depth, dst += channels) {
+            for (int c = 0; c < channels; ++c) dst[c] = scale_[src[c]];
+        }
+        frame = {pixels_.data(), width, height, static_cast<size_t>(width) * channels, format};
+        return true;
+    }
+};
+
+// --- YUV4MPEG2 ---
+
+enum class Chroma { C420, C422, C444, Mono };
+
+// Uncompressed Y'CbCr video, the format of `ffmpeg -f yuv4mpegpipe`. Converted with the
+// BT.601 limited-range matrix, which is what Y4M streams from most tools carry.
+class Y4mSource : public FrameSource {
+    std::unique_ptr<ByteStream> in_;
+    int width_;
+    int height_;
+    Chroma chroma_;
+    bool alpha_plane_;
+    std::vector<unsigned char> bgra_;
+    std::vector<unsigned char> gray_;
+    unsigned char full_range_[256]; // limited-range luma -> 0..255
+
+public:
+    Y4mSource(std::unique_ptr<ByteStream> in, int width, int height, Chroma chroma, bool alpha_plane)
+        : in_(std::move(in)), width_(width), height_(height), chroma_(chroma), alpha_plane_(alpha_plane) {
+        // Same rounding as the color conversion below with no chroma
+        for (int v = 0; v < 256; ++v) full_range_[v] = clamp_byte((298 * (v - 16) + 128) >> 8);
+    }
+
+    const char* format() const override { return "YUV4MPEG2"; }
+
+    bool next(ImageView& frame) override {
+        if (in_->peek() < 0) return false;
+        std::string line;
+        if (!read_line(*in_, line) || line.compare(0, 5, "FRAME") != 0) {
+            error_ = "Expected a FRAME header at byte " + std::to_string(in_->position());
+            return false;
+        }
+
+        const size_t luma_size = static_cast<size_t>(width_) * height_;
+        const int chroma_width = chroma_ == Chroma::C444 ? width_ : (width_ + 1) / 2;
+        const int chroma_height = chroma_ == Chroma::C420 ? (height_ + 1) / 2 : height_;
+        const size_t chroma_size = chroma_ == Chroma::Mono ? 0 : static_cast<size_t>(chroma_width) * chroma_height;
+        const size_t frame_size = luma_size + 2 * chroma_size + (alpha_plane_ ? luma_size : 0);
+
+        const unsigned char* planes = in_->read(frame_size);
+        if (!planes) {
+            error_ = "Truncated frame at byte " + std::to_string(in_->position());
+            return false;
+        }
+        const unsigned char* y_plane = planes;
+        const unsigned char* u_plane = planes + luma_size;
+        const unsigned char* v_plane = u_plane + chroma_size;
+
+        if (chroma_ == Chroma::Mono) {
+            // Only luma to expand to full range; the renderer reads a gray image directly
+            gray_.resize(luma_size);
+            for (size_t i = 0; i < luma_size; ++i) gray_[i] = full_range_[y_plane[i]];
+            frame = {gray_.data(), width_, height_, static_cast<size_t>(width_), PixelFormat::Gray8};
+            return true;
+        }
+
+        bgra_.resize(luma_size * 4);
+        unsigned char* dst = bgra_.data();
+        const int x_shift = chroma_ == Chroma::C444 ? 0 : 1;
+        const int y_shift = chroma_ == Chroma::C420 ? 1 : 0;
+        for (int y = 0; y < height_; ++y) {
+            const unsigned char* y_row = y_plane + static_cast<size_t>(y) * width_;
+            const size_t chroma_row = static_cast<size_t>(y >> y_shift) * chroma_width;
+            for (int x = 0; x < width_; ++x, dst += 4) {
+                // 8.8 fixed-point BT.601: 298/256 = 255/219, etc.
+                const int c = 298 * (y_row[x] - 16) + 128;
+                int d = 0, e = 0;
+                if (chroma_size) {
+                    d = u_plane[chroma_row + (x >> x_shift)] - 128;
+                    e = v_plane[chroma_row + (x >> x_shift)] - 128;
+                }
+                dst[0] = clamp_byte((c + 516 * d) >> 8);
+                dst[1] = clamp_byte((c - 100 * d - 208 * e) >> 8);
+                dst[2] = clamp_byte((c + 409 * e) >> 8);
+                dst[3] = 255;
+            }
+        }
+        frame = {bgra_.data(), width_, height_, static_cast<size_t>(width_) * 4};
+        return true;
+    }
+};
+
+std::unique_ptr<FrameSource> open_y4m(std::unique_ptr<ByteStream> in, const std::string& header, std::string& error) {
+    int width = 0, height = 0;
+    Chroma chroma = Chroma::C420; // the format's default
+    bool alpha_plane = false;
+    size_t pos = header.find(' ');
+    while (pos != std::string::npos) {
+        const size_t start = pos + 1;
+        pos = header.find(' ', start);
+        const std::string param = header.substr(start, pos == std::string::npos ? std::string::npos : pos - start);
+        if (param.empty()) continue;
+        const std::string value = param.substr(1);
+        switch (param[0]) {
+        case 'W':
+            if (!parse_dimension(value, width)) width = 0;
+            break;
+        case 'H':
+            if (!parse_dimension(value, height)) height = 0;
+            break;
+        case 'C':
+            // 420jpeg, 420paldv, 420mpeg2 and 420 differ only in chroma siting
+            if (value == "420" || value == "420jpeg" || value == "420paldv" || value == "420mpeg2") {
+                chroma = Chroma::C420;
+            } else if (value == "422") {
+                chroma = Chroma::C422;
+            } else if (value == "444" || value == "444alpha") {
+                chroma = Chroma::C444;
+                alpha_plane = value == "444alpha";
+            } else if (value == "mono") {
+                chroma = Chroma::Mono;
+            } else {
+                error = "Unsupported Y4M colorspace '" + value + "' (only 8-bit samples are supported)";
+                return nullptr;
+            }
+            break;
+        default:
+            break; // frame rate, interlacing, aspect and extensions don't affect decoding
+        }
+    }
+    if (width == 0 || height == 0) {
+        error = "Malformed Y4M header";
+        return nullptr;
+    }
+    return std::unique_ptr<FrameSource>(new Y4mSource(std::move(in), width, height, chroma, alpha_plane));
+}
+
+} // namespace
+
+std::unique_ptr<FrameSource> open_frame_source(const std::string& path, std::string& error) {
+    std::unique_ptr<ByteStream> in = ByteStream::open(path, error);
+    if (!in) return nullptr;
+
+    switch (in->peek()) {
+    case 'P':
+        return std::unique_ptr<FrameSource>(new PnmSource(std::move(in)));
+    case 'B':
+    case 'Y': {
+        std::string header;
+        read_line(*in, header);
+        if (header.compare(0, 10, "YUV4MPEG2 ") == 0) {
+            return open_y4m(std::move(in), header, error);
+        }
+        if (header.compare(0, 5, "BGRA ") == 0) {
+            const size_t split = header.find(' ', 5);
+            int width = 0, height = 0;
+            if (split == std::string::npos || !parse_dimension(header.substr(5, split - 5), width) ||
+                !parse_dimension(header.substr(split + 1), height)) {
+                error = "Malformed raw BGRA header '" + header + "'";
+                return nullptr;
+            }
+            return std::unique_ptr<FrameSource>(new RawBgraSource(std::move(in), width, height));
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    error = "Unrecognized input format in '" + path + "' (expected raw BGRA, PPM/PAM or Y4M)";
+    return nullptr;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "image_view.h"
+
+class ByteStream;
+
+/**
+ * @brief A sequence of frames to render, as an alternative to live screen capture.
+ *
+ * Frames come in whichever PixelFormat is closest to the file's own layout (RGB for PPM,
+ * gray for mono video), so nothing is converted that the downscaler can read directly.
+ */
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    /**
+     * @brief Reads the next frame.
+     * @param frame Receives a view that stays valid until the next call.
+     * @return False at the end of the input, or on malformed input (error() is then set).
+     */
+    virtual bool next(ImageView& frame) = 0;
+
+    // Short name of the container format, for diagnostics
+    virtual const char* format() const = 0;
+
+    const std::string& error() const { return error_; }
+
+protected:
+    std::string error_;
+};
+
+/**
+ * @brief Opens a file ("-" for stdin) of frames, detecting the format from its first bytes:
+ *   - raw BGRA: a "BGRA <width> <height>\n" header, then frames of width*height*4 bytes
+ *   - PPM (P6) or PAM (P7, RGB or RGB_ALPHA) images, concatenated back to back
+ *   - YUV4MPEG2 (8-bit 4:2:0, 4:2:2, 4:4:4 or mono)
+ * @return Null with `error` set if the file cannot be opened or the format is not recognized.
+ */
+std::unique_ptr<FrameSource> open_frame_source(const std::string& path, std::string& error);
@@ -0,0 +1,140 @@
+#include "glyph_table.h"
+
+#include <cstring>
+
+namespace {
+
+// Code page 437 bytes for the non-ASCII glyphs used by the ramps
+struct Cp437Glyph {
+    uint32_t codepoint;
+    unsigned char byte;
+};
+const Cp437Glyph CP437_GLYPHS[] = {
+    {0x2591, 0xB0}, // ░
+    {0x2592, 0xB1}, // ▒
+    {0x2593, 0xB2}, // ▓
+    {0x2588, 0xDB}, // █
+    {0x2584, 0xDC}, // ▄
+    {0x2580, 0xDF}, // ▀
+};
+
+} // namespace
+
+std::vector<uint32_t> decode_utf8(const std::string& text) {
+    std::vector<uint32_t> codepoints;
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(text.data());
+    const size_t n = text.size();
+    for (size_t i = 0; i < n;) {
+        const unsigned char lead = s[i];
+        size_t len = 0;
+        uint32_t cp = 0;
+        if (lead < 0x80) {
+            len = 1;
+            cp = lead;
+        } else if ((lead >> 5) == 0x6) {
+            len = 2;
+            cp = lead & 0x1F;
+        } else if ((lead >> 4) == 0xE) {
+            len = 3;
+            cp = lead & 0x0F;
+        } else if ((lead >> 3) == 0x1E) {
+            len = 4;
+            cp = lead & 0x07;
+        }
+        bool valid = len > 0 && i + len <= n;
+        for (size_t k = 1; valid && k < len; ++k) {
+            if ((s[i + k] & 0xC0) != 0x80) {
+                valid = false;
+            } else {
+                cp = (cp << 6) | (s[i + k] & 0x3F);
+            }
+        }
+        if (valid) {
+            codepoints.push_back(cp);
+            i += len;
+        } else {
+            codepoints.push_back(lead); // Latin-1
+            ++i;
+        }
+    }
+    return codepoints;
+}
+
+size_t encode_glyph(uint32_t codepoint, GlyphEncoding encoding, char* out) {
+    if (encoding == GlyphEncoding::CodePage437) {
+        if (codepoint < 0x80) {
+            out[0] = static_cast<char>(codepoint);
+            return 1;
+        }
+        for (const Cp437Glyph& g : CP437_GLYPHS) {
+            if (g.codepoint == codepoint) {
+                out[0] = static_cast<char>(g.byte);
+                return 1;
+            }
+        }
+        out[0] = '?';
+        return 1;
+    }
+    if (codepoint < 0x80) {
+        out[0] = static_cast<char>(codepoint);
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (codepoint >> 6));
+        out[1] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (codepoint >> 12));
+        out[1] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (codepoint >> 18));
+    out[1] = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+GlyphTable::GlyphTable(const std::string& ramp, GlyphEncoding encoding) {
+    std::vector<uint32_t> codepoints = decode_utf8(ramp);
+    if (codepoints.empty()) codepoints.push_back(' ');
+    glyph_count_ = codepoints.size();
+
+    // Same linear mapping as the original byte-indexed lookup, but over glyphs; of a ramp
+    // longer than the 256 levels, only the glyphs that mapping reaches are kept
+    if (codepoints.size() > 256) {
+        std::vector<uint32_t> reached(256);
+        for (size_t i = 0; i < 256; ++i) reached[i] = codepoints[i * (codepoints.size() - 1) / 255];
+        codepoints.swap(reached);
+    }
+    codepoints_ = codepoints;
+    glyph_bytes_.resize(codepoints.size());
+    glyph_length_.resize(codepoints.size());
+    max_width_ = 1;
+    for (size_t g = 0; g < codepoints.size(); ++g) {
+        char bytes[MAX_GLYPH_BYTES] = {};
+        const size_t len = encode_glyph(codepoints[g], encoding, bytes);
+        memcpy(&glyph_bytes_[g], bytes, MAX_GLYPH_BYTES);
+        glyph_length_[g] = static_cast<uint8_t>(len);
+        if (len > max_width_) max_width_ = len;
+    }
+    set_levels(linear_levels(codepoints.size()));
+}
+
+void GlyphTable::set_levels(const LevelTable& levels) {
+    for (int i = 0; i < 256; ++i) {
+        const uint8_t g = levels[i] < glyph_bytes_.size() ? levels[i] : static_cast<uint8_t>(glyph_bytes_.size() - 1);
+        level_bytes_[i] = glyph_bytes_[g];
+        level_length_[i] = glyph_length_[g];
+        memcpy(&ascii_lut_[i], &glyph_bytes_[g], 1); // the first byte, whatever the endianness
+    }
+}
+
+char* GlyphTable::write_row(const unsigned char* gray, size_t count, char* out) const {
+    // Bolt: Always copy the whole 4-byte slot and advance by the real length; a fixed-size
+    // memcpy compiles to a single store, with no per-glyph branching on width
+    for (size_t x = 0; x < count; ++x) out = write_glyph(gray[x], out);
+    return out;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Byte encoding the console expects for the glyphs.
+enum class GlyphEncoding {
+    Utf8,
+    CodePage437, // Windows OEM US; used by the codepage437 mode
+};
+
+// Glyph index of each of the 256 gray levels
+using LevelTable = std::array<uint8_t, 256>;
+
+/**
+ * @brief The linear mapping of gray levels onto a ramp of `glyphs` glyphs (1-256):
+ * level i takes glyph i * (glyphs - 1) / 255.
+ */
+constexpr LevelTable linear_levels(size_t glyphs) {
+    LevelTable levels{};
+    for (size_t i = 0; i < 256; ++i) levels[i] = static_cast<uint8_t>(i * (glyphs - 1) / 255);
+    return levels;
+}
+
+/**
+ * @brief Number of glyphs in a UTF-8 ramp, or 0 if it is not well-formed UTF-8 (so that
+ * built-in ramps can be checked at compile time).
+ */
+constexpr size_t utf8_glyph_count(const char* text) {
+    size_t count = 0;
+    for (size_t i = 0; text[i];) {
+        const unsigned char lead = static_cast<unsigned char>(text[i]);
+        const size_t len = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        if (!len) return 0;
+        for (size_t k = 1; k < len; ++k) {
+            if ((static_cast<unsigned char>(text[i + k]) & 0xC0) != 0x80) return 0;
+        }
+        i += len;
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * @brief Maps the 256 gray levels to pre-encoded glyphs of a ramp.
+ *
+ * The ramp is decoded into codepoints first, so multi-byte UTF-8 glyphs are never split.
+ * Each level stores its encoded bytes in a fixed 4-byte slot plus a length, which lets rows
+ * be written with one fixed-size copy per cell into a buffer presized for the widest glyph.
+ */
+class GlyphTable {
+public:
+    // Widest encoded glyph (a 4-byte UTF-8 sequence)
+    static const size_t MAX_GLYPH_BYTES = 4;
+    // Bytes that write_row() may touch past the last glyph it writes
+    static const size_t ROW_SLACK = MAX_GLYPH_BYTES - 1;
+
+    explicit GlyphTable(const std::string& ramp, GlyphEncoding encoding = GlyphEncoding::Utf8);
+
+    // Number of glyphs in the ramp
+    size_t size() const { return glyph_count_; }
+    // The glyphs levels can map to: the ramp's, or the 256 the linear mapping reaches of a
+    // longer ramp
+    const std::vector<uint32_t>& codepoints() const { return codepoints_; }
+
+    /**
+     * @brief Maps each gray level to the glyph `levels` gives it, an index into codepoints().
+     * The table starts out as linear_levels() of the glyph count.
+     */
+    void set_levels(const LevelTable& levels);
+    // Longest encoded glyph in bytes
+    size_t max_width() const { return max_width_; }
+    // True when every glyph is one byte, so ascii_lut() can be used directly
+    bool single_byte() const { return max_width_ == 1; }
+    // Gray level to byte table; only meaningful when single_byte()
+    const char* ascii_lut() const { return ascii_lut_; }
+
+    /**
+     * @brief Worst-case bytes for a row of `cells` glyphs, including ROW_SLACK.
+     */
+    size_t row_capacity(size_t cells) const { return cells * max_width_ + ROW_SLACK; }
+
+    /**
+     * @brief Writes the glyphs for `count` gray levels.
+     * @param out Must have room for row_capacity(count) bytes.
+     * @return One past the last byte written.
+     */
+    char* write_row(const unsigned char* gray, size_t count, char* out) const;
+
+    /**
+     * @brief Writes the glyph for one gray level.
+     * @param out Must have room for MAX_GLYPH_BYTES.
+     * @return One past the last byte of the glyph.
+     */
+    char* write_glyph(unsigned char gray, char* out) const {
+        memcpy(out, &level_bytes_[gray], MAX_GLYPH_BYTES);
+        return out + level_length_[gray];
+    }
+
+private:
+    uint32_t level_bytes_[256]; // encoded glyph, little-endian in a 4-byte slot
+    uint8_t level_length_[256];
+    char ascii_lut_[256];
+    std::vector<uint32_t> codepoints_;
+    std::vector<uint32_t> glyph_bytes_; // each of codepoints_ encoded, as in level_bytes_
+    std::vector<uint8_t> glyph_length_;
+    size_t glyph_count_ = 0;
+    size_t max_width_ = 1;
+};
+
+/**
+ * @brief Decodes a UTF-8 string into codepoints.
+ * Bytes that are not valid UTF-8 are taken as Latin-1, so legacy 8-bit ramps still work.
+ */
+std::vector<uint32_t> decode_utf8(const std::string& text);
+
+/**
+ * @brief Encodes one codepoint; returns the number of bytes written to `out` (1-4).
+ */
+size_t encode_glyph(uint32_t codepoint, GlyphEncoding encoding, char* out);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+// Byte layout of one pixel
+enum class PixelFormat {
+    Bgra,  // blue, green, red, unused: X11 and GDI captures
+    Rgba,  // red, green, blue, unused
+    Rgb24, // red, green, blue: PPM and most image decoders
+    Gray8, // luma only
+};
+
+// Number of PixelFormat values, for tables indexed by format
+const int PIXEL_FORMATS = 4;
+
+/**
+ * @brief Channel offsets of a pixel format, for kernels instantiated per format so the
+ * layout is fixed at compile time rather than tested per pixel. Gray has all three
+ * channels on its one byte.
+ */
+template <PixelFormat F>
+struct PixelLayout {
+    static constexpr size_t BYTES = F == PixelFormat::Rgb24 ? 3 : F == PixelFormat::Gray8 ? 1 : 4;
+    static constexpr size_t BLUE = F == PixelFormat::Bgra ? 0 : F == PixelFormat::Gray8 ? 0 : 2;
+    static constexpr size_t GREEN = F == PixelFormat::Gray8 ? 0 : 1;
+    static constexpr size_t RED = F == PixelFormat::Bgra ? 2 : 0;
+};
+
+constexpr size_t bytes_per_pixel(PixelFormat format) {
+    return format == PixelFormat::Rgb24 ? 3 : format == PixelFormat::Gray8 ? 1 : 4;
+}
+
+// Non-owning view of an image (rows `stride` bytes apart), BGRA unless `format` says otherwise.
+struct ImageView {
+    const unsigned char* data;
+    int width;
+    int height;
+    size_t stride;
+    PixelFormat format = PixelFormat::Bgra;
+
+    const unsigned char* row(int y) const { return data + static_cast<size_t>(y) * stride; }
+};
@@ -0,0 +1,362 @@
+#include "luma_kernels.h"
+
+#include <cstring>
+
+#ifdef SCRN_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+template <PixelFormat F>
+static inline unsigned int luma_of(const unsigned char* p) {
+    using Layout = PixelLayout<F>;
+    return (static_cast<unsigned int>(p[Layout::RED]) * 13933 + static_cast<unsigned int>(p[Layout::GREEN]) * 46871 +
+            static_cast<unsigned int>(p[Layout::BLUE]) * 4732) >> 16;
+}
+
+template <PixelFormat F>
+void luma_row_scalar(const unsigned char* pixels, size_t count, unsigned char* gray) {
+    if constexpr (F == PixelFormat::Gray8) {
+        // Already luma
+        std::memcpy(gray, pixels, count);
+    } else {
+        for (size_t x = 0; x < count; ++x) gray[x] = static_cast<unsigned char>(luma_of<F>(pixels + x * PixelLayout<F>::BYTES));
+    }
+}
+
+template <PixelFormat F>
+void ascii_row_scalar(const unsigned char* pixels, size_t count, const char* lut, char* out, uint32_t* histogram) {
+    if (!histogram) {
+        for (size_t x = 0; x < count; ++x) out[x] = lut[luma_of<F>(pixels + x * PixelLayout<F>::BYTES)];
+        return;
+    }
+    for (size_t x = 0; x < count; ++x) {
+        const unsigned int gray = luma_of<F>(pixels + x * PixelLayout<F>::BYTES);
+        out[x] = lut[gray];
+        ++histogram[(x % LEVEL_HISTOGRAMS) * LEVEL_BINS + gray];
+    }
+}
+
+void count_levels(const unsigned char* gray, size_t count, uint32_t* histogram) {
+    size_t x = 0;
+    for (; x + 4 <= count; x += 4) {
+        ++histogram[gray[x]];
+        ++histogram[LEVEL_BINS + gray[x + 1]];
+        ++histogram[2 * LEVEL_BINS + gray[x + 2]];
+        ++histogram[3 * LEVEL_BINS + gray[x + 3]];
+    }
+    for (; x < count; ++x) ++histogram[gray[x]];
+}
+
+void fold_levels(uint32_t* histograms, uint32_t* histogram) {
+    // Plain loops over fixed sizes, which the compiler vectorizes
+    for (size_t v = 0; v < LEVEL_BINS; ++v) histogram[v] = histograms[v];
+    for (size_t h = 1; h < LEVEL_HISTOGRAMS; ++h) {
+        for (size_t v = 0; v < LEVEL_BINS; ++v) histogram[v] += histograms[h * LEVEL_BINS + v];
+    }
+    std::memset(histograms, 0, LEVEL_HISTOGRAMS * LEVEL_BINS * sizeof(uint32_t));
+}
+
+template void luma_row_scalar<PixelFormat::Bgra>(const unsigned char*, size_t, unsigned char*);
+template void luma_row_scalar<PixelFormat::Rgba>(const unsigned char*, size_t, unsigned char*);
+template void luma_row_scalar<PixelFormat::Rgb24>(const unsigned char*, size_t, unsigned char*);
+template void luma_row_scalar<PixelFormat::Gray8>(const unsigned char*, size_t, unsigned char*);
+template void ascii_row_scalar<PixelFormat::Bgra>(const unsigned char*, size_t, const char*, char*, uint32_t*);
+template void ascii_row_scalar<PixelFormat::Rgba>(const unsigned char*, size_t, const char*, char*, uint32_t*);
+template void ascii_row_scalar<PixelFormat::Rgb24>(const unsigned char*, size_t, const char*, char*, uint32_t*);
+template void ascii_row_scalar<PixelFormat::Gray8>(const unsigned char*, size_t, const char*, char*, uint32_t*);
+
+void braille_row_scalar(const unsigned char* const* luma, size_t cells, unsigned char threshold,
+                        unsigned char* patterns) {
+    // Dots 1-3 run down the left column, 4-6 down the right, and 7-8 are the bottom row
+    static const unsigned char DOT_BITS[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+    for (size_t x = 0; x < cells; ++x) {
+        unsigned int bits = 0;
+        for (int row = 0; row < 4; ++row) {
+            const unsigned char* p = luma[row] + x * 2;
+            if (p[0] < threshold) bits |= DOT_BITS[row][0];
+            if (p[1] < threshold) bits |= DOT_BITS[row][1];
+        }
+        patterns[x] = static_cast<unsigned char>(bits);
+    }
+}
+
+#ifdef SCRN_X86
+// Weights of bytes 0 and 2 of a 4-byte pixel, as the two 16-bit halves of a madd operand
+template <PixelFormat F>
+constexpr int outer_weights() {
+    static_assert(PixelLayout<F>::BYTES == 4, "SIMD kernels take 4-byte pixels");
+    return F == PixelFormat::Bgra ? (13933 << 16) | 4732 : (4732 << 16) | 13933;
+}
+
+// Luma of 4 BGRA (or RGBA) pixels as 32-bit lanes.
+//
+// _mm_madd_epi16 multiplies 16-bit lanes and adds adjacent pairs, so masking each pixel
+// to [b, r] and shifting it to [g, a] yields b*4732 + r*13933 and g*wg in one instruction
+// each. 46871 does not fit a signed 16-bit weight, so g is weighted by 46871 - 65536 and
+// the missing g*65536 is added back as g << 16.
+template <PixelFormat F>
+static inline __m128i luma4_sse2(__m128i px) {
+    const __m128i mask_br = _mm_set1_epi32(0x00FF00FF);
+    const __m128i weight_br = _mm_set1_epi32(outer_weights<F>());
+    const __m128i weight_ga = _mm_set1_epi32(static_cast<unsigned short>(46871 - 65536));
+
+    const __m128i br = _mm_and_si128(px, mask_br);
+    const __m128i ga = _mm_srli_epi16(px, 8);
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(br, weight_br), _mm_madd_epi16(ga, weight_ga));
+    sum = _mm_add_epi32(sum, _mm_slli_epi32(ga, 16));
+    return _mm_srli_epi32(sum, 16);
+}
+
+// Luma of 16 pixels as bytes.
+template <PixelFormat F>
+static inline __m128i luma16_sse2(const unsigned char* pixels) {
+    const __m128i* src = reinterpret_cast<const __m128i*>(pixels);
+    const __m128i l0 = luma4_sse2<F>(_mm_loadu_si128(src));
+    const __m128i l1 = luma4_sse2<F>(_mm_loadu_si128(src + 1));
+    const __m128i l2 = luma4_sse2<F>(_mm_loadu_si128(src + 2));
+    const __m128i l3 = luma4_sse2<F>(_mm_loadu_si128(src + 3));
+    return _mm_packus_epi16(_mm_packs_epi32(l0, l1), _mm_packs_epi32(l2, l3));
+}
+
+template <PixelFormat F>
+void luma_row_sse2(const unsigned char* pixels, size_t count, unsigned char* gray) {
+    size_t x = 0;
+    for (; x + 16 <= count; x += 16) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(gray + x), luma16_sse2<F>(pixels + x * 4));
+    }
+    luma_row_scalar<F>(pixels + x * 4, count - x, gray + x);
+}
+
+template <PixelFormat F>
+void ascii_row_sse2(const unsigned char* pixels, size_t count, const char* lut, char* out, uint32_t* histogram) {
+    alignas(16) unsigned char gray[16];
+    size_t x = 0;
+    for (; x + 16 <= count; x += 16) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(gray), luma16_sse2<F>(pixels + x * 4));
+        // There is no byte gather, so the 256-entry table is applied with plain loads, and
+        // the levels are counted from the same 16 bytes
+        for (int i = 0; i < 16; ++i) out[x + i] = lut[gray[i]];
+        if (histogram) count_levels(gray, 16, histogram);
+    }
+    ascii_row_scalar<F>(pixels + x * 4, count - x, lut, out + x, histogram);
+}
+
+template void luma_row_sse2<PixelFormat::Bgra>(const unsigned char*, size_t, unsigned char*);
+template void luma_row_sse2<PixelFormat::Rgba>(const unsigned char*, size_t, unsigned char*);
+template void ascii_row_sse2<PixelFormat::Bgra>(const unsigned char*, size_t, const char*, char*, uint32_t*);
+template void ascii_row_sse2<PixelFormat::Rgba>(const unsigned char*, size_t, const char*, char*, uint32_t*);
+
+// Dot bits of the left and right sample of each cell, per sample row, as 16-bit lanes
+// (little-endian: the low byte weights the left sample)
+static const short BRAILLE_WEIGHTS[4] = {0x0801, 0x1002, 0x2004, (short)0x8040};
+
+void braille_row_sse2(const unsigned char* const* luma, size_t cells, unsigned char threshold,
+                      unsigned char* patterns) {
+    // There is no unsigned byte compare; flipping the top bit maps it onto the signed one
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold ^ 0x80));
+    const __m128i low_byte = _mm_set1_epi16(0x00FF);
+    size_t x = 0;
+    for (; x + 8 <= cells; x += 8) {
+        // Each sample below the threshold contributes its dot's bit; a cell's two samples
+        // sit in one 16-bit lane, so folding the lane's bytes together gives its pattern
+        __m128i bits = _mm_setzero_si128();
+        for (int row = 0; row < 4; ++row) {
+            const __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(luma[row] + x * 2)), bias);
+            bits = _mm_or_si128(bits, _mm_and_si128(_mm_cmplt_epi8(v, limit), _mm_set1_epi16(BRAILLE_WEIGHTS[row])));
+        }
+        bits = _mm_or_si128(_mm_and_si128(bits, low_byte), _mm_srli_epi16(bits, 8));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(patterns + x), _mm_packus_epi16(bits, bits));
+    }
+    const unsigned char* rest[4] = {luma[0] + x * 2, luma[1] + x * 2, luma[2] + x * 2, luma[3] + x * 2};
+    braille_row_scalar(rest, cells - x, threshold, patterns + x);
+}
+
+template <PixelFormat F>
+SCRN_TARGET_AVX2
+static inline __m256i luma8_avx2(__m256i px) {
+    const __m256i mask_br = _mm256_set1_epi32(0x00FF00FF);
+    const __m256i weight_br = _mm256_set1_epi32(outer_weights<F>());
+    const __m256i weight_ga = _mm256_set1_epi32(static_cast<unsigned short>(46871 - 65536));
+
+    const __m256i br = _mm256_and_si256(px, mask_br);
+    const __m256i ga = _mm256_srli_epi16(px, 8);
+    __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(br, weight_br), _mm256_madd_epi16(ga, weight_ga));
+    sum = _mm256_add_epi32(sum, _mm256_slli_epi32(ga, 16));
+    return _mm256_srli_epi32(sum, 16);
+}
+
+// Luma of 32 pixels as bytes.
+template <PixelFormat F>
+SCRN_TARGET_AVX2
+static inline __m256i luma32_avx2(const unsigned char* pixels) {
+    // The packs work per 128-bit lane; this restores pixel order across lanes
+    const __m256i lane_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const __m256i* src = reinterpret_cast<const __m256i*>(pixels);
+    const __m256i l0 = luma8_avx2<F>(_mm256_loadu_si256(src));
+    const __m256i l1 = luma8_avx2<F>(_mm256_loadu_si256(src + 1));
+    const __m256i l2 = luma8_avx2<F>(_mm256_loadu_si256(src + 2));
+    const __m256i l3 = luma8_avx2<F>(_mm256_loadu_si256(src + 3));
+    const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(l0, l1), _mm256_packs_epi32(l2, l3));
+    return _mm256_permutevar8x32_epi32(packed, lane_order);
+}
+
+template <PixelFormat F>
+SCRN_TARGET_AVX2
+void luma_row_avx2(const unsigned char* pixels, size_t count, unsigned char* gray) {
+    size_t x = 0;
+    for (; x + 32 <= count; x += 32) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(gray + x), luma32_avx2<F>(pixels + x * 4));
+    }
+    _mm256_zeroupper();
+    luma_row_sse2<F>(pixels + x * 4, count - x, gray + x);
+}
+
+template <PixelFormat F>
+SCRN_TARGET_AVX2
+void ascii_row_avx2(const unsigned char* pixels, size_t count, const char* lut, char* out, uint32_t* histogram) {
+    alignas(32) unsigned char gray[32];
+    size_t x = 0;
+    for (; x + 32 <= count; x += 32) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(gray), luma32_avx2<F>(pixels + x * 4));
+        for (int i = 0; i < 32; ++i) out[x + i] = lut[gray[i]];
+        if (histogram) count_levels(gray, 32, histogram);
+    }
+    // Clear the upper halves before running legacy SSE code, or every SSE instruction
+    // after this pays an AVX/SSE transition penalty
+    _mm256_zeroupper();
+    ascii_row_sse2<F>(pixels + x * 4, count - x, lut, out + x, histogram);
+}
+
+template void luma_row_avx2<PixelFormat::Bgra>(const unsigned char*, size_t, unsigned char*);
+template void luma_row_avx2<PixelFormat::Rgba>(const unsigned char*, size_t, unsigned char*);
+template void ascii_row_avx2<PixelFormat::Bgra>(const unsigned char*, size_t, const char*, char*, uint32_t*);
+template void ascii_row_avx2<PixelFormat::Rgba>(const unsigned char*, size_t, const char*, char*, uint32_t*);
+
+SCRN_TARGET_AVX2
+void braille_row_avx2(const unsigned char* const* luma, size_t cells, unsigned char threshold,
+                      unsigned char* patterns) {
+    const __m256i bias = _mm256_set1_epi8(static_cast<char>(0x80));
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(threshold ^ 0x80));
+    const __m256i low_byte = _mm256_set1_epi16(0x00FF);
+    size_t x = 0;
+    for (; x + 16 <= cells; x += 16) {
+        __m256i bits = _mm256_setzero_si256();
+        for (int row = 0; row < 4; ++row) {
+            const __m256i v =
+                _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(luma[row] + x * 2)), bias);
+            bits = _mm256_or_si256(bits, _mm256_and_si256(_mm256_cmpgt_epi8(limit, v),
+                                                          _mm256_set1_epi16(BRAILLE_WEIGHTS[row])));
+        }
+        bits = _mm256_or_si256(_mm256_and_si256(bits, low_byte), _mm256_srli_epi16(bits, 8));
+        // The pack works per 128-bit lane: the patterns end up in quadwords 0 and 2
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(bits, bits), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(patterns + x), _mm256_castsi256_si128(packed));
+    }
+    _mm256_zeroupper();
+    const unsigned char* rest[4] = {luma[0] + x * 2, luma[1] + x * 2, luma[2] + x * 2, luma[3] + x * 2};
+    braille_row_sse2(rest, cells - x, threshold, patterns + x);
+}
+
+bool cpu_has_avx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    // OSXSAVE and AVX, then check the OS saves the YMM registers
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+#endif
+
+namespace {
+
+template <PixelFormat F>
+AsciiRowFn ascii_row_kernel(const char** name) {
+#ifdef SCRN_X86
+    // 3- and 1-byte pixels don't line up with the vector lanes; they take the scalar loop,
+    // which the compiler vectorizes for its fixed layout
+    if constexpr (PixelLayout<F>::BYTES == 4) {
+        if (cpu_has_avx2()) {
+            if (name) *name = "avx2";
+            return ascii_row_avx2<F>;
+        }
+        if (name) *name = "sse2";
+        return ascii_row_sse2<F>;
+    }
+#endif
+    if (name) *name = "scalar";
+    return ascii_row_scalar<F>;
+}
+
+template <PixelFormat F>
+LumaRowFn luma_row_kernel(const char** name) {
+#ifdef SCRN_X86
+    if constexpr (PixelLayout<F>::BYTES == 4) {
+        if (cpu_has_avx2()) {
+            if (name) *name = "avx2";
+            return luma_row_avx2<F>;
+        }
+        if (name) *name = "sse2";
+        return luma_row_sse2<F>;
+    }
+#endif
+    if (name) *name = "scalar";
+    return luma_row_scalar<F>;
+}
+
+} // namespace
+
+AsciiRowFn select_ascii_row_kernel(const char** name, PixelFormat format) {
+    switch (format) {
+    case PixelFormat::Rgba:
+        return ascii_row_kernel<PixelFormat::Rgba>(name);
+    case PixelFormat::Rgb24:
+        return ascii_row_kernel<PixelFormat::Rgb24>(name);
+    case PixelFormat::Gray8:
+        return ascii_row_kernel<PixelFormat::Gray8>(name);
+    default:
+        return ascii_row_kernel<PixelFormat::Bgra>(name);
+    }
+}
+
+LumaRowFn select_luma_row_kernel(const char** name, PixelFormat format) {
+    switch (format) {
+    case PixelFormat::Rgba:
+        return luma_row_kernel<PixelFormat::Rgba>(name);
+    case PixelFormat::Rgb24:
+        return luma_row_kernel<PixelFormat::Rgb24>(name);
+    case PixelFormat::Gray8:
+        return luma_row_kernel<PixelFormat::Gray8>(name);
+    default:
+        return luma_row_kernel<PixelFormat::Bgra>(name);
+    }
+}
+
+BrailleRowFn select_braille_row_kernel(const char** name) {
+#ifdef SCRN_X86
+    if (cpu_has_avx2()) {
+        if (name) *name = "avx2";
+        return braille_row_avx2;
+    }
+    if (name) *name = "sse2";
+    return braille_row_sse2;
+#else
+    if (name) *name = "scalar";
+    return braille_row_scalar;
+#endif
+}
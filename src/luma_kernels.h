@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "image_view.h"
+#include "simd_config.h"
+
+// Row kernels for the pixel -> luma -> character conversion.
+//
+// Every kernel computes the same 16-bit fixed point luma as the original scalar loop
+// (0.2126*r + 0.7152*g + 0.0722*b, weights 13933/46871/4732 >> 16), so they are
+// interchangeable bit for bit; they only differ in how many pixels they handle per step.
+// Kernels are instantiated per PixelFormat, so the channel layout is a compile-time
+// constant; the weights sum to 65536, so gray pixels come out unchanged.
+
+// Luma histograms are kept as LEVEL_HISTOGRAMS interleaved sub-histograms of LEVEL_BINS
+// counts each: consecutive pixels go to different ones, so a run of one gray level doesn't
+// wait on a single counter. fold_levels() sums them.
+const size_t LEVEL_BINS = 256;
+const size_t LEVEL_HISTOGRAMS = 4;
+
+/**
+ * @brief Converts `count` pixels to characters.
+ * @param pixels Source pixels in the kernel's format (alpha ignored).
+ * @param count Number of pixels.
+ * @param lut 256-entry grayscale to character lookup table.
+ * @param out Destination, at least `count` bytes; no terminator is written.
+ * @param histogram If not null, LEVEL_HISTOGRAMS sub-histograms that the luma of every
+ *                  pixel is counted into, in the same pass.
+ */
+using AsciiRowFn = void (*)(const unsigned char* pixels, size_t count, const char* lut, char* out,
+                            uint32_t* histogram);
+
+/**
+ * @brief Converts `count` pixels to 8-bit luma.
+ * @param gray Destination, at least `count` bytes.
+ */
+using LumaRowFn = void (*)(const unsigned char* pixels, size_t count, unsigned char* gray);
+
+/**
+ * @brief Thresholds 2x4 luma samples per cell and packs them into braille dot patterns.
+ * @param luma Four rows of luma, each at least 2 * `cells` samples.
+ * @param threshold Samples darker than this become dots.
+ * @param patterns Destination, one byte per cell: bit n set = dot n + 1 (U+2800 + pattern).
+ */
+using BrailleRowFn = void (*)(const unsigned char* const* luma, size_t cells, unsigned char threshold,
+                              unsigned char* patterns);
+
+// Portable fallback, one pixel at a time; every format.
+template <PixelFormat F>
+void luma_row_scalar(const unsigned char* pixels, size_t count, unsigned char* gray);
+template <PixelFormat F>
+void ascii_row_scalar(const unsigned char* pixels, size_t count, const char* lut, char* out, uint32_t* histogram);
+void braille_row_scalar(const unsigned char* const* luma, size_t cells, unsigned char threshold,
+                        unsigned char* patterns);
+
+/**
+ * @brief Counts `count` luma values into LEVEL_HISTOGRAMS sub-histograms, for rows whose
+ * luma is already in memory.
+ */
+void count_levels(const unsigned char* gray, size_t count, uint32_t* histogram);
+
+/**
+ * @brief Sums the sub-histograms into `histogram` (LEVEL_BINS counts, overwritten) and
+ * clears them for the next rows.
+ */
+void fold_levels(uint32_t* histograms, uint32_t* histogram);
+
+#ifdef SCRN_X86
+// 16 pixels per step; Bgra and Rgba only.
+template <PixelFormat F>
+void luma_row_sse2(const unsigned char* pixels, size_t count, unsigned char* gray);
+template <PixelFormat F>
+void ascii_row_sse2(const unsigned char* pixels, size_t count, const char* lut, char* out, uint32_t* histogram);
+// 8 cells per step.
+void braille_row_sse2(const unsigned char* const* luma, size_t cells, unsigned char threshold,
+                      unsigned char* patterns);
+// 32 pixels per step; Bgra and Rgba only. Only call when cpu_has_avx2() is true.
+template <PixelFormat F>
+SCRN_TARGET_AVX2 void luma_row_avx2(const unsigned char* pixels, size_t count, unsigned char* gray);
+template <PixelFormat F>
+SCRN_TARGET_AVX2 void ascii_row_avx2(const unsigned char* pixels, size_t count, const char* lut, char* out,
+                                     uint32_t* histogram);
+// 16 cells per step.
+void braille_row_avx2(const unsigned char* const* luma, size_t cells, unsigned char threshold,
+                      unsigned char* patterns);
+
+/**
+ * @brief Runtime check for AVX2 support (CPU and OS-saved YMM state).
+ */
+bool cpu_has_avx2();
+#endif
+
+/**
+ * @brief Picks the fastest kernel the running CPU supports for pixels in `format`.
+ * @param name If not null, receives a short name of the chosen kernel ("avx2", "sse2", "scalar").
+ */
+AsciiRowFn select_ascii_row_kernel(const char** name = nullptr, PixelFormat format = PixelFormat::Bgra);
+
+/**
+ * @brief Luma-only counterpart of select_ascii_row_kernel(), for glyphs wider than a byte.
+ */
+LumaRowFn select_luma_row_kernel(const char** name = nullptr, PixelFormat format = PixelFormat::Bgra);
+
+/**
+ * @brief Braille counterpart of select_ascii_row_kernel().
+ */
+BrailleRowFn select_braille_row_kernel(const char** name = nullptr);
@@ -1,6 +1,9 @@
 #ifdef _WIN32
 #include <windows.h>
 #include <conio.h>
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
 #endif
 // Helper to restore console code page on exit (RAII)
 #ifdef _WIN32
@@ -38,274 +41,1710 @@ public:
 };
 #endif
 #include <locale>
-// Returns true if the ramp contains any non-ASCII (Unicode) characters
-bool ramp_has_unicode(const std::string& ramp) {
-    for (unsigned char c : ramp) {
-        if (c > 127) return true;
-    }
-    return false;
-}
 #include <iostream>
 #include <vector>
 #include <string>
 #include <chrono>
 #include <thread>
 #include <memory>
+#include <atomic>
 
-#ifdef _WIN32
-// Secure wrapper for sensitive memory that wipes data on destruction
-class SecureBuffer {
-    std::vector<unsigned char> buffer_;
-public:
-    SecureBuffer() = default;
-    ~SecureBuffer() {
-        if (!buffer_.empty()) {
-            SecureZeroMemory(buffer_.data(), buffer_.size());
-        }
-    }
-    // Prevent accidental copying which would leave unwiped duplicates
-    SecureBuffer(const SecureBuffer&) = delete;
-    SecureBuffer& operator=(const SecureBuffer&) = delete;
-
-    void resize(size_t new_size) {
-        if (new_size < buffer_.size()) {
-            // Wipe the data we are about to discard
-            SecureZeroMemory(buffer_.data() + new_size, buffer_.size() - new_size);
-        }
-        buffer_.resize(new_size);
-    }
-    unsigned char* data() { return buffer_.data(); }
-    const unsigned char* data() const { return buffer_.data(); }
-    size_t size() const { return buffer_.size(); }
-};
-#else
-// Fallback for non-Windows platforms (no secure wipe)
-class SecureBuffer {
-    std::vector<unsigned char> buffer_;
-public:
-    void resize(size_t new_size) { buffer_.resize(new_size); }
-    unsigned char* data() { return buffer_.data(); }
-    const unsigned char* data() const { return buffer_.data(); }
-    size_t size() const { return buffer_.size(); }
-};
-#endif
-
-// Platform-specific includes for clearing the console
+// Platform-specific includes for screen capture
 #ifdef _WIN32
 #include <windows.h>
-#else
-// On non-Windows platforms, this app will not compile with the GDI changes.
+#elif defined(__unix__) && !defined(__APPLE__)
+// Linux/BSD: capture through X11, using MIT-SHM to share the image with the server.
+#define SCRN_HAVE_X11 1
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ioctl.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <unistd.h>
+#include <cstring>
 #endif
 
 // --- Configuration ---
 
-// Desired console dimensions for the ASCII art.
-// Adjust these to match your terminal's size for best results.
+// Console dimensions for the ASCII art when the output is not a terminal (and for --input).
+// Live output follows the terminal's own size, including when it is resized.
 const int CONSOLE_WIDTH = 240; // Doubled for higher resolution
 const int CONSOLE_HEIGHT = 80;  // Doubled for higher resolution
 
+// Sentinel: Bound the cell grid so a bogus terminal size can't blow up the frame buffers
+const int MAX_CONSOLE_WIDTH = 1024;
+const int MAX_CONSOLE_HEIGHT = 512;
+
 
 #include <map>
 #include <iomanip>
+#include <fstream>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+
+#include "color.h"
+#include "diff_output.h"
+#include "dither.h"
+#include "downscale.h"
+#include "frame_pool.h"
+#include "frame_ring.h"
+#include "frame_scheduler.h"
+#include "frame_source.h"
+#include "glyph_table.h"
+#include "luma_kernels.h"
+#include "mosaic.h"
+#include "output_sink.h"
+#include "recording.h"
+#include "render.h"
+#include "stage_stats.h"
+#include "stream_server.h"
+#include "thread_pool.h"
+#include "tile_hash.h"
+#include "tone.h"
 
-// Map of modes to their ASCII ramps
-const std::map<std::string, std::string> ASCII_RAMPS = {
-    {"minimalist", "#+-."},
-    {"normal", "@%#*+=-:."},
-    {"normal2", "&$Xx+;:."},
-    {"alphabetic", "ABCDEFGHIJKLMNOPQRSTUVWXYZ"},
-    {"alphanumeric", "ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890abcdefghijklmnopqrstuvwxyz"},
-    {"numerical", "0896452317"},
-    {"extended", "@%#{}[]()<>^*+=~-:."},
-    {"math", "+-\xd7\xf7=≠≈∞√π"},
-    {"arrow", "↑↗→↘↓↙←↖"},
-    {"grayscale", "@$BWM#*oahkbdpwmZO0QCJYXzcvnxrjft/|()1{}[]-_+~<>i!lI;:,\"^`'."},
-    //{"max", "\xc6\xd1\xcaŒ\xd8M\xc9\xcb\xc8\xc3\xc2WQB\xc5\xe6#N\xc1\xfeE\xc4\xc0HKRŽœXg\xd0\xeaq\xdbŠ\xd5\xd4A€\xdfpm\xe3\xe2G\xb6\xf8\xf0\xe98\xda\xdc$\xebd\xd9\xfd\xe8\xd3\xde\xd6\xe5\xff\xd2b\xa5FD\xf1\xe1ZP\xe4š\xc7\xe0h\xfb\xa7\xddkŸ\xaeS9žUTe6\xb5Oyx\xce\xbef4\xf55\xf4\xfa&a\xfc™2\xf9\xe7w\xa9Y\xa30V\xcdL\xb13\xcf\xcc\xf3C@n\xf6\xf2s\xa2u‰\xbd\xbc‡zJƒ%\xa4Itoc\xeerjv1l\xed=\xef\xec<>i7†[\xbf?\xd7}*{+()/\xbb\xab•\xac|!\xa1\xf7\xa6\xaf—^\xaa„”“~\xb3\xba\xb2–\xb0\xad\xb9‹›;:’‘‚’˜ˆ\xb8…\xb7\xa8\xb4`"},
-    {"codepage437", "█▓▒░"},
-    {"blockelement", "█"}
-};
 
 
 void print_help() {
-    std::cout << "Usage: AsciiScreen.exe [--mode <mode>] [--help]\n";
+    std::cout << "Usage: AsciiScreen.exe [--mode <mode>] [--cells <kind>] [--dither <kind>] [--fps <n>] [--threads <n>]\n"
+                 "                       [--contrast <none|auto|equalize>] [--calibrate]\n"
+                 "                       [--pipeline] [--diff] [--nonblock] [--scaler <area|gdi>]\n"
+                 "                       [--region x,y,w,h | --window <title|id> | --source <src>... | --monitors]\n"
+                 "                       [--color <truecolor|256|16>] [--color-layer <fg|bg>]\n"
+                 "                       [--input <file> [--output <file>]] [--record <file>]\n"
+                 "                       [--play <file> [--seek <seconds>]] [--serve [host:]port]\n"
+                 "                       [--stats <-|file>] [--help]\n";
     std::cout << "Captures the screen and renders it as ASCII art.\n\n";
+    std::cout << "Options:\n";
+    std::cout << "  -m, --mode <mode>   Character ramp to render with (default: normal)\n";
+    std::cout << "  --cells <kind>      How each cell is drawn: 'ramp' (default) picks a glyph by brightness;\n";
+    std::cout << "                      'shapes' matches the cell's shape against a built-in font so edges\n";
+    std::cout << "                      and text stay legible; 'braille' draws 2x4 dots and 'halfblock'\n";
+    std::cout << "                      two pixels per cell, for more resolution\n";
+    std::cout << "  --shapes            Same as --cells shapes\n";
+    std::cout << "  --dither <kind>     Spread brightness between glyphs so short ramps don't band:\n";
+    std::cout << "                      'bayer' (ordered pattern), 'fs' (Floyd-Steinberg error\n";
+    std::cout << "                      diffusion) or 'none' (default)\n";
+    std::cout << "  --contrast <kind>   Stretch each frame's brightness over the whole ramp: 'auto'\n";
+    std::cout << "                      (its darkest and lightest levels become black and white),\n";
+    std::cout << "                      'equalize' (every glyph covers a similar share of the screen)\n";
+    std::cout << "                      or 'none' (default)\n";
+    std::cout << "  --calibrate         Map brightness to glyphs by how much ink each one has\n";
+    std::cout << "  --fps <n>           Frames per second while the screen changes (default: 60);\n";
+    std::cout << "                      an unchanging screen is sampled down to 4 per second\n";
+    std::cout << "  --threads <n>       Threads to scale and convert each frame on (default: all cores;\n";
+    std::cout << "                      1 keeps everything on one thread)\n";
+    std::cout << "  --pipeline          Run capture, conversion and output on separate threads,\n";
+    std::cout << "                      dropping stale frames when the terminal falls behind\n";
+    std::cout << "  --diff              Only redraw the parts of the screen that changed\n";
+    std::cout << "  --nonblock          Don't wait for a slow terminal to take a frame; skip frames\n";
+    std::cout << "                      until it has (POSIX terminals)\n";
+    std::cout << "  --scaler <name>     How the screen is shrunk to the console: 'area' averages\n";
+    std::cout << "                      in software on all cores (default); 'gdi' uses\n";
+    std::cout << "                      StretchBlt HALFTONE (Windows only)\n";
+    std::cout << "  --region <x,y,w,h>  Capture only this rectangle of the screen\n";
+    std::cout << "  --window <title|id> Capture the first visible window whose title contains this text,\n";
+    std::cout << "                      or the window with this id (decimal or 0x hex), wherever it moves\n";
+    std::cout << "  --source <src>      Add a source: 'screen', 'screen:N' (X screen or monitor N),\n";
+    std::cout << "                      'region:x,y,w,h' or 'window:<title|id>'. Two or more are shown\n";
+    std::cout << "                      side by side, each captured and converted on its own thread\n";
+    std::cout << "  --monitors          Tile every monitor (every screen of the X display)\n";
+    std::cout << "  --color <depth>     Color the glyphs with the screen's colors: 'truecolor' (24-bit),\n";
+    std::cout << "                      '256' or '16' for terminals with a smaller palette\n";
+    std::cout << "  --color-layer <l>   Apply the color to the glyph ('fg', default) or the cell ('bg')\n";
+    std::cout << "  -i, --input <file>  Convert frames from a file instead of the screen, as fast as\n";
+    std::cout << "                      possible: raw BGRA, PPM/PAM or Y4M ('-' reads stdin)\n";
+    std::cout << "  -o, --output <file> Where --input writes the frames (default: stdout), each\n";
+    std::cout << "                      followed by a form feed line\n";
+    std::cout << "  --record <file>     Also save the frames to a compact recording\n";
+    std::cout << "  --play <file>       Play a recording back at its original pace\n";
+    std::cout << "  --seek <seconds>    Start --play this far into the recording\n";
+    std::cout << "  --serve <[host:]port>\n";
+    std::cout << "                      Also stream the frames to TCP clients (e.g. 'nc host port');\n";
+    std::cout << "                      a bare port listens on localhost only\n";
+    std::cout << "  --stats <-|file>    Time capture, scaling, conversion and output on every frame and\n";
+    std::cout << "                      report p50/p99/max each second: '-' as JSON lines on stderr,\n";
+    std::cout << "                      otherwise as a Prometheus text file\n";
+    std::cout << "  -h, --help          Show this help\n\n";
     std::cout << "Available modes:\n";
 
     // Find longest key for padding
     size_t max_len = 0;
-    for (const auto& kv : ASCII_RAMPS) {
-        if (kv.first.length() > max_len) max_len = kv.first.length();
+    for (const AsciiRamp& ramp : ASCII_RAMPS) {
+        if (std::strlen(ramp.name) > max_len) max_len = std::strlen(ramp.name);
     }
     size_t pad_width = max_len + 4;
 
-    for (const auto& kv : ASCII_RAMPS) {
-        std::cout << "  " << std::left << std::setw(pad_width) << kv.first
-                  << kv.second << std::endl;
+    for (const AsciiRamp& ramp : ASCII_RAMPS) {
+        std::cout << "  " << std::left << std::setw(pad_width) << ramp.name
+                  << ramp.glyphs << std::endl;
+    }
+}
+
+// Default frames per second (--fps)
+const int TARGET_FPS = 60;
+// Sentinel: Upper bound for --fps; beyond this the schedule is just a busy loop
+const double MAX_FPS = 1000.0;
+// Sentinel: Upper bound for --threads
+const long MAX_THREADS = 256;
+
+// Part of the desktop to capture (--region, --window, --source, --monitors)
+struct CaptureSource {
+    enum class Kind { Screen, Region, Window };
+    Kind kind = Kind::Screen;
+    // Screen: X screen number on X11, monitor index on Windows; -1 for the default screen
+    int screen = -1;
+    // Region: X11 screen or Windows virtual-desktop coordinates
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    std::string window; // Window: a title substring, or a window id (decimal or 0x hex)
+};
+
+/**
+ * @brief Parses "x,y,w,h" into a Region source.
+ */
+bool parse_region(const std::string& spec, CaptureSource& source) {
+    int values[4];
+    const char* p = spec.c_str();
+    for (int i = 0; i < 4; ++i) {
+        char* end = nullptr;
+        const long v = std::strtol(p, &end, 10);
+        // Sentinel: Bound coordinates so the capture size can't overflow downstream
+        if (end == p || v < -65535 || v > 65535 || *end != (i < 3 ? ',' : '\0')) return false;
+        values[i] = static_cast<int>(v);
+        p = end + 1;
+    }
+    if (values[2] <= 0 || values[3] <= 0) return false;
+    source.kind = CaptureSource::Kind::Region;
+    source.x = values[0];
+    source.y = values[1];
+    source.width = values[2];
+    source.height = values[3];
+    return true;
+}
+
+/**
+ * @brief Parses a --source: "screen", "screen:N", "region:x,y,w,h" or "window:<title|id>".
+ */
+bool parse_capture_source(const std::string& spec, CaptureSource& source) {
+    source = CaptureSource();
+    if (spec == "screen") return true;
+    if (spec.rfind("screen:", 0) == 0) {
+        const std::string index = spec.substr(7);
+        char* end = nullptr;
+        const long n = std::strtol(index.c_str(), &end, 10);
+        if (index.empty() || *end != '\0' || n < 0 || n > 255) return false;
+        source.screen = static_cast<int>(n);
+        return true;
     }
+    if (spec.rfind("region:", 0) == 0) return parse_region(spec.substr(7), source);
+    if (spec.rfind("window:", 0) == 0 && spec.size() > 7) {
+        source.kind = CaptureSource::Kind::Window;
+        source.window = spec.substr(7);
+        return true;
+    }
+    return false;
 }
 
-std::string get_ascii_ramp_from_args(int argc, char* argv[], bool& show_help, std::string& error) {
+// Settings selected on the command line
+struct Options {
     std::string mode = "normal"; // default mode
+    std::string ramp;            // resolved from mode
+    bool pipeline = false;
+    bool diff = false;
+    CellMode cells = CellMode::Ramp; // --cells
+    DitherMode dither = DitherMode::Off; // --dither
+    ToneMode contrast = ToneMode::Off;   // --contrast
+    bool calibrate = false;              // --calibrate
+    std::string scaler = "area"; // "area" (software) or "gdi" (StretchBlt, Windows only)
+    ColorMode color = ColorMode::Mono;
+    ColorLayer color_layer = ColorLayer::Foreground;
+    std::string input;  // batch mode: frames come from this file instead of the screen
+    std::string output; // batch mode destination; empty or "-" for stdout
+    std::string record; // save frames to this recording
+    std::string play;   // play this recording instead of capturing
+    double seek = 0.0;  // seconds into the recording to start playing
+    std::string serve;  // [host:]port to stream frames to TCP clients on
+    double fps = TARGET_FPS; // full capture rate; idle screens are sampled less often
+    std::string stats;       // "-" for JSON lines on stderr, else a Prometheus text file
+    std::vector<CaptureSource> sources; // empty for the whole default screen; several are tiled
+    bool monitors = false;              // tile every monitor (X screen on X11)
+    bool nonblock = false;              // don't block on a slow terminal
+    size_t threads = 0;                 // per-frame worker threads; 0 for every core
+};
+
+/**
+ * @brief Matches `arg` against an option that takes a value (`--name v`, `--name=v`, `-n v`, `-n=v`).
+ * @return True if the option matched; `value` is filled, or `error` set when the value is missing.
+ */
+bool match_value_option(const std::string& arg, const char* long_name, const char* short_name,
+                        int argc, char* argv[], int& i, std::string& value, std::string& error) {
+    for (const char* name : {long_name, short_name}) {
+        if (!name) continue;
+        const std::string prefix = std::string(name) + "=";
+        if (arg == name) {
+            if (i + 1 < argc) {
+                value = argv[++i];
+            } else {
+                error = std::string("Missing value for ") + name + ".";
+            }
+            return true;
+        }
+        if (arg.rfind(prefix, 0) == 0) {
+            value = arg.substr(prefix.length());
+            return true;
+        }
+    }
+    return false;
+}
+
+void parse_args(int argc, char* argv[], Options& opts, bool& show_help, std::string& error) {
     show_help = false;
     error.clear();
-    for (int i = 1; i < argc; ++i) {
+    for (int i = 1; i < argc && error.empty(); ++i) {
         std::string arg = argv[i];
         if (arg == "--help" || arg == "-h") {
             show_help = true;
-            return "";
+            return;
         }
-        if ((arg == "--mode" || arg == "-m")) {
-            if (i + 1 < argc) {
-                mode = argv[++i];
-            } else {
-                error = "Missing value for --mode/-m.";
-                show_help = true;
+        if (match_value_option(arg, "--mode", "-m", argc, argv, i, opts.mode, error)) {
+            continue;
+        }
+        if (match_value_option(arg, "--scaler", nullptr, argc, argv, i, opts.scaler, error)) {
+#ifdef _WIN32
+            if (error.empty() && opts.scaler != "area" && opts.scaler != "gdi") {
+#else
+            if (error.empty() && opts.scaler != "area") {
+#endif
+                error = "Unknown scaler: '" + opts.scaler + "'";
             }
-            break;
+            continue;
         }
-        if (arg.rfind("--mode=", 0) == 0) {
-            mode = arg.substr(7);
-            break;
+        std::string value;
+        if (match_value_option(arg, "--color", nullptr, argc, argv, i, value, error)) {
+            if (error.empty() && !parse_color_mode(value.c_str(), opts.color)) {
+                error = "Unknown color depth: '" + value + "'";
+            }
+            continue;
         }
-        if (arg.rfind("-m=", 0) == 0) {
-            mode = arg.substr(3);
-            break;
+        if (match_value_option(arg, "--cells", nullptr, argc, argv, i, value, error)) {
+            if (error.empty() && !parse_cell_mode(value.c_str(), opts.cells)) {
+                error = "Unknown cell kind: '" + value + "'";
+            }
+            continue;
+        }
+        if (match_value_option(arg, "--dither", nullptr, argc, argv, i, value, error)) {
+            if (error.empty() && !parse_dither_mode(value.c_str(), opts.dither)) {
+                error = "Unknown dither kind: '" + value + "'";
+            }
+            continue;
+        }
+        if (match_value_option(arg, "--contrast", nullptr, argc, argv, i, value, error)) {
+            if (error.empty() && !parse_tone_mode(value.c_str(), opts.contrast)) {
+                error = "Unknown contrast kind: '" + value + "'";
+            }
+            continue;
+        }
+        if (match_value_option(arg, "--color-layer", nullptr, argc, argv, i, value, error)) {
+            if (value == "fg") {
+                opts.color_layer = ColorLayer::Foreground;
+            } else if (value == "bg") {
+                opts.color_layer = ColorLayer::Background;
+            } else if (error.empty()) {
+                error = "Unknown color layer: '" + value + "'";
+            }
+            continue;
+        }
+        if (match_value_option(arg, "--input", "-i", argc, argv, i, opts.input, error) ||
+            match_value_option(arg, "--output", "-o", argc, argv, i, opts.output, error) ||
+            match_value_option(arg, "--record", nullptr, argc, argv, i, opts.record, error) ||
+            match_value_option(arg, "--play", nullptr, argc, argv, i, opts.play, error) ||
+            match_value_option(arg, "--serve", nullptr, argc, argv, i, opts.serve, error) ||
+            match_value_option(arg, "--stats", nullptr, argc, argv, i, opts.stats, error)) {
+            continue;
+        }
+        if (match_value_option(arg, "--fps", nullptr, argc, argv, i, value, error)) {
+            char* end = nullptr;
+            opts.fps = std::strtod(value.c_str(), &end);
+            if (error.empty() && (value.empty() || *end != '\0' || !(opts.fps > 0.0) || opts.fps > MAX_FPS)) {
+                error = "Invalid frame rate: '" + value + "'";
+            }
+            continue;
+        }
+        if (match_value_option(arg, "--threads", nullptr, argc, argv, i, value, error)) {
+            char* end = nullptr;
+            const long threads = std::strtol(value.c_str(), &end, 10);
+            if (error.empty() && (value.empty() || *end != '\0' || threads < 1 || threads > MAX_THREADS)) {
+                error = "Invalid thread count: '" + value + "'";
+            }
+            opts.threads = threads > 0 ? static_cast<size_t>(threads) : 0;
+            continue;
+        }
+        if (match_value_option(arg, "--seek", nullptr, argc, argv, i, value, error)) {
+            char* end = nullptr;
+            opts.seek = std::strtod(value.c_str(), &end);
+            if (error.empty() && (value.empty() || *end != '\0' || !(opts.seek >= 0.0) || opts.seek > 1e9)) {
+                error = "Invalid seek time: '" + value + "'";
+            }
+            continue;
+        }
+        if (match_value_option(arg, "--region", nullptr, argc, argv, i, value, error)) {
+            CaptureSource source;
+            if (error.empty() && !parse_region(value, source)) {
+                error = "Invalid region: '" + value + "' (expected x,y,width,height)";
+            }
+            opts.sources.push_back(source);
+            continue;
+        }
+        if (match_value_option(arg, "--window", nullptr, argc, argv, i, value, error)) {
+            CaptureSource source;
+            source.kind = CaptureSource::Kind::Window;
+            source.window = value;
+            if (error.empty() && value.empty()) error = "Missing window title or id.";
+            opts.sources.push_back(source);
+            continue;
+        }
+        if (match_value_option(arg, "--source", nullptr, argc, argv, i, value, error)) {
+            CaptureSource source;
+            if (error.empty() && !parse_capture_source(value, source)) {
+                error = "Invalid source: '" + value + "'";
+            }
+            opts.sources.push_back(source);
+            continue;
+        }
+        if (arg == "--nonblock") {
+            opts.nonblock = true;
+            continue;
+        }
+        if (arg == "--monitors") {
+            opts.monitors = true;
+            continue;
+        }
+        if (arg == "--pipeline") {
+            opts.pipeline = true;
+            continue;
+        }
+        if (arg == "--diff") {
+            opts.diff = true;
+            continue;
+        }
+        if (arg == "--shapes") {
+            opts.cells = CellMode::Shape;
+            continue;
+        }
+        if (arg == "--calibrate") {
+            opts.calibrate = true;
+            continue;
         }
         if (arg.rfind("-", 0) == 0) {
             error = "Unknown option: " + arg;
-            show_help = true;
-            break;
         }
     }
-    if (show_help) return "";
-    auto it = ASCII_RAMPS.find(mode);
-    if (it != ASCII_RAMPS.end()) {
-        return it->second;
+    if (error.empty() && !opts.output.empty() && opts.input.empty()) {
+        error = "--output requires --input.";
+    }
+    if (error.empty() && opts.seek > 0.0 && opts.play.empty()) {
+        error = "--seek requires --play.";
+    }
+    if (error.empty() && !opts.play.empty() && (!opts.input.empty() || !opts.record.empty())) {
+        error = "--play cannot be combined with --input or --record.";
+    }
+    if (error.empty() && !opts.serve.empty() && (!opts.input.empty() || !opts.play.empty())) {
+        error = "--serve streams live capture and cannot be combined with --input or --play.";
+    }
+    const bool capture_options = !opts.sources.empty() || opts.monitors;
+    if (error.empty() && capture_options && (!opts.input.empty() || !opts.play.empty())) {
+        error = "--region, --window, --source and --monitors select what to capture and cannot be combined with --input or --play.";
+    }
+    if (error.empty() && opts.monitors && !opts.sources.empty()) {
+        error = "--monitors cannot be combined with --region, --window or --source.";
+    }
+    if (error.empty() && opts.pipeline && (opts.sources.size() > 1 || opts.monitors)) {
+        error = "--pipeline captures a single source; tiled sources already run on a thread each.";
+    }
+    if (error.empty()) {
+        if (const AsciiRamp* ramp = find_ramp(opts.mode)) {
+            opts.ramp = ramp->glyphs;
+            return;
+        }
+        // fallback: invalid mode, trigger help
+        error = "Unknown mode: '" + opts.mode + "'";
     }
-    // fallback: invalid mode, trigger help
-    error = "Unknown mode: '" + mode + "'";
     show_help = true;
-    return mode;
 }
 
-// Desired frames per second.
-const int TARGET_FPS = 60;
+// Set on Ctrl+C while recording, so the loops can stop and the recording gets its index
+static volatile std::sig_atomic_t g_interrupted = 0;
+
+extern "C" void on_interrupt(int) { g_interrupted = 1; }
+
+// Per-stage latency histograms for --stats; null (and every StageTimer free) otherwise
+static StageStats* g_stats = nullptr;
+
+// Microseconds since `start`, for recording timestamps
+uint64_t elapsed_us(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
 
 // --- End Configuration ---
 
 
+// Set by SIGWINCH when the terminal is resized
+static volatile std::sig_atomic_t g_resized = 0;
+
+extern "C" void on_resize(int) { g_resized = 1; }
+
 /**
- * @brief Moves the console cursor to the top-left corner (0,0).
- * This is much faster than clearing the console with `system("cls")` or `system("clear")`,
- * reducing flicker.
+ * @brief Derives the cell grid from the size of the terminal on stdout.
+ * The last row stays free for the cursor after the trailing newline (and on Windows the
+ * last column too, since the console wraps a full row before the newline), so frames
+ * never scroll.
+ * @return False if stdout is not a terminal; `geometry` is left alone.
  */
-void reset_cursor() {
+bool query_terminal_geometry(Geometry& geometry) {
+    int columns = 0;
+    int rows = 0;
 #ifdef _WIN32
-    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
-    COORD Position;
-    Position.X = 0;
-    Position.Y = 0;
-    SetConsoleCursorPosition(hOut, Position);
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi)) return false;
+    columns = csbi.srWindow.Right - csbi.srWindow.Left; // one short, see above
+    rows = csbi.srWindow.Bottom - csbi.srWindow.Top;
+#else
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0 || ws.ws_col == 0 || ws.ws_row == 0) return false;
+    columns = ws.ws_col;
+    rows = ws.ws_row - 1;
+#endif
+    // At least one row of picture above the status bar
+    if (columns < 1 || rows < 2) return false;
+    geometry.width = columns < MAX_CONSOLE_WIDTH ? columns : MAX_CONSOLE_WIDTH;
+    geometry.height = rows < MAX_CONSOLE_HEIGHT ? rows : MAX_CONSOLE_HEIGHT;
+    return true;
+}
+
+/**
+ * @brief Picks up a terminal resize: SIGWINCH, or on Windows (which has no such signal) a
+ * size check every 250 ms.
+ * @return True if `geometry` changed.
+ */
+bool poll_resize(Geometry& geometry) {
+#ifdef _WIN32
+    static auto last_check = std::chrono::steady_clock::now();
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_check < std::chrono::milliseconds(250)) return false;
+    last_check = now;
 #else
-    // ANSI escape code for Linux/macOS
-    std::cout << "\033[H";
+    if (!g_resized) return false;
+    g_resized = 0;
+#endif
+    const Geometry previous = geometry;
+    query_terminal_geometry(geometry);
+    return geometry != previous;
+}
+
+/**
+ * @brief Bytes already written to the terminal that it has not read yet.
+ * Windows console writes complete synchronously, and pipes and files can't be asked, so
+ * this is 0 there.
+ */
+size_t pending_output() {
+#ifdef TIOCOUTQ
+    int pending = 0;
+    if (ioctl(STDOUT_FILENO, TIOCOUTQ, &pending) == 0 && pending > 0) return static_cast<size_t>(pending);
 #endif
+    return 0;
 }
 
 #ifdef _WIN32
+static BOOL CALLBACK collect_monitor(HMONITOR, HDC, LPRECT rect, LPARAM data) {
+    reinterpret_cast<std::vector<RECT>*>(data)->push_back(*rect);
+    return TRUE;
+}
+
+// Monitor rectangles in virtual-desktop coordinates, in EnumDisplayMonitors order
+std::vector<RECT> monitor_rects() {
+    std::vector<RECT> rects;
+    EnumDisplayMonitors(NULL, NULL, collect_monitor, reinterpret_cast<LPARAM>(&rects));
+    return rects;
+}
+
+// Number of sources --monitors tiles
+int screen_count() {
+    return static_cast<int>(monitor_rects().size());
+}
+
+struct WindowSearch {
+    const std::string* title;
+    HWND found;
+};
+
+static BOOL CALLBACK match_window_title(HWND hwnd, LPARAM data) {
+    WindowSearch* search = reinterpret_cast<WindowSearch*>(data);
+    char title[512];
+    if (!IsWindowVisible(hwnd) || GetWindowTextA(hwnd, title, sizeof(title)) <= 0) return TRUE;
+    if (!std::strstr(title, search->title->c_str())) return TRUE;
+    search->found = hwnd;
+    return FALSE;
+}
+
+/**
+ * @brief Finds a window by handle (decimal or 0x hex) or by a substring of its title.
+ * @return The first visible match in Z order, or NULL.
+ */
+HWND find_window(const std::string& spec) {
+    char* end = nullptr;
+    const unsigned long long id = std::strtoull(spec.c_str(), &end, 0);
+    if (*end == '\0') {
+        HWND hwnd = reinterpret_cast<HWND>(static_cast<uintptr_t>(id));
+        return IsWindow(hwnd) ? hwnd : NULL;
+    }
+    WindowSearch search = {&spec, NULL};
+    EnumWindows(match_window_title, reinterpret_cast<LPARAM>(&search));
+    return search.found;
+}
+
 /**
- * @brief Captures the entire screen using the Windows GDI API.
- * @param buffer A vector to store the raw BGRA pixel data.
- * @param width Output parameter for the screen width.
- * @param height Output parameter for the screen height.
- * @return True on success, false on failure.
+ * @brief Captures one source (the primary screen, a monitor, a region or a window) with GDI.
+ *
+ * Copies come from the screen DC, so a window is captured as it appears on screen, along
+ * with anything overlapping it. Each grabber keeps its own GDI objects, so several can
+ * capture concurrently.
  */
-bool captureScreenGDI(SecureBuffer& buffer, int& width, int& height) {
+class GdiScreenGrabber {
+    CaptureSource source_;
+    HWND window_ = NULL;
+    RECT monitor_ = {};
     // Optimization: Cache GDI objects (Memory DC and Bitmap) to avoid re-allocation overhead every frame.
-    // We do NOT cache hScreenDC as it is a Common DC and should be released after use.
-    static HDC hMemoryDC = NULL;
-    static HBITMAP hBitmap = NULL;
-    static int cachedWidth = 0;
-    static int cachedHeight = 0;
-
-    // Get the device context for the entire screen.
-    ScopedHDC screenDC(NULL);
-    if (!screenDC) return false;
-    HDC hScreenDC = screenDC.get();
-
-    // Initialize Memory DC once
-    if (!hMemoryDC) {
-        hMemoryDC = CreateCompatibleDC(hScreenDC);
-        if (!hMemoryDC) {
+    // We do NOT cache the screen DC as it is a Common DC and should be released after use.
+    HDC memory_dc_ = NULL;
+    HBITMAP bitmap_ = NULL;
+    void* bits_ = NULL; // pixels of the DIB section, on the full-resolution path
+    int cached_width_ = 0;
+    int cached_height_ = 0;
+
+    // Area to copy this frame, in virtual-desktop coordinates; false if nothing is visible
+    bool source_rect(RECT& rect) const {
+        switch (source_.kind) {
+        case CaptureSource::Kind::Screen:
+            if (source_.screen >= 0) {
+                rect = monitor_;
+            } else {
+                rect = {0, 0, GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN)};
+            }
+            break;
+        case CaptureSource::Kind::Region:
+            rect = {source_.x, source_.y, source_.x + source_.width, source_.y + source_.height};
+            break;
+        case CaptureSource::Kind::Window:
+            // Follow the window as it moves and resizes; a minimized one has nothing to show
+            if (!IsWindow(window_) || IsIconic(window_) || !GetWindowRect(window_, &rect)) return false;
+            break;
+        }
+        const int left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+        const int top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+        const RECT desktop = {left, top, left + GetSystemMetrics(SM_CXVIRTUALSCREEN),
+                              top + GetSystemMetrics(SM_CYVIRTUALSCREEN)};
+        return IntersectRect(&rect, &rect, &desktop) != FALSE;
+    }
+
+    // Sentinel: Verify object selection to prevent leaks or state corruption
+    bool select_bitmap(HBITMAP bitmap, void* bits, int width, int height) {
+        HGDIOBJ hOldObj = SelectObject(memory_dc_, bitmap);
+        if (hOldObj == NULL || hOldObj == HGDI_ERROR) {
+            DeleteObject(bitmap); // Failed to select, cleanup new resource
             return false;
         }
+        if (bitmap_) DeleteObject(bitmap_);
+        bitmap_ = bitmap;
+        bits_ = bits;
+        cached_width_ = width;
+        cached_height_ = height;
+        return true;
     }
 
-    width = GetSystemMetrics(SM_CXSCREEN);
-    height = GetSystemMetrics(SM_CYSCREEN);
+    /**
+     * @brief StretchBlt path: GDI scales with HALFTONE while it copies into a console-sized
+     * bitmap, and GetDIBits reads it back.
+     */
+    bool capture_stretched(HDC hScreenDC, const RECT& rect, SecureBuffer& buffer, int width, int height) {
+        // Recreate bitmap if the console size changes, on first run, or after the other path
+        if (width != cached_width_ || height != cached_height_ || bits_) {
+            HBITMAP hNewBitmap = CreateCompatibleBitmap(hScreenDC, width, height);
+            if (!hNewBitmap || !select_bitmap(hNewBitmap, NULL, width, height)) {
+                return false;
+            }
+        }
+
+        // StretchBlt scales while it copies, so this path reports both as capture time
+        StageTimer capture_timer(g_stats, Stage::Capture);
 
-    if (width <= 0 || height <= 0) {
-        return false;
+        // Perform the stretch bit-block transfer from the screen to the memory DC.
+        // Use HALFTONE for better downscaling quality.
+        SetStretchBltMode(memory_dc_, HALFTONE);
+        SetBrushOrgEx(memory_dc_, 0, 0, NULL);
+        if (!StretchBlt(memory_dc_, 0, 0, width, height, hScreenDC, rect.left, rect.top, rect.right - rect.left,
+                        rect.bottom - rect.top, SRCCOPY)) {
+            return false;
+        }
+
+        // Setup the bitmap info structure to get the pixel data.
+        BITMAPINFOHEADER bi = {};
+        bi.biSize = sizeof(BITMAPINFOHEADER);
+        bi.biWidth = width;
+        bi.biHeight = -height; // A negative height indicates a top-down DIB.
+        bi.biPlanes = 1;
+        bi.biBitCount = 32; // We want 32-bit BGRA format.
+        bi.biCompression = BI_RGB;
+
+        // Use size_t for calculation to prevent integer overflow
+        size_t required_size = static_cast<size_t>(width) * height * 4;
+        if (buffer.size() != required_size) {
+            buffer.resize(required_size);
+        }
+
+        // Extract the pixel data from the bitmap.
+        return GetDIBits(hScreenDC, bitmap_, 0, (UINT)height, buffer.data(), (BITMAPINFO*)&bi, DIB_RGB_COLORS) != 0;
+    }
+
+    /**
+     * @brief Full-resolution path: BitBlt copies into a DIB section, whose pixels are read in
+     * place without GetDIBits and downscaled in software.
+     */
+    bool capture_full(HDC hScreenDC, const RECT& rect, SecureBuffer& buffer, int width, int height,
+                      AreaDownscaler& scaler) {
+        const int sourceW = rect.right - rect.left;
+        const int sourceH = rect.bottom - rect.top;
+        if (sourceW != cached_width_ || sourceH != cached_height_ || !bits_) {
+            BITMAPINFO bmi = {};
+            bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+            bmi.bmiHeader.biWidth = sourceW;
+            bmi.bmiHeader.biHeight = -sourceH; // top-down
+            bmi.bmiHeader.biPlanes = 1;
+            bmi.bmiHeader.biBitCount = 32;
+            bmi.bmiHeader.biCompression = BI_RGB;
+
+            void* newBits = NULL;
+            HBITMAP hNewBitmap = CreateDIBSection(hScreenDC, &bmi, DIB_RGB_COLORS, &newBits, NULL, 0);
+            if (!hNewBitmap || !newBits || !select_bitmap(hNewBitmap, newBits, sourceW, sourceH)) {
+                return false;
+            }
+        }
+
+        {
+            StageTimer capture_timer(g_stats, Stage::Capture);
+            if (!BitBlt(memory_dc_, 0, 0, sourceW, sourceH, hScreenDC, rect.left, rect.top, SRCCOPY)) {
+                return false;
+            }
+            // Make sure GDI has finished writing the DIB before we read it
+            GdiFlush();
+        }
+
+        // Use size_t for calculation to prevent integer overflow
+        size_t required_size = static_cast<size_t>(width) * height * 4;
+        if (buffer.size() != required_size) {
+            buffer.resize(required_size);
+        }
+
+        const ImageView view = {static_cast<const unsigned char*>(bits_), sourceW, sourceH,
+                               static_cast<size_t>(sourceW) * 4};
+        StageTimer scale_timer(g_stats, Stage::Scale);
+        scaler.scale(view, width, height, buffer.data());
+        return true;
     }
 
-    // Update width/height to target console size for downscaling
-    int screenW = width;
-    int screenH = height;
-    width = CONSOLE_WIDTH;
-    height = CONSOLE_HEIGHT;
+public:
+    GdiScreenGrabber() = default;
+    ~GdiScreenGrabber() {
+        if (memory_dc_) DeleteDC(memory_dc_);
+        if (bitmap_) DeleteObject(bitmap_);
+    }
+    GdiScreenGrabber(const GdiScreenGrabber&) = delete;
+    GdiScreenGrabber& operator=(const GdiScreenGrabber&) = delete;
 
-    // Recreate bitmap if resolution changes or on first run
-    if (width != cachedWidth || height != cachedHeight) {
-        HBITMAP hNewBitmap = CreateCompatibleBitmap(hScreenDC, width, height);
-        if (!hNewBitmap) {
+    /**
+     * @brief Resolves `source` (its monitor or window) and checks that any of it is on screen.
+     */
+    bool open(const CaptureSource& source, std::string& error) {
+        source_ = source;
+        if (source.kind == CaptureSource::Kind::Screen && source.screen >= 0) {
+            const std::vector<RECT> monitors = monitor_rects();
+            if (static_cast<size_t>(source.screen) >= monitors.size()) {
+                error = "Monitor " + std::to_string(source.screen) + " does not exist (found " +
+                        std::to_string(monitors.size()) + ").";
+                return false;
+            }
+            monitor_ = monitors[source.screen];
+        }
+        if (source.kind == CaptureSource::Kind::Window) {
+            window_ = find_window(source.window);
+            if (!window_) {
+                error = "No visible window matches '" + source.window + "'.";
+                return false;
+            }
+        }
+        RECT rect;
+        if (!source_rect(rect)) {
+            error = source.kind == CaptureSource::Kind::Window ? "Window '" + source.window + "' is not on screen."
+                                                              : std::string("Region lies outside the desktop.");
             return false;
         }
+        return true;
+    }
 
-        // Sentinel: Verify object selection to prevent leaks or state corruption
-        HGDIOBJ hOldObj = SelectObject(hMemoryDC, hNewBitmap);
-        if (hOldObj == NULL || hOldObj == HGDI_ERROR) {
-            DeleteObject(hNewBitmap); // Failed to select, cleanup new resource
+    /**
+     * @brief Captures the source scaled to `size` pixels (see Renderer::image_size()).
+     * @param scaler Software downscaler; null scales with StretchBlt HALFTONE instead.
+     * @return True on success, false on failure.
+     */
+    bool capture(SecureBuffer& buffer, const Geometry& size, AreaDownscaler* scaler) {
+        RECT rect;
+        if (!source_rect(rect)) return false;
+
+        // Get the device context for the entire screen.
+        ScopedHDC screenDC(NULL);
+        if (!screenDC) return false;
+        HDC hScreenDC = screenDC.get();
+
+        // Initialize Memory DC once
+        if (!memory_dc_) {
+            memory_dc_ = CreateCompatibleDC(hScreenDC);
+            if (!memory_dc_) {
+                return false;
+            }
+        }
+        if (scaler) return capture_full(hScreenDC, rect, buffer, size.width, size.height, *scaler);
+        return capture_stretched(hScreenDC, rect, buffer, size.width, size.height);
+    }
+};
+
+using ScreenGrabber = GdiScreenGrabber;
+#elif defined(SCRN_HAVE_X11)
+// Set by x11_error_handler when a request fails; X11 reports errors asynchronously.
+// Tiled sources capture on several threads, each over its own connection, and Xlib calls
+// the handler on the thread whose connection the error arrived on: one flag per thread, so
+// a source neither fails on another's error nor clears it before that one looks.
+static thread_local bool g_x11_error = false;
+
+static int x11_error_handler(Display*, XErrorEvent*) {
+    g_x11_error = true;
+    return 0;
+}
+
+// Number of sources --monitors tiles: one per screen of the display
+int screen_count() {
+    Display* display = XOpenDisplay(NULL);
+    if (!display) return 0;
+    const int count = ScreenCount(display);
+    XCloseDisplay(display);
+    return count;
+}
+
+/**
+ * @brief Searches `window` and its descendants, topmost first, for a viewable window whose
+ * WM_NAME contains `title`.
+ */
+Window find_window_by_title(Display* display, Window window, const std::string& title) {
+    char* name = nullptr;
+    if (XFetchName(display, window, &name) && name) {
+        const bool match = std::strstr(name, title.c_str()) != nullptr;
+        XFree(name);
+        XWindowAttributes attr;
+        if (match && XGetWindowAttributes(display, window, &attr) && attr.map_state == IsViewable) return window;
+    }
+    Window root = 0;
+    Window parent = 0;
+    Window* children = nullptr;
+    unsigned int count = 0;
+    if (!XQueryTree(display, window, &root, &parent, &children, &count)) return 0;
+    Window found = 0;
+    // Children are listed bottom to top
+    for (unsigned int i = count; i-- > 0 && !found;) {
+        found = find_window_by_title(display, children[i], title);
+    }
+    if (children) XFree(children);
+    return found;
+}
+
+// Owns an X display connection and the image a source is read into.
+// With MIT-SHM the server writes pixels straight into a shared memory segment,
+// so a frame costs one small request instead of streaming the image over the socket.
+// Sources are read from the root window of their screen, so a window is captured as it
+// appears on screen, along with anything overlapping it.
+class X11ScreenGrabber {
+    Display* display_ = nullptr;
+    int screen_ = 0;
+    Window root_ = 0;
+    Window window_ = 0; // window source, located again every frame
+    XImage* image_ = nullptr;
+    XShmSegmentInfo shminfo_ = {};
+    bool shm_ = false;     // the server supports MIT-SHM
+    bool use_shm_ = false; // image_ is attached to a shared segment
+    int screen_width_ = 0;
+    int screen_height_ = 0;
+    // Captured area of the root window
+    int x_ = 0;
+    int y_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+
+    void release_image() {
+        if (!image_) return;
+        if (use_shm_) {
+            XShmDetach(display_, &shminfo_);
+            XSync(display_, False);
+            XDestroyImage(image_);
+            shmdt(shminfo_.shmaddr);
+        } else {
+            XDestroyImage(image_);
+        }
+        image_ = nullptr;
+        use_shm_ = false;
+        shminfo_ = {};
+    }
+
+    bool create_shm_image() {
+        Screen* screen = ScreenOfDisplay(display_, screen_);
+        image_ = XShmCreateImage(display_, DefaultVisualOfScreen(screen), DefaultDepthOfScreen(screen),
+                                 ZPixmap, NULL, &shminfo_, width_, height_);
+        if (!image_) return false;
+
+        shminfo_.shmid = shmget(IPC_PRIVATE, static_cast<size_t>(image_->bytes_per_line) * image_->height,
+                                IPC_CREAT | 0600);
+        if (shminfo_.shmid < 0) {
+            XDestroyImage(image_);
+            image_ = nullptr;
+            return false;
+        }
+        shminfo_.shmaddr = image_->data = static_cast<char*>(shmat(shminfo_.shmid, NULL, 0));
+        if (shminfo_.shmaddr == reinterpret_cast<char*>(-1)) {
+            shmctl(shminfo_.shmid, IPC_RMID, NULL);
+            image_->data = NULL;
+            XDestroyImage(image_);
+            image_ = nullptr;
+            return false;
+        }
+        shminfo_.readOnly = False;
+
+        // XShmAttach can fail asynchronously (e.g. a display forwarded from another host),
+        // so sync to find out before relying on it.
+        g_x11_error = false;
+        XShmAttach(display_, &shminfo_);
+        XSync(display_, False);
+
+        // Sentinel: Mark the segment for removal now so it cannot outlive the process
+        shmctl(shminfo_.shmid, IPC_RMID, NULL);
+
+        if (g_x11_error) {
+            XDestroyImage(image_);
+            shmdt(shminfo_.shmaddr);
+            image_ = nullptr;
+            shminfo_ = {};
             return false;
         }
+        use_shm_ = true;
+        return true;
+    }
+
+    // Captures `width` x `height` at `x, y` from now on, clipped to the screen; false if
+    // none of it is on screen
+    bool set_area(int x, int y, int width, int height) {
+        const int left = x > 0 ? x : 0;
+        const int top = y > 0 ? y : 0;
+        const int right = x + width < screen_width_ ? x + width : screen_width_;
+        const int bottom = y + height < screen_height_ ? y + height : screen_height_;
+        if (right <= left || bottom <= top) return false;
+        x_ = left;
+        y_ = top;
+        if (right - left != width_ || bottom - top != height_ || !image_) {
+            // A shared image has a fixed size, so attach one at the new size
+            release_image();
+            width_ = right - left;
+            height_ = bottom - top;
+            // Without MIT-SHM every frame goes through XGetImage instead.
+            if (shm_ && !create_shm_image()) shm_ = false;
+        }
+        return true;
+    }
+
+    // Follows a window source to where it is now
+    bool locate_window() {
+        XWindowAttributes attr;
+        g_x11_error = false;
+        if (!XGetWindowAttributes(display_, window_, &attr) || g_x11_error || attr.map_state != IsViewable) {
+            return false;
+        }
+        int x = 0;
+        int y = 0;
+        Window child = 0;
+        if (!XTranslateCoordinates(display_, window_, root_, 0, 0, &x, &y, &child)) return false;
+        return set_area(x, y, attr.width, attr.height);
+    }
 
-        if (hBitmap) DeleteObject(hBitmap);
-        hBitmap = hNewBitmap;
+    // Resolves a window id (decimal or 0x hex) or title, and moves to the window's screen
+    Window find_window(const std::string& spec) {
+        char* end = nullptr;
+        const unsigned long id = std::strtoul(spec.c_str(), &end, 0);
+        Window found = 0;
+        if (*end == '\0') {
+            found = id;
+        } else {
+            for (int s = 0; s < ScreenCount(display_) && !found; ++s) {
+                found = find_window_by_title(display_, RootWindow(display_, s), spec);
+            }
+        }
+        if (!found) return 0;
+        XWindowAttributes attr;
+        g_x11_error = false;
+        if (!XGetWindowAttributes(display_, found, &attr) || g_x11_error) return 0;
+        screen_ = XScreenNumberOfScreen(attr.screen);
+        return found;
+    }
 
-        cachedWidth = width;
-        cachedHeight = height;
+    /**
+     * @brief Reads the current contents of the source.
+     * @return The captured image (owned by the grabber), or nullptr on failure.
+     */
+    const XImage* grab() {
+        if (window_ && !locate_window()) return nullptr;
+        g_x11_error = false;
+        if (use_shm_) {
+            if (!XShmGetImage(display_, root_, image_, x_, y_, AllPlanes) || g_x11_error) return nullptr;
+            return image_;
+        }
+        if (image_) XDestroyImage(image_);
+        image_ = XGetImage(display_, root_, x_, y_, width_, height_, AllPlanes, ZPixmap);
+        return image_;
+    }
+
+public:
+    X11ScreenGrabber() = default;
+    ~X11ScreenGrabber() {
+        release_image();
+        if (display_) XCloseDisplay(display_);
     }
+    X11ScreenGrabber(const X11ScreenGrabber&) = delete;
+    X11ScreenGrabber& operator=(const X11ScreenGrabber&) = delete;
 
-    // Perform the stretch bit-block transfer from the screen to the memory DC.
-    // Use HALFTONE for better downscaling quality.
-    SetStretchBltMode(hMemoryDC, HALFTONE);
-    SetBrushOrgEx(hMemoryDC, 0, 0, NULL);
-    if (!StretchBlt(hMemoryDC, 0, 0, width, height, hScreenDC, 0, 0, screenW, screenH, SRCCOPY)) {
+    /**
+     * @brief Connects to the display and resolves `source` (its screen or window).
+     */
+    bool open(const CaptureSource& source, std::string& error) {
+        display_ = XOpenDisplay(NULL);
+        if (!display_) {
+            error = std::string("Cannot open X display '") + XDisplayName(NULL) + "'.";
+            return false;
+        }
+        // Sentinel: The default handler exits the process on any X error; report failures instead
+        XSetErrorHandler(x11_error_handler);
+
+        screen_ = source.screen < 0 ? DefaultScreen(display_) : source.screen;
+        if (screen_ >= ScreenCount(display_)) {
+            error = "X screen " + std::to_string(screen_) + " does not exist (the display has " +
+                    std::to_string(ScreenCount(display_)) + ").";
+            return false;
+        }
+        if (source.kind == CaptureSource::Kind::Window) {
+            window_ = find_window(source.window);
+            if (!window_) {
+                error = "No visible window matches '" + source.window + "'.";
+                return false;
+            }
+        }
+        root_ = RootWindow(display_, screen_);
+        screen_width_ = DisplayWidth(display_, screen_);
+        screen_height_ = DisplayHeight(display_, screen_);
+        shm_ = XShmQueryExtension(display_) != False;
+
+        switch (source.kind) {
+        case CaptureSource::Kind::Screen:
+            if (set_area(0, 0, screen_width_, screen_height_)) return true;
+            error = "X screen " + std::to_string(screen_) + " has no size.";
+            return false;
+        case CaptureSource::Kind::Region:
+            if (set_area(source.x, source.y, source.width, source.height)) return true;
+            error = "Region lies outside X screen " + std::to_string(screen_) + " (" + std::to_string(screen_width_) +
+                    "x" + std::to_string(screen_height_) + ").";
+            return false;
+        case CaptureSource::Kind::Window:
+            if (locate_window()) return true;
+            error = "Window '" + source.window + "' is not on screen.";
+            return false;
+        }
         return false;
     }
 
-    // Setup the bitmap info structure to get the pixel data.
-    BITMAPINFOHEADER bi = {};
-    bi.biSize = sizeof(BITMAPINFOHEADER);
-    bi.biWidth = width;
-    bi.biHeight = -height; // A negative height indicates a top-down DIB.
-    bi.biPlanes = 1;
-    bi.biBitCount = 32; // We want 32-bit BGRA format.
-    bi.biCompression = BI_RGB;
+    /**
+     * @brief Captures the source (MIT-SHM when available) scaled to `size` pixels (see
+     * Renderer::image_size()).
+     * @param scaler Area-averages the full-resolution image down to the console size.
+     * @return True on success, false on failure.
+     */
+    bool capture(SecureBuffer& buffer, const Geometry& size, AreaDownscaler* scaler) {
+        const XImage* image = nullptr;
+        {
+            StageTimer capture_timer(g_stats, Stage::Capture);
+            image = grab();
+        }
+        if (!image) {
+            return false;
+        }
+
+        // We read the image as BGRA; other visuals (16-bit, big-endian servers) are not supported.
+        if (image->bits_per_pixel != 32 || image->byte_order != LSBFirst ||
+            image->red_mask != 0xff0000 || image->green_mask != 0xff00 || image->blue_mask != 0xff) {
+            return false;
+        }
+
+        // Use size_t for calculation to prevent integer overflow
+        size_t required_size = static_cast<size_t>(size.width) * size.height * 4;
+        if (buffer.size() != required_size) {
+            buffer.resize(required_size);
+        }
+
+        // Downscale straight out of the shared segment.
+        const ImageView view = {reinterpret_cast<const unsigned char*>(image->data), image->width, image->height,
+                               static_cast<size_t>(image->bytes_per_line)};
+        StageTimer scale_timer(g_stats, Stage::Scale);
+        scaler->scale(view, size.width, size.height, buffer.data());
+        return true;
+    }
+};
+
+using ScreenGrabber = X11ScreenGrabber;
+#endif
+
+#if defined(_WIN32) || defined(SCRN_HAVE_X11)
+
+/**
+ * @brief Writes rendered frames to the console, each with one write through an OutputSink.
+ * In diff mode only the runs that changed since the last frame are sent, positioned with
+ * ANSI escapes (console regions on Windows, unless the frames carry color escapes that only
+ * the terminal can interpret); mostly-changed frames are redrawn in full.
+ */
+class FramePresenter {
+    bool diff_;
+    bool ansi_;
+    FrameDiffer differ_;
+    std::vector<DiffRun> runs_;
+    std::string scratch_;
+    OutputSink sink_;
+    bool redraw_ = true; // the console no longer shows the last frame
+
+public:
+    /**
+     * @param ansi Frames contain ANSI escapes; on Windows changed runs are then also sent
+     *             as escapes rather than written to console regions.
+     * @param non_blocking Don't wait for a slow terminal (see OutputSink).
+     */
+    FramePresenter(bool diff, bool ansi, bool non_blocking = false)
+        : diff_(diff), ansi_(ansi), sink_(non_blocking) {}
+
+    /**
+     * @return Bytes of the frame the terminal has not taken yet, with non-blocking output;
+     * drain() sends them.
+     */
+    size_t present(const std::string& ascii_frame) {
+        StageTimer timer(g_stats, Stage::Output);
+        redraw_ = false;
+        if (!diff_ || !differ_.diff(ascii_frame, runs_)) {
+            return sink_.write_frame(ascii_frame);
+        }
+#ifdef _WIN32
+        if (!ansi_) {
+            HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+            for (const DiffRun& run : runs_) {
+                DWORD written = 0;
+                COORD pos = {(SHORT)run.col, (SHORT)run.row};
+                WriteConsoleOutputCharacterA(hOut, ascii_frame.data() + run.offset, (DWORD)run.length, pos, &written);
+            }
+            return 0;
+        }
+#endif
+        scratch_.clear();
+        append_ansi_runs(ascii_frame, runs_, scratch_);
+        return sink_.write(scratch_);
+    }
+
+    /**
+     * @brief Sends more of a frame the terminal took only part of.
+     * @return True once the whole frame is out.
+     */
+    bool drain() {
+        StageTimer timer(g_stats, Stage::Output);
+        return sink_.flush() == 0;
+    }
+
+    /**
+     * @brief Forces the next frame to be drawn in full (something else wrote to the console).
+     */
+    void invalidate() {
+        differ_.reset();
+        redraw_ = true;
+    }
+
+    /**
+     * @brief Starts over after the console was resized: blanks it and redraws the next frame in full.
+     */
+    void resize() {
+        sink_.clear();
+        invalidate();
+    }
+
+    // True until a frame is presented after construction, invalidate() or resize()
+    bool needs_redraw() const { return redraw_; }
+};
 
-    // Use size_t for calculation to prevent integer overflow
-    size_t required_size = static_cast<size_t>(width) * height * 4;
-    if (buffer.size() != required_size) {
-        buffer.resize(required_size);
+#ifdef _WIN32
+/**
+ * @brief Turns on the console's VT processing (Windows 10 and later) so ANSI escapes work.
+ */
+void enable_virtual_terminal() {
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD console_mode = 0;
+    if (!GetConsoleMode(hOut, &console_mode) ||
+        !SetConsoleMode(hOut, console_mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING)) {
+        std::cerr << "Warning: This console does not support ANSI escapes." << std::endl;
     }
+}
+
+/**
+ * @brief Handles interactive input ([q] quit, [p] pause/resume).
+ * Pausing blocks here until the user resumes.
+ * @param presenter Invalidated after the pause message overwrote the screen.
+ * @return False if the user asked to quit.
+ */
+bool handle_controls(FramePresenter& presenter) {
+    if (!_kbhit()) return true;
 
-    // Extract the pixel data from the bitmap.
-    if (GetDIBits(hScreenDC, hBitmap, 0, (UINT)height, buffer.data(), (BITMAPINFO*)&bi, DIB_RGB_COLORS) == 0) {
+    int key = _getch();
+    if (key == 'q' || key == 'Q') {
         return false;
+    } else if (key == 'p' || key == 'P') {
+        // Update status bar to indicate pause without scrolling
+        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+        CONSOLE_SCREEN_BUFFER_INFO csbi;
+        // Sentinel: Check return values to prevent use of uninitialized memory
+        if (hConsole != INVALID_HANDLE_VALUE && GetConsoleScreenBufferInfo(hConsole, &csbi)) {
+            SHORT width = csbi.dwSize.X;
+            SHORT height = csbi.dwSize.Y;
+            COORD statusPos = {0, (SHORT)(height - 1)};
+
+            // Sentinel: Use SetConsoleCursorPosition to ensure we overwrite the status line correctly
+            // instead of relying on implicit cursor position which might be wrong
+            SetConsoleCursorPosition(hConsole, statusPos);
+
+            std::string pauseMsg = " [ PAUSED ] Press 'p' to resume...";
+            if (pauseMsg.length() < width) pauseMsg.append(width - pauseMsg.length(), ' ');
+            std::cout << pauseMsg << std::flush;
+        } else {
+            // Fallback if we can't get console info
+            std::cout << " [ PAUSED ] Press 'p' to resume..." << std::flush;
+        }
+
+        while (true) {
+            if (_kbhit()) {
+                int resume_key = _getch();
+                if (resume_key == 'p' || resume_key == 'P') {
+                    break;
+                } else if (resume_key == 'q' || resume_key == 'Q') {
+                    return false;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        presenter.invalidate();
+    }
+    return true;
+}
+#endif
+
+/**
+ * @brief The part of a captured frame that is shown: the capture's last row of cells lies
+ * under the status bar.
+ */
+ImageView live_picture(const Renderer& renderer, const SecureBuffer& pixels, const Geometry& geometry) {
+    const Geometry size = renderer.image_size({geometry.width, geometry.height - 1});
+    return {pixels.data(), size.width, size.height, static_cast<size_t>(size.width) * 4};
+}
+
+/**
+ * @brief Fills in the status bar text for a live frame.
+ * @param changed Share of the screen that has been changing.
+ */
+void format_status(const std::string& mode, int fps, double changed, std::string& status) {
+    status.assign(" [ AsciiScreen ] Mode: ").append(mode).append(" | FPS: ").append(std::to_string(fps));
+    status.append(" | Changed: ").append(std::to_string(static_cast<int>(changed * 100 + 0.5))).append("%");
+    status.append(" | [P]ause [Q]uit");
+}
+
+/**
+ * @brief Frames drawn per second, for the status bar, over the last whole second. Updated on
+ * every capture, drawn or not, so a static screen shows the rate dropping instead of the
+ * last one, and the first rate after it isn't averaged over the idle time.
+ */
+class FpsMeter {
+public:
+    // Starts a new second once the last one is over
+    void update() {
+        const auto now = std::chrono::steady_clock::now();
+        const double seconds = std::chrono::duration<double>(now - since_).count();
+        if (seconds < 1.0) return;
+        fps_ = static_cast<int>(frames_ / seconds);
+        frames_ = 0;
+        since_ = now;
+    }
+
+    void frame_drawn() { ++frames_; }
+
+    int fps() const { return fps_; }
+
+private:
+    std::chrono::steady_clock::time_point since_ = std::chrono::steady_clock::now();
+    int frames_ = 0;
+    int fps_ = 0;
+};
+
+/**
+ * @brief Renders a captured frame for the console: the picture, then the status bar on the last row.
+ * @param tiles Hashes of `picture`; only rows under changed tiles are converted again.
+ * @param status Status bar text, from format_status().
+ */
+void render_live_frame(Renderer& renderer, const ImageView& picture, const TileHasher& tiles, const std::string& status,
+                       std::string& text) {
+    StageTimer timer(g_stats, Stage::Convert);
+    renderer.render(picture, tiles, text, &status);
+}
+
+// Packs a geometry into one word so pipeline stages can share it through an atomic
+inline uint32_t pack_geometry(const Geometry& g) { return static_cast<uint32_t>(g.width) << 16 | static_cast<uint32_t>(g.height); }
+inline Geometry unpack_geometry(uint32_t v) { return {static_cast<int>(v >> 16), static_cast<int>(v & 0xFFFF)}; }
+
+// Pipeline slots: a frame along with the cell grid it was produced for
+struct CapturedFrame {
+    SecureBuffer pixels;
+    Geometry geometry;
+};
+struct RenderedFrame {
+    std::string text;
+    Geometry geometry;
+};
+
+/**
+ * @brief Runs capture, conversion and output concurrently.
+ *
+ * Each stage owns a thread (output stays on the calling thread) and hands frames to the
+ * next through a FrameRing of recycled buffers, so capturing frame N+1 overlaps converting
+ * frame N and writing frame N-1. Stages always pick up the newest frame; anything a slower
+ * stage could not get to is dropped instead of queued.
+ *
+ * The output stage watches for console resizes and publishes the new grid to the capture
+ * stage; frames still in flight at the old size are dropped.
+ *
+ * Capture is paced by a FrameScheduler, and skips its slot while the previous frame is
+ * still waiting for (or being drained by) the terminal rather than capturing one that
+ * would only be dropped. With a recorder or server it keeps capturing, and only drawing
+ * is skipped.
+ */
+void run_pipeline(Renderer& renderer, ScreenGrabber& grabber, const Options& opts, AreaDownscaler* scaler,
+                  Geometry geometry, RecordingWriter* recorder, StreamServer* server) {
+    // Three slots per ring: one being filled, one waiting, one being consumed
+    FrameRing<CapturedFrame> captures(3);
+    FrameRing<RenderedFrame> frames(3);
+    std::atomic<int> current_fps(0);
+    std::atomic<double> changed(0.0);
+    std::atomic<bool> partial(false); // the output stage had to wait for the terminal
+    std::atomic<uint32_t> target_geometry(pack_geometry(geometry));
+
+    std::thread capture_thread([&] {
+        FrameScheduler scheduler(opts.fps);
+        TileHasher tiles;
+        size_t slot;
+        while (captures.acquire(slot)) {
+            scheduler.wait();
+            if (partial.exchange(false)) scheduler.frame_partial();
+            if (frames.ready() > 0 || (pending_output() > 0 && !recorder && !server)) {
+                captures.release(slot);
+                scheduler.frame_skipped();
+                continue;
+            }
+            CapturedFrame& capture = captures[slot];
+            capture.geometry = unpack_geometry(target_geometry.load());
+            if (!grabber.capture(capture.pixels, renderer.image_size(capture.geometry), scaler)) {
+                captures.release(slot);
+                std::cerr << "Error: Failed to capture screen." << std::endl;
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+                continue;
+            }
+            // Unchanged frames still go through, so the output stage keeps polling
+            // controls and resizes; the scheduler just samples them less often
+            tiles.update(live_picture(renderer, capture.pixels, capture.geometry));
+            scheduler.frame_done(tiles.dirty_fraction());
+            changed.store(scheduler.dirty_fraction());
+            captures.publish(slot);
+        }
+    });
+
+    std::thread convert_thread([&] {
+        // Hashed again here: dirty tiles must be relative to the last frame converted, and
+        // captures in between may have been dropped
+        TileHasher tiles;
+        std::string status;
+        size_t in;
+        size_t out;
+        while (captures.take_latest(in)) {
+            if (!frames.acquire(out)) {
+                captures.release(in);
+                break;
+            }
+            const CapturedFrame& capture = captures[in];
+            const ImageView picture = live_picture(renderer, capture.pixels, capture.geometry);
+            tiles.update(picture);
+            format_status(opts.mode, current_fps.load(), changed.load(), status);
+            render_live_frame(renderer, picture, tiles, status, frames[out].text);
+            frames[out].geometry = capture.geometry;
+            captures.release(in);
+            frames.publish(out);
+        }
+    });
+
+    FramePresenter presenter(opts.diff, opts.color != ColorMode::Mono, opts.nonblock);
+    int frame_count = 0;
+    auto last_fps_time = std::chrono::high_resolution_clock::now();
+    const auto record_start = std::chrono::steady_clock::now();
+    size_t slot;
+    while (!g_interrupted && frames.take_latest(slot)) {
+#ifdef _WIN32
+        if (!handle_controls(presenter)) {
+            frames.release(slot);
+            break;
+        }
+#endif
+        if (poll_resize(geometry)) {
+            target_geometry = pack_geometry(geometry);
+            presenter.resize();
+        }
+        const RenderedFrame& frame = frames[slot];
+        if (frame.geometry != geometry) {
+            // Captured before the resize; the next one is at the new size
+            frames.release(slot);
+            continue;
+        }
+        // A backed-up terminal skips the frame; every frame reaches this stage, so it catches
+        // up with the next one it can take
+        const bool backed_up = !presenter.drain() || pending_output() > 0;
+        if (!backed_up && presenter.present(frame.text) > 0) partial = true;
+        if (recorder) recorder->write(frame.text, elapsed_us(record_start));
+        if (server) server->broadcast(frame.text);
+        frames.release(slot);
+        if (!recorder && !server) {
+            // Nothing else needs the frames, so this thread waits for the terminal here; capture
+            // skips its slots meanwhile since the next frame can't be taken
+            while (!presenter.drain() && !g_interrupted) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        frame_count++;
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration<double>(end_time - last_fps_time);
+        if (duration.count() >= 1.0) {
+            current_fps = static_cast<int>(frame_count / duration.count());
+            frame_count = 0;
+            last_fps_time = end_time;
+        }
+    }
+
+    captures.close();
+    frames.close();
+    capture_thread.join();
+    convert_thread.join();
+}
+
+// One source of a tiled capture, with everything it needs to be captured and converted on
+// a thread of its own
+struct TiledSource {
+    ScreenGrabber& grabber;
+    AreaDownscaler scaler; // single-threaded: the sources already run in parallel
+    SecureBuffer pixels;
+    TileHasher tiles;
+    Renderer renderer;
+    bool captured = false;
+    size_t dirty = 0; // tiles that changed in this frame
+
+    TiledSource(ScreenGrabber& source, const Renderer& prototype) : grabber(source), renderer(prototype) {}
+};
+
+/**
+ * @brief Captures several sources and shows them side by side (--source, --monitors).
+ *
+ * Every source has its own grabber, downscaler, tile hashes and renderer, and is captured,
+ * scaled and converted on a pool thread of its own; a Mosaic then joins the tiles and the
+ * status bar into one frame. A source that didn't change is not converted again, and one
+ * that fails to capture (e.g. a minimized window) is left blank while the others go on.
+ */
+void run_tiled(const Renderer& renderer, const Options& opts, std::vector<std::unique_ptr<ScreenGrabber>>& grabbers,
+               Geometry geometry, RecordingWriter* recorder, StreamServer* server) {
+    const size_t count = grabbers.size();
+    const bool software = opts.scaler == "area";
+    std::vector<std::unique_ptr<TiledSource>> sources;
+    for (auto& grabber : grabbers) {
+        sources.push_back(std::make_unique<TiledSource>(*grabber, renderer));
+        // Error diffusion and conversion stay on the source's own thread
+        sources.back()->renderer.set_dither(opts.dither, nullptr);
+        sources.back()->renderer.set_pool(nullptr);
+    }
+    // One thread per source, the calling thread included
+    ThreadPool pool(count);
+
+    FramePresenter presenter(opts.diff, opts.color != ColorMode::Mono, opts.nonblock);
+    FrameScheduler scheduler(opts.fps);
+    Mosaic mosaic;
+    std::vector<std::string> texts(count);
+    std::string frame;
+    std::string status;
+    std::string shown_status; // in the last frame
+    bool screen_behind = false; // the last frame was not drawn, the terminal was backed up
+
+    FpsMeter fps;
+    const auto record_start = std::chrono::steady_clock::now();
+    while (!g_interrupted) {
+        scheduler.wait();
+
+#ifdef _WIN32
+        if (!handle_controls(presenter)) {
+            break;
+        }
+#endif
+        if (poll_resize(geometry)) {
+            presenter.resize();
+        }
+        // As in the single-source loop, a backed-up terminal only skips drawing the frame
+        const bool backed_up = !presenter.drain() || pending_output() > 0;
+        if (backed_up && !recorder && !server) {
+            scheduler.frame_skipped();
+            continue;
+        }
+        const Geometry grid = {geometry.width, geometry.height - 1};
+        if (mosaic.grid() != grid || mosaic.size() != count) mosaic.layout(count, grid);
+
+        const bool redraw = presenter.needs_redraw();
+        pool.parallel_for(count, count, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i) {
+                TiledSource& source = *sources[i];
+                const Geometry size = source.renderer.image_size(mosaic.tile(i));
+                source.dirty = 0;
+                if (size.width <= 0 || size.height <= 0) {
+                    // The terminal is too small to give this source any cells
+                    source.captured = true;
+                    texts[i].clear();
+                    continue;
+                }
+                source.captured = source.grabber.capture(source.pixels, size, software ? &source.scaler : nullptr);
+                if (!source.captured) {
+                    // Convert it in full once it's back
+                    source.tiles.reset();
+                    continue;
+                }
+                const ImageView picture = {source.pixels.data(), size.width, size.height,
+                                          static_cast<size_t>(size.width) * 4};
+                source.dirty = source.tiles.update(picture);
+                if (source.dirty == 0 && !redraw) continue;
+                StageTimer timer(g_stats, Stage::Convert);
+                source.renderer.render(picture, source.tiles, texts[i]);
+            }
+        });
+
+        size_t dirty = 0;
+        size_t hashed = 0;
+        size_t failed = 0;
+        bool blanked = false;
+        for (size_t i = 0; i < count; ++i) {
+            const TiledSource& source = *sources[i];
+            if (!source.captured) {
+                ++failed;
+                blanked |= !texts[i].empty();
+                texts[i].clear();
+                continue;
+            }
+            dirty += source.dirty;
+            hashed += static_cast<size_t>(source.tiles.columns()) * source.tiles.rows();
+        }
+        if (failed == count) {
+            std::cerr << "Error: Failed to capture screen." << std::endl;
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
+        }
+        scheduler.frame_done(hashed ? static_cast<double>(dirty) / hashed : 0.0);
+        // The status bar moves on while the screen stands still, so it is drawn again when
+        // its text changes; the tiles come from the cache
+        fps.update();
+        format_status(opts.mode, fps.fps(), scheduler.dirty_fraction(), status);
+        const bool fresh = dirty > 0 || blanked || redraw || status != shown_status;
+        if (!fresh && !(screen_behind && !backed_up)) {
+            continue;
+        }
+
+        if (fresh) {
+            {
+                StageTimer timer(g_stats, Stage::Convert);
+                mosaic.compose(texts, opts.color != ColorMode::Mono, &status, frame);
+            }
+            shown_status = status;
+            if (recorder) recorder->write(frame, elapsed_us(record_start));
+            if (server) server->broadcast(frame);
+            fps.frame_drawn();
+        }
+        screen_behind = backed_up;
+        if (backed_up) {
+            scheduler.frame_skipped();
+        } else if (presenter.present(frame) > 0) {
+            scheduler.frame_partial();
+        }
+    }
+}
+
+/**
+ * @brief Converts every frame of `opts.input` as fast as possible and writes them to `opts.output`.
+ * Nothing touches the console or the screen, so this runs headless (e.g. in CI).
+ * @return Process exit code.
+ */
+int run_batch(Renderer& renderer, const Options& opts, AreaDownscaler& scaler,
+              RecordingWriter* recorder) {
+    std::string error;
+    std::unique_ptr<FrameSource> source = open_frame_source(opts.input, error);
+    if (!source) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    std::ofstream file;
+    if (!opts.output.empty() && opts.output != "-") {
+        file.open(opts.output, std::ios::binary);
+        if (!file) {
+            std::cerr << "Error: Cannot open output '" << opts.output << "'" << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = file.is_open() ? static_cast<std::ostream&>(file) : std::cout;
+
+    // Pixels per cell depend on how the renderer picks glyphs
+    const Geometry size = renderer.image_size({CONSOLE_WIDTH, CONSOLE_HEIGHT});
+    std::vector<unsigned char> cells(static_cast<size_t>(size.width) * size.height * 4);
+    const ImageView cells_view = {cells.data(), size.width, size.height, static_cast<size_t>(size.width) * 4};
+    std::string ascii_frame;
+    long long frames = 0;
+    ImageView frame = {};
+
+    // Bolt: No pacing here; the conversion runs flat out so the rate below is its real throughput
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (;;) {
+        {
+            // Decoding the input stands in for capture here
+            StageTimer timer(g_stats, Stage::Capture);
+            if (!source->next(frame)) break;
+        }
+        {
+            StageTimer timer(g_stats, Stage::Scale);
+            scaler.scale(frame, size.width, size.height, cells.data());
+        }
+        {
+            StageTimer timer(g_stats, Stage::Convert);
+            renderer.render(cells_view, ascii_frame);
+        }
+        {
+            StageTimer timer(g_stats, Stage::Output);
+            out.write(ascii_frame.data(), static_cast<std::streamsize>(ascii_frame.size()));
+            out.write("\f\n", 2);
+        }
+        // Frames from a file have no capture time; record them at the target rate
+        if (recorder) recorder->write(ascii_frame, static_cast<uint64_t>(frames * 1e6 / opts.fps));
+        frames++;
+    }
+    out.flush();
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+    if (!source->error().empty()) {
+        std::cerr << "Error: " << opts.input << ": " << source->error() << std::endl;
+    }
+    if (!out) {
+        std::cerr << "Error: Failed to write output." << std::endl;
+        return 1;
     }
+    std::cerr << "Converted " << frames << " " << source->format() << " frames in " << std::fixed
+              << std::setprecision(3) << seconds << " s (" << std::setprecision(1)
+              << (seconds > 0 ? frames / seconds : 0.0) << " frames/s)" << std::endl;
+    return source->error().empty() ? 0 : 1;
+}
 
+/**
+ * @brief Writes the recording's seek index and reports its size.
+ * @return False if the recording could not be completed.
+ */
+bool finish_recording(RecordingWriter* recorder) {
+    if (!recorder) return true;
+    if (!recorder->finish()) {
+        std::cerr << "Error: Failed to write the recording." << std::endl;
+        return false;
+    }
+    std::cerr << "Recorded " << recorder->frame_count() << " frames in " << recorder->bytes_written() / 1024
+              << " KiB" << std::endl;
     return true;
 }
 
+/**
+ * @brief Plays a recording back, paced by its timestamps.
+ * @return Process exit code.
+ */
+int run_play(const Options& opts) {
+    RecordingReader reader;
+    std::string error;
+    if (!reader.open(opts.play, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    if (!reader.indexed()) {
+        std::cerr << "Warning: '" << opts.play << "' has no seek index (recording cut short?); rebuilt it." << std::endl;
+    }
+    if (opts.seek > 0.0) {
+        reader.seek(static_cast<uint64_t>(opts.seek * 1e6));
+    }
+
+#ifdef _WIN32
+    // Recordings may carry color escapes, so they are always written as ANSI
+    enable_virtual_terminal();
+#endif
+    FramePresenter presenter(opts.diff, true);
+    const std::string* frame = nullptr;
+    uint64_t timestamp = 0;
+    uint64_t first_timestamp = 0;
+    auto start = std::chrono::steady_clock::now();
+    bool first = true;
+    while (reader.next(frame, timestamp)) {
+#ifdef _WIN32
+        if (!handle_controls(presenter)) break;
+#endif
+        const auto offset = std::chrono::microseconds(first ? 0 : timestamp - first_timestamp);
+        if (first) {
+            first_timestamp = timestamp;
+            first = false;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (now > start + offset + std::chrono::milliseconds(250)) {
+            // Paused, or the terminal fell behind: carry on from here rather than racing to catch up
+            start = now - offset;
+        }
+        std::this_thread::sleep_until(start + offset);
+        presenter.present(*frame);
+    }
+    if (!reader.error().empty()) {
+        std::cerr << "Error: " << opts.play << ": " << reader.error() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
 #ifdef _WIN32
     std::unique_ptr<ConsoleCodePageGuard> cp_guard;
@@ -316,8 +1755,8 @@ int main(int argc, char* argv[]) {
 #endif
     bool show_help = false;
     std::string error;
-    std::string mode = "normal";
-    std::string ramp_or_mode = get_ascii_ramp_from_args(argc, argv, show_help, error);
+    Options opts;
+    parse_args(argc, argv, opts, show_help, error);
     if (show_help) {
         if (!error.empty()) {
             std::cerr << error << std::endl;
@@ -325,50 +1764,139 @@ int main(int argc, char* argv[]) {
         print_help();
         return error.empty() ? 0 : 1;
     }
-    // If ramp_or_mode is not a valid ramp, get_ascii_ramp_from_args returns the mode string (for error reporting)
-    // So, we need to extract the mode string from the arguments for later use
-    // We'll parse it again here for simplicity
-    for (int i = 1; i < argc; ++i) {
-        std::string arg = argv[i];
-        if ((arg == "--mode" || arg == "-m") && i + 1 < argc) {
-            mode = argv[i + 1];
-            break;
-        }
-        if (arg.rfind("--mode=", 0) == 0) {
-            mode = arg.substr(7);
-            break;
+    const std::string& mode = opts.mode;
+    const std::string& ASCII_RAMP = opts.ramp;
+
+    const bool colored = opts.color != ColorMode::Mono;
+
+    // Bolt: Stage timers only read the clock when --stats is on
+    std::unique_ptr<StageStats> stage_stats;
+    std::unique_ptr<StatsExporter> stats_exporter;
+    if (!opts.stats.empty()) {
+        stage_stats = std::make_unique<StageStats>();
+        stats_exporter = std::make_unique<StatsExporter>(*stage_stats, opts.stats);
+        g_stats = stage_stats.get();
+        stats_exporter->start();
+    }
+
+    if (!opts.play.empty()) {
+        return run_play(opts);
+    }
+
+    std::unique_ptr<RecordingWriter> recorder;
+    if (!opts.record.empty()) {
+        recorder = std::make_unique<RecordingWriter>();
+        if (!recorder->open(opts.record, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
         }
-        if (arg.rfind("-m=", 0) == 0) {
-            mode = arg.substr(3);
-            break;
+        // Stop cleanly on Ctrl+C so the recording gets its seek index
+        std::signal(SIGINT, on_interrupt);
+    }
+
+    std::unique_ptr<StreamServer> server;
+    if (!opts.serve.empty()) {
+        server = std::make_unique<StreamServer>();
+        if (!server->start(opts.serve, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
         }
+        std::cout << "Streaming frames to TCP clients on " << opts.serve << "\n";
     }
-    const std::string& ASCII_RAMP = ramp_or_mode;
-    const auto frame_duration = std::chrono::milliseconds(1000 / TARGET_FPS);
 
+    if (!opts.input.empty()) {
+        // Batch mode: frames go to the output as UTF-8 with no status bar, and only
+        // diagnostics to stderr, so stdout can carry the frames
+        Renderer renderer(ASCII_RAMP, GlyphEncoding::Utf8, opts.color, opts.color_layer, opts.cells);
+        ThreadPool pool(opts.threads);
+        AreaDownscaler scaler(&pool);
+        renderer.set_dither(opts.dither, &pool);
+        renderer.set_tone(opts.contrast, opts.calibrate);
+        renderer.set_pool(&pool);
+        const int status = run_batch(renderer, opts, scaler, recorder.get());
+        return finish_recording(recorder.get()) ? status : 1;
+    }
+
+    std::vector<CaptureSource> sources = opts.sources;
+    if (opts.monitors) {
+        const int screens = screen_count();
+        for (int i = 0; i < screens; ++i) {
+            CaptureSource source;
+            source.screen = i;
+            sources.push_back(source);
+        }
+    }
+    if (sources.empty()) sources.push_back(CaptureSource());
+#ifdef SCRN_HAVE_X11
+    // Tiled sources are captured on several threads at once, each over its own connection
+    if (sources.size() > 1) XInitThreads();
+#endif
+    std::vector<std::unique_ptr<ScreenGrabber>> grabbers;
+    for (const CaptureSource& source : sources) {
+        grabbers.push_back(std::make_unique<ScreenGrabber>());
+        // Sentinel: Fail fast instead of retrying forever when there is no display or the
+        // source doesn't exist
+        if (!grabbers.back()->open(source, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+    }
+#ifdef _WIN32
     std::cout << "Starting screen capture using GDI...\n";
+#else
+    std::cout << "Starting screen capture using X11...\n";
+#endif
+    if (grabbers.size() > 1) std::cout << "Capturing " << grabbers.size() << " sources side by side.\n";
 #ifdef _WIN32
     std::cout << "Controls: [q] Quit  [p] Pause/Resume\n";
 #else
     std::cout << "Press Ctrl+C to exit.\n";
 #endif
+    GlyphEncoding glyph_encoding = GlyphEncoding::Utf8;
+
     std::cout << "Current mode: '" << mode << "' (" << ASCII_RAMP << ")" << std::endl;
+
+    // Follow the terminal's size; fall back to the defaults when stdout is not a terminal
+    Geometry geometry = {CONSOLE_WIDTH, CONSOLE_HEIGHT};
+    query_terminal_geometry(geometry);
+#ifndef _WIN32
+    std::signal(SIGWINCH, on_resize);
+#endif
+    std::cout << "Console size: " << geometry.width << "x" << geometry.height << std::endl;
+    // Braille and half blocks are always drawn in Unicode, whatever the mode's ramp
+    const bool unicode_cells = opts.cells == CellMode::Braille || opts.cells == CellMode::HalfBlock;
+    const bool unicode = unicode_cells || ramp_has_unicode(ASCII_RAMP);
     // Set code page for Windows console depending on mode
 #ifdef _WIN32
-    if (mode == "codepage437") {
+    if (mode == "codepage437" && !unicode_cells) {
         cp_guard = std::make_unique<ConsoleCodePageGuard>(437);
+        glyph_encoding = GlyphEncoding::CodePage437;
         std::cout << "\n[Info] Using code page 437 (OEM US) for this mode.\n";
         std::cout << "[Tip] For best results, use a raster font or 'Terminal' font in your console.\n";
-    } else if (ramp_has_unicode(ASCII_RAMP)) {
+    } else if (unicode) {
         cp_guard = std::make_unique<ConsoleCodePageGuard>(65001);
         std::cout << "\n[Info] This mode uses Unicode characters.\n";
         std::cout << "[Tip] For best results, use a Unicode font (like 'Consolas' or 'Cascadia Mono') in your terminal.\n";
     }
 #else
-    if (ramp_has_unicode(ASCII_RAMP)) {
+    if (unicode) {
         std::cout << "\n[Info] This mode uses Unicode characters.\n";
     }
 #endif
+
+    // Bolt: Precompute the gray level to glyph table and pick the widest SIMD conversion
+    // kernel this CPU supports, once
+    Renderer renderer(ASCII_RAMP, glyph_encoding, opts.color, opts.color_layer, opts.cells);
+    std::cout << "Conversion kernel: " << renderer.kernel_name() << std::endl;
+    // Bolt: Map and lock the capture buffers up front: one per pipeline slot, else one
+    // (tiled sources are smaller and share the slabs)
+    const Geometry full_size = renderer.image_size(geometry);
+    FramePool& frame_pool = FramePool::shared();
+    frame_pool.reserve(static_cast<size_t>(full_size.width) * full_size.height * 4, opts.pipeline ? 3 : 1);
+    if (frame_pool.locked_bytes() < frame_pool.mapped_bytes()) {
+        std::cerr << "Warning: Could not lock the frame buffers in memory (see ulimit -l); "
+                     "screen contents may be swapped out." << std::endl;
+    }
 #ifdef _WIN32
     std::cout << "\nPress any key to skip countdown...\n";
 #endif
@@ -387,140 +1915,114 @@ int main(int argc, char* argv[]) {
         }
     }
     std::cout << "\rStarting...       " << std::endl;
+    // Stop cleanly on Ctrl+C so a frame the terminal has only taken part of is finished
+    if (opts.nonblock) std::signal(SIGINT, on_interrupt);
+
+#ifdef _WIN32
+    // Color escapes need the console's VT processing
+    if (colored) enable_virtual_terminal();
+#endif
+
+    // Bolt: Scale on all cores; the pool's threads persist across frames
+    ThreadPool pool(opts.threads);
+    AreaDownscaler area_scaler(&pool);
+    AreaDownscaler* scaler = opts.scaler == "area" ? &area_scaler : nullptr;
+    // The pipeline scales on the capture thread while it converts, and a pool runs one job
+    // at a time, so conversion and error diffusion get threads of their own there
+    std::unique_ptr<ThreadPool> convert_pool;
+    if (opts.pipeline) convert_pool = std::make_unique<ThreadPool>(opts.threads);
+    renderer.set_dither(opts.dither, convert_pool ? convert_pool.get() : &pool);
+    renderer.set_tone(opts.contrast, opts.calibrate);
+    renderer.set_pool(convert_pool ? convert_pool.get() : &pool);
+
+    if (opts.pipeline) {
+        run_pipeline(renderer, *grabbers[0], opts, scaler, geometry, recorder.get(), server.get());
+        return finish_recording(recorder.get()) ? 0 : 1;
+    }
+    if (grabbers.size() > 1) {
+        run_tiled(renderer, opts, grabbers, geometry, recorder.get(), server.get());
+        return finish_recording(recorder.get()) ? 0 : 1;
+    }
+    ScreenGrabber& grabber = *grabbers[0];
 
+    FramePresenter presenter(opts.diff, colored, opts.nonblock);
     SecureBuffer frame_buffer;
-    int src_width = 0;
-    int src_height = 0;
 
-    int frame_count = 0;
-    int current_fps = 0;
-    auto last_fps_time = std::chrono::high_resolution_clock::now();
+    FpsMeter fps;
 
     // Bolt: Reuse buffer to avoid reallocation overhead (~1.2x speedup)
     std::string ascii_frame;
-    ascii_frame.reserve((CONSOLE_WIDTH + 1) * CONSOLE_HEIGHT);
+    ascii_frame.reserve((geometry.width + 1) * geometry.height);
+    std::string status;
+    std::string shown_status; // in the last frame
+    bool screen_behind = false; // the last frame was not drawn, the terminal was backed up
 
-    // Bolt: Precompute lookup table for grayscale to ASCII conversion
-    // This avoids per-pixel division and multiplication.
-    std::vector<char> gray_lookup(256);
-    for (int i = 0; i < 256; ++i) {
-        gray_lookup[i] = ASCII_RAMP[(i * (ASCII_RAMP.length() - 1)) / 255];
-    }
+    // Bolt: Pace frames against absolute deadlines, and only convert and draw the parts of
+    // frames that changed, so CPU use follows how much the screen changes
+    FrameScheduler scheduler(opts.fps);
+    TileHasher tiles;
 
-    while (true) {
-        auto start_time = std::chrono::high_resolution_clock::now();
+    const auto record_start = std::chrono::steady_clock::now();
+    while (!g_interrupted) {
+        scheduler.wait();
 
 #ifdef _WIN32
-        // Handle interactive input
-        if (_kbhit()) {
-            int key = _getch();
-            if (key == 'q' || key == 'Q') {
-                break;
-            } else if (key == 'p' || key == 'P') {
-                // Update status bar to indicate pause without scrolling
-                HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-                CONSOLE_SCREEN_BUFFER_INFO csbi;
-                // Sentinel: Check return values to prevent use of uninitialized memory
-                if (hConsole != INVALID_HANDLE_VALUE && GetConsoleScreenBufferInfo(hConsole, &csbi)) {
-                    SHORT width = csbi.dwSize.X;
-                    SHORT height = csbi.dwSize.Y;
-                    COORD statusPos = {0, (SHORT)(height - 1)};
-
-                    // Sentinel: Use SetConsoleCursorPosition to ensure we overwrite the status line correctly
-                    // instead of relying on implicit cursor position which might be wrong
-                    SetConsoleCursorPosition(hConsole, statusPos);
-
-                    std::string pauseMsg = " [ PAUSED ] Press 'p' to resume...";
-                    if (pauseMsg.length() < width) pauseMsg.append(width - pauseMsg.length(), ' ');
-                    std::cout << pauseMsg << std::flush;
-                } else {
-                    // Fallback if we can't get console info
-                    std::cout << " [ PAUSED ] Press 'p' to resume..." << std::flush;
-                }
-
-                while (true) {
-                    if (_kbhit()) {
-                        int resume_key = _getch();
-                        if (resume_key == 'p' || resume_key == 'P') {
-                            break;
-                        } else if (resume_key == 'q' || resume_key == 'Q') {
-                            return 0;
-                        }
-                    }
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                }
-            }
+        if (!handle_controls(presenter)) {
+            break;
         }
 #endif
 
-        if (!captureScreenGDI(frame_buffer, src_width, src_height)) {
-            std::cerr << "Error: Failed to capture screen." << std::endl;
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-            continue;
+        // Bolt: Geometry only changes here; capture, the downscaler's span tables and the
+        // frame buffers all rebuild on the first frame at the new size
+        if (poll_resize(geometry)) {
+            presenter.resize();
         }
 
-        const auto* src_data = frame_buffer.data();
-
-        // Bolt: Optimized ASCII conversion loop
-        // Reuse buffer and use lookup table for faster conversion
-        ascii_frame.clear();
-
-        // Reserve last line for status bar
-        for (int y = 0; y < CONSOLE_HEIGHT - 1; ++y) {
-            // Precompute row offset
-            const size_t row_offset = static_cast<size_t>(y) * CONSOLE_WIDTH * 4;
-
-            for (int x = 0; x < CONSOLE_WIDTH; ++x) {
-                const size_t pixel_offset = row_offset + (x * 4);
-                const unsigned char b = src_data[pixel_offset];
-                const unsigned char g = src_data[pixel_offset + 1];
-                const unsigned char r = src_data[pixel_offset + 2];
-
-                // Integer approximation of 0.2126*r + 0.7152*g + 0.0722*b using 16-bit fixed point
-                // 0.2126 * 65536 ~= 13933
-                // 0.7152 * 65536 ~= 46871
-                // 0.0722 * 65536 ~= 4732
-                const unsigned int gray = (static_cast<unsigned int>(r) * 13933 +
-                                           static_cast<unsigned int>(g) * 46871 +
-                                           static_cast<unsigned int>(b) * 4732) >> 16;
-
-                ascii_frame += gray_lookup[gray];
-            }
-            ascii_frame += '\n';
+        // The terminal hasn't caught up with the last frame; a new one would only queue behind
+        // it, so it is not drawn. The recorder and server still get every frame.
+        const bool backed_up = !presenter.drain() || pending_output() > 0;
+        if (backed_up && !recorder && !server) {
+            scheduler.frame_skipped();
+            continue;
         }
 
-        // Palette: Add status bar at the bottom
-        std::string status = " [ AsciiScreen ] Mode: " + mode + " | FPS: " + std::to_string(current_fps) + " | [P]ause [Q]uit";
-        if (status.length() < CONSOLE_WIDTH) {
-            status.append(CONSOLE_WIDTH - status.length(), ' ');
-        } else {
-            status = status.substr(0, CONSOLE_WIDTH);
+        if (!grabber.capture(frame_buffer, renderer.image_size(geometry), scaler)) {
+            std::cerr << "Error: Failed to capture screen." << std::endl;
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
         }
-        ascii_frame += status;
-        ascii_frame += '\n';
-
-        reset_cursor();
-        std::cout << ascii_frame << std::flush;
 
-        frame_count++;
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration<double>(end_time - last_fps_time);
-        if (duration.count() >= 1.0) {
-            current_fps = static_cast<int>(frame_count / duration.count());
-            frame_count = 0;
-            last_fps_time = end_time;
+        const ImageView picture = live_picture(renderer, frame_buffer, geometry);
+        const bool changed = tiles.update(picture) > 0;
+        scheduler.frame_done(tiles.dirty_fraction());
+        // The status bar moves on while the screen stands still, so it is drawn again when
+        // its text changes; with no tiles dirty, that converts only the status row
+        fps.update();
+        format_status(mode, fps.fps(), scheduler.dirty_fraction(), status);
+        const bool fresh = changed || presenter.needs_redraw() || status != shown_status;
+        if (!fresh && !(screen_behind && !backed_up)) {
+            continue;
         }
 
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-        if (elapsed < frame_duration) {
-            std::this_thread::sleep_for(frame_duration - elapsed);
+        if (fresh) {
+            render_live_frame(renderer, picture, tiles, status, ascii_frame);
+            shown_status = status;
+            if (recorder) recorder->write(ascii_frame, elapsed_us(record_start));
+            if (server) server->broadcast(ascii_frame);
+            fps.frame_drawn();
+        }
+        screen_behind = backed_up;
+        if (backed_up) {
+            scheduler.frame_skipped();
+        } else if (presenter.present(ascii_frame) > 0) {
+            scheduler.frame_partial();
         }
     }
-    return 0;
+    return finish_recording(recorder.get()) ? 0 : 1;
 }
 #else
 int main() {
-    std::cerr << "This application has been configured to use the Windows GDI API and will only run on Windows." << std::endl;
+    std::cerr << "No screen capture backend for this platform: AsciiScreen runs on Windows (GDI) and X11." << std::endl;
     return 1;
 }
 #endif
\ No newline at end of file
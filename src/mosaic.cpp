@@ -0,0 +1,71 @@
+#include "mosaic.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "color.h"
+
+void Mosaic::layout(size_t count, const Geometry& grid) {
+    grid_ = grid;
+    tiles_.clear();
+    if (count == 0) {
+        columns_ = rows_ = 0;
+        return;
+    }
+    columns_ = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+    rows_ = static_cast<int>((count + columns_ - 1) / columns_);
+    // Tiles split the cells as evenly as they divide; extra cells go to the later tiles
+    column_width_.resize(columns_);
+    row_height_.resize(rows_);
+    for (int c = 0; c < columns_; ++c) {
+        column_width_[c] = (c + 1) * grid.width / columns_ - c * grid.width / columns_;
+    }
+    for (int r = 0; r < rows_; ++r) {
+        row_height_[r] = (r + 1) * grid.height / rows_ - r * grid.height / rows_;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const int column = static_cast<int>(i % columns_);
+        const int row = static_cast<int>(i / columns_);
+        tiles_.push_back({column, row, {column_width_[column], row_height_[row]}});
+    }
+}
+
+void Mosaic::compose(const std::vector<std::string>& frames, bool colored, const std::string* status,
+                     std::string& out) {
+    static const size_t RESET_LENGTH = sizeof(ColorQuantizer::RESET_SGR) - 1;
+    out.clear();
+    line_.assign(tiles_.size(), 0);
+    size_t first = 0; // first tile of the current tile row
+    for (int r = 0; r < rows_; ++r) {
+        for (int y = 0; y < row_height_[r]; ++y) {
+            for (int c = 0; c < columns_; ++c) {
+                const size_t i = first + c;
+                const std::string* frame = i < tiles_.size() && i < frames.size() ? &frames[i] : nullptr;
+                const char* line = frame ? frame->data() + line_[i] : nullptr;
+                const char* end = line ? static_cast<const char*>(std::memchr(line, '\n', frame->size() - line_[i]))
+                                       : nullptr;
+                if (end) {
+                    // Every rendered row sets its own colors, so lines can be joined as they are
+                    out.append(line, end);
+                    line_[i] = end + 1 - frame->data();
+                    continue;
+                }
+                // Missing tile or a frame that failed: blank, in the terminal's own colors
+                if (colored) out.append(ColorQuantizer::RESET_SGR, RESET_LENGTH);
+                out.append(column_width_[c], ' ');
+            }
+            out += '\n';
+        }
+        first += columns_;
+    }
+    if (colored) out.append(ColorQuantizer::RESET_SGR, RESET_LENGTH);
+
+    if (status) {
+        // Palette: Same status bar as a single Renderer draws, across the whole grid
+        const size_t width = static_cast<size_t>(grid_.width);
+        const size_t length = status->size() < width ? status->size() : width;
+        out.append(*status, 0, length);
+        out.append(width - length, ' ');
+        out += '\n';
+    }
+}
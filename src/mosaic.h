@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "render.h"
+
+/**
+ * @brief Lays several sources out side by side on one cell grid and joins their frames.
+ *
+ * Tiles fill a grid ceil(sqrt(n)) tiles across, row by row; the last row may be short, and
+ * the space it leaves is blank. Each tile is rendered on its own by a Renderer at tile()
+ * cells, without a status line, and compose() interleaves their lines into one frame in
+ * the same layout a single Renderer produces, so it can be presented, diffed, recorded
+ * and streamed the same way.
+ */
+class Mosaic {
+public:
+    /**
+     * @brief Splits `grid` (the picture, without the status row) between `count` tiles.
+     */
+    void layout(size_t count, const Geometry& grid);
+
+    size_t size() const { return tiles_.size(); }
+    const Geometry& grid() const { return grid_; }
+
+    // Cells of tile `i`
+    const Geometry& tile(size_t i) const { return tiles_[i].cells; }
+
+    /**
+     * @brief Joins one rendered frame per tile, then `status` (padded or cut to the grid's
+     * width) on a row of its own if given.
+     * @param frames Renderer output per tile; an empty or short frame leaves its tile blank.
+     * @param colored Frames carry color escapes: the colors are reset before blank space,
+     * and once after the picture as a Renderer does.
+     */
+    void compose(const std::vector<std::string>& frames, bool colored, const std::string* status,
+                 std::string& out);
+
+private:
+    struct Tile {
+        int column;
+        int row;
+        Geometry cells;
+    };
+
+    Geometry grid_ = {0, 0};
+    int columns_ = 0;
+    int rows_ = 0;
+    std::vector<Tile> tiles_;
+    std::vector<int> column_width_;
+    std::vector<int> row_height_;
+    std::vector<size_t> line_; // scratch: where each tile's next line starts
+};
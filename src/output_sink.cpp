@@ -0,0 +1,160 @@
+#include "output_sink.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Cursor to the top-left corner; blank the screen first
+const char HOME[] = "\033[H";
+const char CLEAR_HOME[] = "\033[2J\033[H";
+
+} // namespace
+
+size_t OutputSink::write_frame(const std::string& frame) {
+    const bool clear = clear_;
+    clear_ = false;
+#ifdef _WIN32
+    if (!ansi_) {
+        // Palette: Without VT processing, position (and blank) through the console API
+        HANDLE out = static_cast<HANDLE>(handle_);
+        CONSOLE_SCREEN_BUFFER_INFO csbi;
+        if (clear && GetConsoleScreenBufferInfo(out, &csbi)) {
+            const DWORD cells = static_cast<DWORD>(csbi.dwSize.X) * csbi.dwSize.Y;
+            DWORD written = 0;
+            COORD origin = {0, 0};
+            FillConsoleOutputCharacterA(out, ' ', cells, origin, &written);
+            FillConsoleOutputAttribute(out, csbi.wAttributes, cells, origin, &written);
+        }
+        COORD origin = {0, 0};
+        SetConsoleCursorPosition(out, origin);
+        return send(nullptr, 0, frame);
+    }
+#endif
+    if (clear) return send(CLEAR_HOME, sizeof(CLEAR_HOME) - 1, frame);
+    return send(HOME, sizeof(HOME) - 1, frame);
+}
+
+size_t OutputSink::write(const std::string& text) {
+    return send(nullptr, 0, text);
+}
+
+void OutputSink::clear() {
+    clear_ = true;
+}
+
+#ifdef _WIN32
+OutputSink::OutputSink(bool) : handle_(GetStdHandle(STD_OUTPUT_HANDLE)) {
+    // Console writes complete synchronously, so there is no non-blocking mode
+    DWORD mode = 0;
+    console_ = GetConsoleMode(static_cast<HANDLE>(handle_), &mode) != 0;
+    // Redirected output gets the escapes like any other terminal stream
+    ansi_ = !console_ || (mode & ENABLE_VIRTUAL_TERMINAL_PROCESSING) ||
+            SetConsoleMode(static_cast<HANDLE>(handle_), mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+}
+
+OutputSink::~OutputSink() = default;
+
+size_t OutputSink::send(const char* prefix, size_t prefix_length, const std::string& text) {
+    // Bolt: Join the cursor escape and the frame so the console gets them in one call
+    buffer_.assign(prefix ? prefix : "", prefix_length).append(text);
+    HANDLE out = static_cast<HANDLE>(handle_);
+    DWORD written = 0;
+    if (console_) {
+        WriteConsoleA(out, buffer_.data(), static_cast<DWORD>(buffer_.size()), &written, NULL);
+    } else {
+        WriteFile(out, buffer_.data(), static_cast<DWORD>(buffer_.size()), &written, NULL);
+    }
+    return 0;
+}
+
+size_t OutputSink::flush() {
+    return 0;
+}
+#else
+OutputSink::OutputSink(bool non_blocking) {
+    // Only a terminal is worth the trouble: a pipe or file reader is not drawing frames
+    if (!non_blocking || !isatty(STDOUT_FILENO)) return;
+    // Sentinel: stdin, stdout and stderr of a terminal share one open file description, and
+    // O_NONBLOCK with it: set there, std::cerr could fail on EAGAIN and the shell would be
+    // left non-blocking if we died. Opening the terminal again gives the sink its own.
+    const char* name = ttyname(STDOUT_FILENO);
+    const int fd = open(name ? name : "/proc/self/fd/1", O_WRONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1) return; // blocking, through stdout
+    fd_ = fd;
+    non_blocking_ = true;
+}
+
+OutputSink::~OutputSink() {
+    if (fd_ == STDOUT_FILENO) return;
+    // The rest of a partly written frame goes out, waiting for the terminal if need be
+    non_blocking_ = false;
+    flush();
+    close(fd_);
+}
+
+size_t OutputSink::send(const char* prefix, size_t prefix_length, const std::string& text) {
+    if (pending() > 0) {
+        // The rest of the last frame has to go first, or the terminal would see half an escape
+        pending_.append(prefix ? prefix : "", prefix_length).append(text);
+        return flush();
+    }
+    // Bolt: One writev for the cursor escape and the frame: no copy, one system call
+    struct iovec parts[2];
+    parts[0].iov_base = const_cast<char*>(prefix ? prefix : "");
+    parts[0].iov_len = prefix_length;
+    parts[1].iov_base = const_cast<char*>(text.data());
+    parts[1].iov_len = text.size();
+    const size_t total = prefix_length + text.size();
+    ssize_t written = writev(fd_, parts, 2);
+    if (written < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return 0; // nowhere to write to
+        written = 0;
+    }
+    const size_t done = static_cast<size_t>(written);
+    if (done == total) return 0;
+
+    // Keep what the terminal didn't take, then finish it (blocking) or leave it for flush()
+    pending_.clear();
+    sent_ = 0;
+    if (done < prefix_length) pending_.append(prefix + done, prefix_length - done);
+    const size_t text_done = done > prefix_length ? done - prefix_length : 0;
+    pending_.append(text, text_done, std::string::npos);
+    return flush();
+}
+
+size_t OutputSink::flush() {
+    while (pending() > 0) {
+        const ssize_t written = ::write(fd_, pending_.data() + sent_, pending());
+        if (written > 0) {
+            sent_ += static_cast<size_t>(written);
+            continue;
+        }
+        if (written < 0 && errno == EINTR) continue;
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (non_blocking_) break;
+            // Someone else left stdout non-blocking; wait for room like a blocking write would
+            struct pollfd fd = {fd_, POLLOUT, 0};
+            poll(&fd, 1, -1);
+            continue;
+        }
+        // Sentinel: The terminal is gone; drop the frame rather than retry forever
+        sent_ = pending_.size();
+    }
+    if (pending() == 0) {
+        pending_.clear();
+        sent_ = 0;
+    }
+    return pending();
+}
+#endif
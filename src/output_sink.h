@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Sends frames to the console on stdout with one system call each.
+ *
+ * Frames go out as a single writev() of the cursor-home escape and the frame text (on
+ * Windows a single WriteConsoleA(), or WriteFile() when stdout is redirected), instead of
+ * through std::cout, whose buffering can split a frame into several writes and let the
+ * terminal draw it half old, half new.
+ *
+ * In non-blocking mode (POSIX terminals only) a write the terminal can't take at once
+ * returns right away: what it did not accept is kept and sent by flush() before anything
+ * else, so the caller can skip frames instead of blocking in write() until the terminal
+ * catches up. Frames then go through a descriptor of the sink's own on the terminal, so
+ * stdout and stderr stay blocking for everyone else.
+ */
+class OutputSink {
+public:
+    explicit OutputSink(bool non_blocking = false);
+    ~OutputSink();
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    // True if writes may be partial
+    bool non_blocking() const { return non_blocking_; }
+
+    /**
+     * @brief Writes a full frame, starting from the top-left corner (after blanking the
+     * console if clear() was called).
+     * @return Bytes the terminal has not taken yet; 0 once the frame is out.
+     */
+    size_t write_frame(const std::string& frame);
+
+    /**
+     * @brief Writes text that positions itself (e.g. ANSI runs of a diff).
+     * @return As write_frame().
+     */
+    size_t write(const std::string& text);
+
+    /**
+     * @brief Blanks the console before the next frame, e.g. so a smaller frame doesn't leave
+     * old rows behind. Sent along with that frame when the console understands escapes.
+     */
+    void clear();
+
+    /**
+     * @brief Sends more of a partially written frame.
+     * @return Bytes still pending.
+     */
+    size_t flush();
+
+    // Bytes of the last write still waiting for the terminal
+    size_t pending() const { return pending_.size() - sent_; }
+
+private:
+    // Writes `prefix` then `text` at once; keeps whatever the terminal doesn't take
+    size_t send(const char* prefix, size_t prefix_length, const std::string& text);
+
+    bool non_blocking_ = false;
+    bool clear_ = false;
+    std::string pending_; // unsent tail of the last write, from sent_ on
+    size_t sent_ = 0;
+#ifdef _WIN32
+    void* handle_;        // HANDLE of stdout
+    bool console_ = false; // stdout is a console, written with WriteConsoleA
+    bool ansi_ = false;    // the console interprets escapes
+    std::string buffer_;   // prefix and frame joined into one write
+#else
+    int fd_ = 1; // stdout, or the terminal opened non-blocking
+#endif
+};
@@ -0,0 +1,352 @@
+#include "recording.h"
+
+#include <cstring>
+
+#include "byte_stream.h"
+
+namespace {
+
+const char FILE_MAGIC[8] = {'S', 'C', 'R', 'N', 'R', 'E', 'C', '1'};
+const char INDEX_MAGIC[8] = {'S', 'C', 'R', 'N', 'I', 'D', 'X', '1'};
+const uint32_t VERSION = 1;
+const size_t HEADER_BYTES = 16;
+const size_t RECORD_HEADER_BYTES = 24;
+const size_t FOOTER_BYTES = 48;
+
+const uint32_t KEYFRAME = 'K';
+const uint32_t DELTA = 'D';
+
+// A keyframe at least this often bounds how much a seek has to decode
+const uint64_t KEYFRAME_INTERVAL_US = 2000000;
+// Seek index granularity
+const uint64_t BUCKET_WIDTH_US = 1000000;
+// Unchanged bytes needed to end a literal; shorter gaps cost more as a new token
+const size_t MIN_MATCH = 8;
+// Sentinel: Bound what a corrupt header can make the reader allocate
+const uint32_t MAX_FRAME_BYTES = 64u << 20;
+
+inline void put_u32(unsigned char* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+inline void put_u64(unsigned char* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+inline uint32_t get_u32(const unsigned char* p) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+}
+inline uint64_t get_u64(const unsigned char* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+}
+
+inline void put_varint(std::vector<unsigned char>& out, size_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<unsigned char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(v));
+}
+inline bool get_varint(const unsigned char*& p, const unsigned char* end, size_t& v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        const unsigned char b = *p++;
+        v |= static_cast<size_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief XOR/run-length encodes `cur` against `prev` (bytes past the end of `prev` count as zero).
+ */
+void encode_delta(const std::string& prev, const std::string& cur, std::vector<unsigned char>& out) {
+    out.clear();
+    const unsigned char* c = reinterpret_cast<const unsigned char*>(cur.data());
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(prev.data());
+    const size_t n = cur.size();
+    const size_t common = prev.size() < n ? prev.size() : n;
+    auto unchanged = [&](size_t i) { return c[i] == (i < common ? p[i] : 0); };
+
+    size_t i = 0;
+    while (i < n) {
+        // Bolt: Skip the unchanged bytes a word at a time; most of a frame usually is
+        const size_t run_start = i;
+        while (i + 8 <= common && memcmp(c + i, p + i, 8) == 0) i += 8;
+        while (i < n && unchanged(i)) ++i;
+        const size_t run = i - run_start;
+
+        // Literal up to the next MIN_MATCH unchanged bytes
+        const size_t literal_start = i;
+        size_t matched = 0;
+        while (i < n && matched < MIN_MATCH) {
+            matched = unchanged(i) ? matched + 1 : 0;
+            ++i;
+        }
+        i -= matched;
+
+        put_varint(out, run);
+        put_varint(out, i - literal_start);
+        for (size_t k = literal_start; k < i; ++k) {
+            out.push_back(static_cast<unsigned char>(c[k] ^ (k < common ? p[k] : 0)));
+        }
+    }
+}
+
+// Bucket b -> last keyframe at or before b * BUCKET_WIDTH_US (the first one if none is)
+std::vector<uint32_t> build_buckets(const std::vector<uint64_t>& keyframes, uint64_t duration_us) {
+    std::vector<uint32_t> buckets;
+    const size_t keyframe_count = keyframes.size() / 2;
+    if (keyframe_count == 0) return buckets;
+    const uint64_t bucket_count = duration_us / BUCKET_WIDTH_US + 1;
+    buckets.reserve(static_cast<size_t>(bucket_count));
+    uint32_t k = 0;
+    for (uint64_t b = 0; b < bucket_count; ++b) {
+        while (k + 1 < keyframe_count && keyframes[2 * (k + 1)] <= b * BUCKET_WIDTH_US) ++k;
+        buckets.push_back(k);
+    }
+    return buckets;
+}
+
+} // namespace
+
+// --- Writer ---
+
+bool RecordingWriter::open(const std::string& path, std::string& error) {
+    file_.open(path, std::ios::binary | std::ios::trunc);
+    if (!file_) {
+        error = "Cannot create recording '" + path + "'";
+        return false;
+    }
+    unsigned char header[HEADER_BYTES] = {};
+    memcpy(header, FILE_MAGIC, 8);
+    put_u32(header + 8, VERSION);
+    file_.write(reinterpret_cast<const char*>(header), HEADER_BYTES);
+    offset_ = HEADER_BYTES;
+    return static_cast<bool>(file_);
+}
+
+void RecordingWriter::write(const std::string& frame, uint64_t timestamp_us) {
+    if (!file_.is_open()) return;
+    if (timestamp_us < last_timestamp_) timestamp_us = last_timestamp_;
+
+    const bool key = frame_count_ == 0 || timestamp_us - last_keyframe_ >= KEYFRAME_INTERVAL_US;
+    if (key) {
+        encode_delta(std::string(), frame, payload_);
+        keyframes_.push_back(timestamp_us);
+        keyframes_.push_back(offset_);
+        last_keyframe_ = timestamp_us;
+    } else {
+        encode_delta(previous_, frame, payload_);
+    }
+
+    unsigned char header[RECORD_HEADER_BYTES] = {};
+    put_u32(header, key ? KEYFRAME : DELTA);
+    put_u32(header + 4, static_cast<uint32_t>(frame.size()));
+    put_u32(header + 8, static_cast<uint32_t>(payload_.size()));
+    put_u64(header + 16, timestamp_us);
+    file_.write(reinterpret_cast<const char*>(header), RECORD_HEADER_BYTES);
+    file_.write(reinterpret_cast<const char*>(payload_.data()), static_cast<std::streamsize>(payload_.size()));
+
+    offset_ += RECORD_HEADER_BYTES + payload_.size();
+    previous_ = frame;
+    last_timestamp_ = timestamp_us;
+    frame_count_++;
+}
+
+bool RecordingWriter::finish() {
+    if (!file_.is_open()) return true;
+
+    const uint64_t index_offset = offset_;
+    std::vector<unsigned char> index(keyframes_.size() * 8);
+    for (size_t i = 0; i < keyframes_.size(); ++i) put_u64(&index[i * 8], keyframes_[i]);
+    const std::vector<uint32_t> buckets = build_buckets(keyframes_, last_timestamp_);
+    const size_t bucket_start = index.size();
+    index.resize(bucket_start + buckets.size() * 4);
+    for (size_t i = 0; i < buckets.size(); ++i) put_u32(&index[bucket_start + i * 4], buckets[i]);
+    file_.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size()));
+
+    unsigned char footer[FOOTER_BYTES] = {};
+    memcpy(footer, INDEX_MAGIC, 8);
+    put_u64(footer + 8, index_offset);
+    put_u64(footer + 16, frame_count_);
+    put_u64(footer + 24, last_timestamp_);
+    put_u64(footer + 32, BUCKET_WIDTH_US);
+    put_u32(footer + 40, static_cast<uint32_t>(keyframes_.size() / 2));
+    put_u32(footer + 44, static_cast<uint32_t>(buckets.size()));
+    file_.write(reinterpret_cast<const char*>(footer), FOOTER_BYTES);
+    offset_ += index.size() + FOOTER_BYTES;
+
+    const bool ok = static_cast<bool>(file_);
+    file_.close();
+    return ok;
+}
+
+// --- Reader ---
+
+RecordingReader::RecordingReader() = default;
+RecordingReader::~RecordingReader() = default;
+
+bool RecordingReader::open(const std::string& path, std::string& error) {
+    stream_ = ByteStream::open(path, error);
+    if (!stream_) return false;
+    if (!stream_->mapped()) {
+        error = "Cannot play '" + path + "': recordings are played from a regular file";
+        return false;
+    }
+    data_ = stream_->data();
+    size_ = stream_->size();
+    if (size_ < HEADER_BYTES || memcmp(data_, FILE_MAGIC, 8) != 0) {
+        error = "'" + path + "' is not a recording";
+        return false;
+    }
+    if (get_u32(data_ + 8) != VERSION) {
+        error = "Unsupported recording version " + std::to_string(get_u32(data_ + 8));
+        return false;
+    }
+    if (!load_index()) rebuild_index();
+    if (keyframes_.empty()) {
+        error = "'" + path + "' contains no frames";
+        return false;
+    }
+    position_ = static_cast<size_t>(keyframes_[1]);
+    return true;
+}
+
+bool RecordingReader::load_index() {
+    if (size_ < HEADER_BYTES + FOOTER_BYTES) return false;
+    const unsigned char* footer = data_ + size_ - FOOTER_BYTES;
+    if (memcmp(footer, INDEX_MAGIC, 8) != 0) return false;
+
+    const uint64_t index_offset = get_u64(footer + 8);
+    const uint32_t keyframe_count = get_u32(footer + 40);
+    const uint32_t bucket_count = get_u32(footer + 44);
+    // Sentinel: The index must exactly fill the space between the records and the footer
+    if (index_offset < HEADER_BYTES || index_offset > size_ - FOOTER_BYTES ||
+        static_cast<uint64_t>(keyframe_count) * 16 + static_cast<uint64_t>(bucket_count) * 4 !=
+            size_ - FOOTER_BYTES - index_offset ||
+        get_u64(footer + 32) == 0) {
+        return false;
+    }
+
+    const unsigned char* p = data_ + index_offset;
+    keyframes_.resize(static_cast<size_t>(keyframe_count) * 2);
+    for (size_t i = 0; i < keyframes_.size(); ++i, p += 8) {
+        keyframes_[i] = get_u64(p);
+        if (i % 2 == 1 && keyframes_[i] >= index_offset) return false;
+    }
+    buckets_.resize(bucket_count);
+    for (size_t i = 0; i < buckets_.size(); ++i, p += 4) {
+        buckets_[i] = get_u32(p);
+        if (buckets_[i] >= keyframe_count) return false;
+    }
+    records_end_ = static_cast<size_t>(index_offset);
+    frame_count_ = get_u64(footer + 16);
+    duration_us_ = get_u64(footer + 24);
+    bucket_width_us_ = get_u64(footer + 32);
+    indexed_ = true;
+    return true;
+}
+
+void RecordingReader::rebuild_index() {
+    // The recorder never got to write its index (e.g. it was killed): walk the records
+    // up to the first incomplete one
+    keyframes_.clear();
+    frame_count_ = 0;
+    duration_us_ = 0;
+    size_t offset = HEADER_BYTES;
+    uint32_t type, frame_size, payload_size;
+    uint64_t timestamp;
+    while (read_record(offset, type, frame_size, payload_size, timestamp)) {
+        if (type == KEYFRAME) {
+            keyframes_.push_back(timestamp);
+            keyframes_.push_back(offset);
+        }
+        offset += RECORD_HEADER_BYTES + payload_size;
+        frame_count_++;
+        duration_us_ = timestamp;
+    }
+    records_end_ = offset;
+    bucket_width_us_ = BUCKET_WIDTH_US;
+    buckets_ = build_buckets(keyframes_, duration_us_);
+    indexed_ = false;
+}
+
+bool RecordingReader::read_record(size_t offset, uint32_t& type, uint32_t& frame_size, uint32_t& payload_size,
+                                  uint64_t& timestamp) const {
+    if (offset > size_ || size_ - offset < RECORD_HEADER_BYTES) return false;
+    const unsigned char* p = data_ + offset;
+    type = get_u32(p);
+    frame_size = get_u32(p + 4);
+    payload_size = get_u32(p + 8);
+    timestamp = get_u64(p + 16);
+    return (type == KEYFRAME || type == DELTA) && frame_size <= MAX_FRAME_BYTES &&
+           payload_size <= size_ - offset - RECORD_HEADER_BYTES;
+}
+
+bool RecordingReader::decode(size_t offset) {
+    uint32_t type, frame_size, payload_size;
+    uint64_t timestamp;
+    if (offset >= records_end_ || !read_record(offset, type, frame_size, payload_size, timestamp)) {
+        error_ = "Corrupt record at byte " + std::to_string(offset);
+        return false;
+    }
+    if (type == KEYFRAME) {
+        frame_.assign(frame_size, '\0');
+    } else {
+        // Bytes past the end of the previous frame are XORed against zero
+        frame_.resize(frame_size);
+    }
+
+    const unsigned char* p = data_ + offset + RECORD_HEADER_BYTES;
+    const unsigned char* const end = p + payload_size;
+    size_t pos = 0;
+    while (p < end) {
+        size_t run, literal;
+        if (!get_varint(p, end, run) || !get_varint(p, end, literal) || run > frame_size - pos ||
+            literal > frame_size - pos - run || literal > static_cast<size_t>(end - p)) {
+            error_ = "Corrupt delta at byte " + std::to_string(offset);
+            return false;
+        }
+        pos += run;
+        for (size_t k = 0; k < literal; ++k) frame_[pos + k] ^= static_cast<char>(p[k]);
+        pos += literal;
+        p += literal;
+    }
+
+    position_ = offset + RECORD_HEADER_BYTES + payload_size;
+    timestamp_ = timestamp;
+    return true;
+}
+
+bool RecordingReader::next(const std::string*& frame, uint64_t& timestamp_us) {
+    if (pending_) {
+        pending_ = false;
+    } else if (position_ >= records_end_ || !decode(position_)) {
+        return false;
+    }
+    frame = &frame_;
+    timestamp_us = timestamp_;
+    return true;
+}
+
+void RecordingReader::seek(uint64_t timestamp_us) {
+    pending_ = false;
+    if (buckets_.empty()) return;
+
+    // Bolt: Constant-time lookup of the keyframe to start from, then decode forward
+    uint64_t bucket = timestamp_us / bucket_width_us_;
+    if (bucket >= buckets_.size()) bucket = buckets_.size() - 1;
+    if (!decode(static_cast<size_t>(keyframes_[2 * buckets_[bucket] + 1]))) return;
+
+    uint32_t type, frame_size, payload_size;
+    uint64_t next_timestamp;
+    while (position_ < records_end_ &&
+           read_record(position_, type, frame_size, payload_size, next_timestamp) &&
+           next_timestamp <= timestamp_us) {
+        if (!decode(position_)) return;
+    }
+    pending_ = true;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ByteStream;
+
+/*
+ * Recording container (all integers little-endian):
+ *
+ *   header   "SCRNREC1", u32 version, u32 reserved
+ *   records  u32 type ('K' keyframe / 'D' delta), u32 frame size, u32 payload size,
+ *            u32 reserved, u64 timestamp (us since the first frame), payload
+ *   index    keyframes as {u64 timestamp, u64 record offset},
+ *            then one u32 keyframe number per time bucket
+ *   footer   "SCRNIDX1", u64 index offset, u64 frame count, u64 duration (us),
+ *            u64 bucket width (us), u32 keyframe count, u32 bucket count
+ *
+ * A payload is the frame XORed with the previous one (with nothing for a keyframe),
+ * stored as repeated {varint unchanged bytes, varint literal bytes, literal XOR bytes}.
+ * Bucket i names the last keyframe at or before i * bucket width, so seeking is a
+ * division, one table load, and at most one keyframe interval of deltas to decode.
+ */
+
+/**
+ * @brief Writes frames to a recording file.
+ * The index and footer are written by finish() (or the destructor); a file cut short
+ * without them can still be played, it just needs a scan to rebuild its index.
+ */
+class RecordingWriter {
+public:
+    RecordingWriter() = default;
+    ~RecordingWriter() { finish(); }
+    RecordingWriter(const RecordingWriter&) = delete;
+    RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+    /**
+     * @brief Creates `path` and writes the header. @return False with `error` set on failure.
+     */
+    bool open(const std::string& path, std::string& error);
+
+    /**
+     * @brief Appends a frame shown at `timestamp_us` (microseconds, non-decreasing).
+     */
+    void write(const std::string& frame, uint64_t timestamp_us);
+
+    /**
+     * @brief Writes the seek index and footer and closes the file. @return False on a write error.
+     */
+    bool finish();
+
+    uint64_t frame_count() const { return frame_count_; }
+    uint64_t bytes_written() const { return offset_; }
+
+private:
+    std::ofstream file_;
+    std::string previous_;
+    std::vector<unsigned char> payload_;
+    uint64_t offset_ = 0;
+    uint64_t frame_count_ = 0;
+    uint64_t last_timestamp_ = 0;
+    uint64_t last_keyframe_ = 0;
+    // {timestamp, offset} of every keyframe
+    std::vector<uint64_t> keyframes_;
+};
+
+/**
+ * @brief Reads a recording through a memory map, with constant-time seeking.
+ */
+class RecordingReader {
+public:
+    RecordingReader();
+    ~RecordingReader();
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    /**
+     * @brief Maps `path` and loads its index (rebuilding it if the file was cut short).
+     * @return False with `error` set if the file is not a readable recording.
+     */
+    bool open(const std::string& path, std::string& error);
+
+    uint64_t frame_count() const { return frame_count_; }
+    uint64_t duration_us() const { return duration_us_; }
+    // False when the footer was missing and the index had to be rebuilt
+    bool indexed() const { return indexed_; }
+
+    /**
+     * @brief Decodes the next frame.
+     * @param frame Points to the decoded frame, valid until the next call.
+     * @return False at the end of the recording (or at a corrupt record; see error()).
+     */
+    bool next(const std::string*& frame, uint64_t& timestamp_us);
+
+    /**
+     * @brief Positions playback on the last frame at or before `timestamp_us`.
+     * That frame is returned by the next call to next().
+     */
+    void seek(uint64_t timestamp_us);
+
+    const std::string& error() const { return error_; }
+
+private:
+    bool load_index();
+    void rebuild_index();
+    bool read_record(size_t offset, uint32_t& type, uint32_t& frame_size, uint32_t& payload_size,
+                     uint64_t& timestamp) const;
+    bool decode(size_t offset);
+
+    std::unique_ptr<ByteStream> stream_;
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t records_end_ = 0; // records occupy [header, records_end_)
+
+    std::vector<uint64_t> keyframes_; // {timestamp, offset} pairs
+    std::vector<uint32_t> buckets_;
+    uint64_t bucket_width_us_ = 0;
+    uint64_t frame_count_ = 0;
+    uint64_t duration_us_ = 0;
+    bool indexed_ = false;
+
+    size_t position_ = 0; // offset of the next record to decode
+    std::string frame_;
+    uint64_t timestamp_ = 0;
+    bool pending_ = false; // seek() decoded the frame next() should return
+    std::string error_;
+};
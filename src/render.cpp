@@ -0,0 +1,552 @@
+#include "render.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "thread_pool.h"
+
+// Sentinel: A malformed or oversized built-in ramp fails the build rather than the first frame
+constexpr bool ramps_valid() {
+    for (const AsciiRamp& ramp : ASCII_RAMPS) {
+        if (ramp.size == 0 || ramp.size > 256) return false;
+    }
+    return true;
+}
+static_assert(ramps_valid(), "every built-in ramp must be 1 to 256 glyphs of valid UTF-8");
+
+const AsciiRamp* find_ramp(const std::string& name) {
+    for (const AsciiRamp& ramp : ASCII_RAMPS) {
+        if (name == ramp.name) return &ramp;
+    }
+    return nullptr;
+}
+
+// Returns true if the ramp contains any non-ASCII (Unicode) characters
+bool ramp_has_unicode(const std::string& ramp) {
+    for (unsigned char c : ramp) {
+        if (c > 127) return true;
+    }
+    return false;
+}
+
+bool parse_cell_mode(const char* name, CellMode& mode) {
+    if (std::strcmp(name, "ramp") == 0) {
+        mode = CellMode::Ramp;
+    } else if (std::strcmp(name, "shapes") == 0) {
+        mode = CellMode::Shape;
+    } else if (std::strcmp(name, "braille") == 0) {
+        mode = CellMode::Braille;
+    } else if (std::strcmp(name, "halfblock") == 0) {
+        mode = CellMode::HalfBlock;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+/**
+ * @brief Glyphs by pixel pattern for the sub-cell modes, as a 256-glyph ramp (so a
+ * GlyphTable maps each pattern to its own glyph); other modes keep `ramp`.
+ */
+std::string cell_glyphs(const std::string& ramp, CellMode cells) {
+    if (cells != CellMode::Braille && cells != CellMode::HalfBlock) return ramp;
+    // Half blocks: bit 0 inks the top half, bit 1 the bottom one
+    static const uint32_t HALF_BLOCKS[4] = {' ', 0x2580, 0x2584, 0x2588};
+    std::string glyphs;
+    for (uint32_t pattern = 0; pattern < 256; ++pattern) {
+        char bytes[GlyphTable::MAX_GLYPH_BYTES];
+        const uint32_t cp = cells == CellMode::Braille ? 0x2800 + pattern : HALF_BLOCKS[pattern & 3];
+        glyphs.append(bytes, encode_glyph(cp, GlyphEncoding::Utf8, bytes));
+    }
+    return glyphs;
+}
+
+} // namespace
+
+Renderer::Renderer(const std::string& ramp, GlyphEncoding encoding, ColorMode color, ColorLayer layer,
+                   CellMode cells)
+    : glyphs_(cell_glyphs(ramp, cells), encoding),
+      cell_mode_(cells),
+      scratch_(1) {
+    // Bolt: Pick every format's kernels up front; a frame then only indexes the table
+    for (int format = 0; format < PIXEL_FORMATS; ++format) {
+        const PixelFormat pixel_format = static_cast<PixelFormat>(format);
+        ascii_rows_[format] = select_ascii_row_kernel(pixel_format == PixelFormat::Bgra ? &kernel_name_ : nullptr, pixel_format);
+        luma_rows_[format] = select_luma_row_kernel(nullptr, pixel_format);
+    }
+    // Bolt: Build the color cube once; a cell's color is then a single table lookup
+    if (color != ColorMode::Mono) {
+        if (cells == CellMode::HalfBlock) {
+            // Two colors per cell: the glyph's and the background's
+            color_ = std::make_shared<ColorQuantizer>(color, ColorLayer::Foreground);
+            back_color_ = std::make_shared<ColorQuantizer>(color, ColorLayer::Background);
+        } else {
+            color_ = std::make_shared<ColorQuantizer>(color, layer);
+        }
+    }
+    switch (cells) {
+    case CellMode::Shape:
+        shapes_ = std::make_shared<ShapeTable>();
+        cell_width_ = ShapeTable::SAMPLE_WIDTH;
+        cell_height_ = ShapeTable::SAMPLE_HEIGHT;
+        break;
+    case CellMode::Braille:
+        braille_row_ = select_braille_row_kernel();
+        cell_width_ = 2;
+        cell_height_ = 4;
+        break;
+    case CellMode::HalfBlock:
+        cell_height_ = 2;
+        break;
+    default:
+        break;
+    }
+}
+
+void Renderer::set_dither(DitherMode mode, ThreadPool* pool) {
+    if (shapes_ || back_color_) mode = DitherMode::Off;
+    // The dot modes dither between two levels: ink and paper
+    const bool dots = cell_mode_ == CellMode::Braille || cell_mode_ == CellMode::HalfBlock;
+    dither_ = Ditherer(mode, dots ? 2 : glyphs_.size(), pool);
+    band_text_.clear();
+    apply_levels();
+}
+
+void Renderer::set_tone(ToneMode mode, bool calibrate) {
+    // Colored half blocks are drawn in colors only; they have no levels to map
+    if (back_color_) {
+        mode = ToneMode::Off;
+        calibrate = false;
+    }
+    tone_ = ToneCurve(mode);
+    calibrated_ = calibrate;
+    band_levels_.clear();
+    band_text_.clear();
+    apply_levels();
+}
+
+void Renderer::apply_levels() {
+    const LevelTable& curve = tone_.curve();
+    if (cell_mode_ == CellMode::Braille || cell_mode_ == CellMode::HalfBlock) {
+        // Ink is what the curve takes below the threshold; the curve never falls, so that is
+        // everything below the first level it takes to or above it
+        int threshold = 0;
+        while (threshold < 255 && curve[threshold] < DOT_THRESHOLD) ++threshold;
+        threshold_ = static_cast<unsigned char>(threshold);
+        return;
+    }
+    // Dithering assumes evenly spaced glyphs; it gets the curve through its luma instead
+    const bool dithered = dither_.mode() != DitherMode::Off;
+    const std::vector<uint32_t>& glyphs = glyphs_.codepoints();
+    const LevelTable ramp = calibrated_ && !dithered ? ink_levels(glyphs) : linear_levels(glyphs.size());
+    if (dithered || tone_.mode() == ToneMode::Off) {
+        glyphs_.set_levels(ramp);
+        return;
+    }
+    // Bolt: Fold the curve into the glyph table, so stretching costs nothing per cell
+    LevelTable levels;
+    for (int v = 0; v < 256; ++v) levels[v] = ramp[curve[v]];
+    glyphs_.set_levels(levels);
+}
+
+void Renderer::count_band(int band, RowScratch& scratch) {
+    if (tone_.mode() == ToneMode::Off) return;
+    fold_levels(scratch.levels.data(), &band_levels_[static_cast<size_t>(band) * LEVEL_BINS]);
+}
+
+void Renderer::retone() {
+    if (tone_.update(frame_levels_.data())) {
+        apply_levels();
+        // Every band kept was converted with the old levels
+        band_text_.clear();
+    }
+}
+
+void Renderer::set_pool(ThreadPool* pool) {
+    pool_ = pool;
+    scratch_.resize(pool ? pool->size() : 1);
+}
+
+size_t Renderer::row_bytes(size_t cells) const {
+    if (back_color_) {
+        // A foreground and a background escape before every cell
+        return cells * (2 * ColorQuantizer::MAX_SGR_BYTES + glyphs_.max_width()) + GlyphTable::ROW_SLACK + 1;
+    }
+    if (color_) {
+        // Room for an escape before every cell; runs of one color share a single escape so
+        // typical rows stay far below that
+        return ColorQuantizer::row_capacity(glyphs_, cells) + 1;
+    }
+    return glyphs_.row_capacity(cells) + 1;
+}
+
+size_t Renderer::max_frame_bytes(int width, int height, bool status_line) const {
+    if (width < cell_width_ || height < cell_height_) return 0;
+    const size_t cells = static_cast<size_t>(width / cell_width_);
+    const size_t rows = static_cast<size_t>(height / cell_height_);
+    size_t bytes = row_bytes(cells) * rows;
+    if (color_) bytes += sizeof(ColorQuantizer::RESET_SGR);
+    return status_line ? bytes + cells + 1 : bytes;
+}
+
+char* Renderer::write_shape_cells(const RowScratch& scratch, size_t begin, size_t end, char* out) const {
+    // Shape glyphs are ASCII; flat cells take the ramp glyph for their brightness
+    for (size_t x = begin; x < end; ++x) {
+        if (scratch.shape_row[x]) {
+            *out++ = scratch.shape_row[x];
+        } else {
+            out = glyphs_.write_glyph(scratch.gray_row[x], out);
+        }
+    }
+    return out;
+}
+
+template <PixelFormat F>
+char* Renderer::write_half_blocks(const unsigned char* top, const unsigned char* bottom, size_t count,
+                                  char* out) const {
+    // Every cell is an upper half block over its background, so the two colors change
+    // independently; each escape is only sent when its own color changes
+    const unsigned char UPPER_HALF = 1;
+    uint32_t fg = UINT32_MAX;
+    uint32_t bg = UINT32_MAX;
+    for (size_t x = 0; x < count; ++x) {
+        const uint16_t top_key = color_->key<F>(top + x * PixelLayout<F>::BYTES);
+        const uint16_t bottom_key = back_color_->key<F>(bottom + x * PixelLayout<F>::BYTES);
+        if (top_key != fg) {
+            out = color_->write_sgr(top_key, out);
+            fg = top_key;
+        }
+        if (bottom_key != bg) {
+            out = back_color_->write_sgr(bottom_key, out);
+            bg = bottom_key;
+        }
+        out = glyphs_.write_glyph(UPPER_HALF, out);
+    }
+    return out;
+}
+
+template <PixelFormat F>
+void Renderer::average_cells(const ImageView& image, int y, int width, RowScratch& scratch) const {
+    // Each cell is colored with the mean of its pixels
+    using Layout = PixelLayout<F>;
+    std::vector<unsigned char>& cell_color = scratch.cell_color;
+    if (cell_color.size() < static_cast<size_t>(width) * 4) cell_color.resize(width * 4);
+    const int count = cell_width_ * cell_height_;
+    for (int x = 0; x < width; ++x) {
+        int sum[3] = {};
+        for (int sy = 0; sy < cell_height_; ++sy) {
+            const unsigned char* p = image.row(y * cell_height_ + sy) + x * cell_width_ * Layout::BYTES;
+            for (int sx = 0; sx < cell_width_; ++sx, p += Layout::BYTES) {
+                sum[0] += p[Layout::BLUE];
+                sum[1] += p[Layout::GREEN];
+                sum[2] += p[Layout::RED];
+            }
+        }
+        for (int c = 0; c < 3; ++c) cell_color[x * 4 + c] = static_cast<unsigned char>(sum[c] / count);
+    }
+}
+
+size_t Renderer::render(const ImageView& image, char* out, size_t capacity, const std::string* status) {
+    return render_frame(image, nullptr, out, capacity, status);
+}
+
+size_t Renderer::render(const ImageView& image, const TileHasher& tiles, char* out, size_t capacity,
+                        const std::string* status) {
+    return render_frame(image, &tiles, out, capacity, status);
+}
+
+void Renderer::dither_rows(const ImageView& image, int row_begin, int row_end, RowScratch& scratch) {
+    const size_t samples = static_cast<size_t>(image.width / cell_width_) * cell_width_;
+    const LumaRowFn luma_row = luma_rows_[static_cast<int>(image.format)];
+    const bool toned = tone_.mode() != ToneMode::Off;
+    const LevelTable& curve = tone_.curve();
+    for (int y = row_begin; y < row_end; ++y) {
+        unsigned char* gray = dither_.row(y);
+        luma_row(image.row(y), samples, gray);
+        if (toned) {
+            // Count the captured levels, then stretch them while the row is still in cache
+            count_levels(gray, samples, scratch.levels.data());
+            for (size_t x = 0; x < samples; ++x) gray[x] = curve[gray[x]];
+        }
+    }
+    dither_.apply(row_begin, row_end);
+}
+
+char* Renderer::render_rows(const ImageView& image, int y_begin, int y_end, char* out, RowScratch& scratch) {
+    switch (image.format) {
+    case PixelFormat::Rgba:
+        return convert_rows<PixelFormat::Rgba>(image, y_begin, y_end, out, scratch);
+    case PixelFormat::Rgb24:
+        return convert_rows<PixelFormat::Rgb24>(image, y_begin, y_end, out, scratch);
+    case PixelFormat::Gray8:
+        return convert_rows<PixelFormat::Gray8>(image, y_begin, y_end, out, scratch);
+    default:
+        return convert_rows<PixelFormat::Bgra>(image, y_begin, y_end, out, scratch);
+    }
+}
+
+template <PixelFormat F>
+char* Renderer::convert_rows(const ImageView& image, int y_begin, int y_end, char* out, RowScratch& scratch) {
+    const AsciiRowFn ascii_row = ascii_rows_[static_cast<int>(F)];
+    const LumaRowFn luma_row = luma_rows_[static_cast<int>(F)];
+    const int width = image.width / cell_width_;
+    std::vector<unsigned char>& gray_row = scratch.gray_row;
+    std::vector<unsigned char>& sample_luma = scratch.sample_luma;
+    const size_t samples = static_cast<size_t>(width) * cell_width_;
+    // Sample rows of the current cell row; no mode samples more than 4 rows per cell
+    static_assert(ShapeTable::SAMPLE_HEIGHT <= 4, "luma rows");
+    const unsigned char* luma[4] = {};
+    if (cell_mode_ != CellMode::Ramp) {
+        if (sample_luma.size() < samples * cell_height_) sample_luma.resize(samples * cell_height_);
+        for (int sy = 0; sy < cell_height_; ++sy) luma[sy] = &sample_luma[sy * samples];
+    }
+    // Dithered rows were converted to luma, and counted, by dither_rows() already
+    const bool dithered = dither_.mode() != DitherMode::Off;
+    // The band's luma histogram, counted from whatever luma each mode produces anyway
+    uint32_t* const histogram = tone_.mode() != ToneMode::Off && !dithered ? scratch.levels.data() : nullptr;
+    // Luma of the pixel rows under cell row `y`
+    auto sample_rows = [&](int y) {
+        for (int sy = 0; sy < cell_height_; ++sy) {
+            if (dithered) {
+                luma[sy] = dither_.row(y * cell_height_ + sy);
+            } else {
+                luma_row(image.row(y * cell_height_ + sy), samples, &sample_luma[sy * samples]);
+            }
+        }
+    };
+
+    if (shapes_) {
+        if (scratch.shape_row.size() < static_cast<size_t>(width)) scratch.shape_row.resize(width);
+        for (int y = y_begin; y < y_end; ++y) {
+            sample_rows(y);
+            shapes_->classify_row(luma, width, gray_row.data(), scratch.shape_row.data());
+            if (histogram) count_levels(gray_row.data(), width, histogram);
+            if (color_) {
+                average_cells<F>(image, y, width, scratch);
+                out = color_->write_runs(
+                    scratch.cell_color.data(), width,
+                    [&](size_t b, size_t e, char* o) { return write_shape_cells(scratch, b, e, o); }, out);
+            } else {
+                out = write_shape_cells(scratch, 0, width, out);
+            }
+            *out++ = '\n';
+        }
+    } else if (back_color_) {
+        for (int y = y_begin; y < y_end; ++y) {
+            out = write_half_blocks<F>(image.row(2 * y), image.row(2 * y + 1), width, out);
+            *out++ = '\n';
+        }
+    } else if (cell_mode_ == CellMode::Braille || cell_mode_ == CellMode::HalfBlock) {
+        // Bolt: Threshold and pack each cell's pixels into a pattern, which indexes
+        // pre-encoded glyphs like a gray level does. Dithered samples are either ink or paper
+        // after the lookup's floor, i.e. ink below 255
+        const unsigned char threshold = dithered ? 255 : threshold_;
+        for (int y = y_begin; y < y_end; ++y) {
+            sample_rows(y);
+            for (int sy = 0; histogram && sy < cell_height_; ++sy) count_levels(luma[sy], samples, histogram);
+            if (braille_row_) {
+                braille_row_(luma, width, threshold, gray_row.data());
+            } else {
+                for (int x = 0; x < width; ++x) {
+                    gray_row[x] = static_cast<unsigned char>((luma[0][x] < threshold) |
+                                                              (luma[1][x] < threshold) << 1);
+                }
+            }
+            if (color_) {
+                average_cells<F>(image, y, width, scratch);
+                out = color_->write_row(scratch.cell_color.data(), gray_row.data(), width, glyphs_, out);
+            } else {
+                out = glyphs_.write_row(gray_row.data(), width, out);
+            }
+            *out++ = '\n';
+        }
+    } else if (dithered) {
+        // The plane already holds each cell's dithered level; only the lookup is left
+        for (int y = y_begin; y < y_end; ++y) {
+            const unsigned char* gray = dither_.row(y);
+            if (color_) {
+                out = color_->write_row<F>(image.row(y), gray, width, glyphs_, out);
+            } else if (glyphs_.single_byte()) {
+                const char* lut = glyphs_.ascii_lut();
+                for (int x = 0; x < width; ++x) out[x] = lut[gray[x]];
+                out += width;
+            } else {
+                out = glyphs_.write_row(gray, width, out);
+            }
+            *out++ = '\n';
+        }
+    } else if (color_) {
+        for (int y = y_begin; y < y_end; ++y) {
+            const unsigned char* src_row = image.row(y);
+            luma_row(src_row, width, gray_row.data());
+            if (histogram) count_levels(gray_row.data(), width, histogram);
+            out = color_->write_row<F>(src_row, gray_row.data(), width, glyphs_, out);
+            *out++ = '\n';
+        }
+    } else if (glyphs_.single_byte()) {
+        // Bolt: Let the kernel write each row in place
+        for (int y = y_begin; y < y_end; ++y) {
+            ascii_row(image.row(y), width, glyphs_.ascii_lut(), out, histogram);
+            out[width] = '\n';
+            out += width + 1;
+        }
+    } else {
+        // Bolt: Fixed-size glyph copies into room for the widest glyph, advancing by what was
+        // actually written
+        for (int y = y_begin; y < y_end; ++y) {
+            luma_row(image.row(y), width, gray_row.data());
+            if (histogram) count_levels(gray_row.data(), width, histogram);
+            out = glyphs_.write_row(gray_row.data(), width, out);
+            *out++ = '\n';
+        }
+    }
+    return out;
+}
+
+void Renderer::render_bands(const ImageView& image, int band_rows, bool keep, char* out) {
+    const int height = image.height / cell_height_;
+    const size_t slot_bytes = row_bytes(static_cast<size_t>(image.width / cell_width_));
+    band_bytes_.resize((height + band_rows - 1) / band_rows);
+    // Bolt: Each band has a slot sized for its worst case at a fixed offset, so threads write
+    // their text in place without waiting on the bands before them. Bands cost more or less
+    // depending on the picture (color runs, flat shapes), so threads steal from each other
+    pool_->parallel_steal(dirty_.size(), [&](size_t item, size_t, size_t worker) {
+        const int band = dirty_[item];
+        const int y_begin = band * band_rows;
+        const int y_end = y_begin + band_rows < height ? y_begin + band_rows : height;
+        RowScratch& scratch = scratch_[worker];
+        if (dither_.mode() == DitherMode::Bayer) {
+            dither_rows(image, y_begin * cell_height_, y_end * cell_height_, scratch);
+        }
+        char* const slot = out + y_begin * slot_bytes;
+        char* const end = render_rows(image, y_begin, y_end, slot, scratch);
+        count_band(band, scratch);
+        band_bytes_[band] = static_cast<size_t>(end - slot);
+        if (keep) band_text_[band].assign(slot, end);
+    });
+}
+
+size_t Renderer::render_frame(const ImageView& image, const TileHasher* tiles, char* out, size_t capacity,
+                              const std::string* status) {
+    const size_t required = max_frame_bytes(image.width, image.height, status != nullptr);
+    // Sentinel: Refuse rather than overrun a buffer sized for a smaller frame
+    if (required == 0 || capacity < required) return 0;
+
+    const int width = image.width / cell_width_;
+    const int height = image.height / cell_height_;
+    char* const begin = out;
+    const bool toned = tone_.mode() != ToneMode::Off;
+    for (RowScratch& scratch : scratch_) {
+        if (scratch.gray_row.size() < static_cast<size_t>(width)) scratch.gray_row.resize(width);
+        if (toned && scratch.levels.empty()) scratch.levels.resize(LEVEL_HISTOGRAMS * LEVEL_BINS);
+    }
+    if (dither_.mode() != DitherMode::Off) dither_.resize(width * cell_width_, height * cell_height_);
+    // Error diffusion crosses cell rows, so it needs the whole frame's luma up front, and a
+    // change anywhere can reach every row below it
+    const bool diffused = dither_.mode() == DitherMode::FloydSteinberg;
+    if (toned) frame_levels_.resize(LEVEL_BINS);
+    if (diffused) {
+        dither_rows(image, 0, height * cell_height_, scratch_[0]);
+        // Every band is converted again anyway, so the whole frame's counts go straight in
+        if (toned) fold_levels(scratch_[0].levels.data(), frame_levels_.data());
+    }
+
+    // Bolt: Convert in bands one row of tiles high. A band whose tiles all hashed the same
+    // as in the last frame copies the text it produced then instead of converting again
+    static_assert(TileHasher::TILE_HEIGHT % 8 == 0, "bands must hold whole cell rows and Bayer periods");
+    const int band_rows = TileHasher::TILE_HEIGHT / cell_height_;
+    const int bands = (height + band_rows - 1) / band_rows;
+    const bool keep = tiles && !diffused;
+    const bool reuse = keep && tiles->width() == image.width && tiles->height() == image.height &&
+                       band_text_.size() == static_cast<size_t>(bands) && band_width_ == width;
+    if (keep) {
+        band_text_.resize(bands);
+        band_width_ = width;
+    } else {
+        band_text_.clear();
+    }
+    if (toned && band_levels_.size() != static_cast<size_t>(bands) * LEVEL_BINS) {
+        band_levels_.assign(static_cast<size_t>(bands) * LEVEL_BINS, 0);
+    }
+    dirty_.clear();
+    for (int band = 0; band < bands; ++band) {
+        if (!reuse || tiles->row_dirty(band)) dirty_.push_back(band);
+    }
+    // Bolt: Spread the bands over the pool when there is enough to convert to pay for the
+    // wake-up; small frames and frames where little changed stay on this thread
+    const size_t slot_bytes = row_bytes(static_cast<size_t>(width));
+    const size_t row_work = static_cast<size_t>(image.width) * cell_height_ + slot_bytes;
+    const bool parallel = pool_ && pool_->size() > 1 && dirty_.size() > 1 &&
+                          dirty_.size() * band_rows * row_work >= PARALLEL_MIN_WORK;
+    if (parallel) render_bands(image, band_rows, keep, out);
+
+    size_t next_dirty = 0;
+    for (int band = 0; band < bands; ++band) {
+        const int y_begin = band * band_rows;
+        const int y_end = y_begin + band_rows < height ? y_begin + band_rows : height;
+        if (next_dirty == dirty_.size() || dirty_[next_dirty] != band) {
+            const std::string& text = band_text_[band];
+            std::memcpy(out, text.data(), text.size());
+            out += text.size();
+            continue;
+        }
+        ++next_dirty;
+        if (parallel) {
+            // Pull the band's text down from its slot; every band before it took no more than
+            // its own slot, so this never overwrites text still to be moved
+            std::memmove(out, begin + y_begin * slot_bytes, band_bytes_[band]);
+            out += band_bytes_[band];
+            continue;
+        }
+        // Bands start on a multiple of TILE_HEIGHT pixel rows, so the Bayer matrix lines up
+        if (dither_.mode() == DitherMode::Bayer) {
+            dither_rows(image, y_begin * cell_height_, y_end * cell_height_, scratch_[0]);
+        }
+        char* const band_begin = out;
+        out = render_rows(image, y_begin, y_end, out, scratch_[0]);
+        count_band(band, scratch_[0]);
+        if (keep) band_text_[band].assign(band_begin, out);
+    }
+    if (toned) {
+        if (!diffused) {
+            // Bands that didn't change still hold the counts of their last conversion
+            std::fill(frame_levels_.begin(), frame_levels_.end(), 0);
+            for (int band = 0; band < bands; ++band) {
+                const uint32_t* counts = &band_levels_[static_cast<size_t>(band) * LEVEL_BINS];
+                for (size_t v = 0; v < LEVEL_BINS; ++v) frame_levels_[v] += counts[v];
+            }
+        }
+        retone();
+    }
+    if (color_) {
+        // The status bar is drawn in the terminal's own colors
+        std::memcpy(out, ColorQuantizer::RESET_SGR, sizeof(ColorQuantizer::RESET_SGR) - 1);
+        out += sizeof(ColorQuantizer::RESET_SGR) - 1;
+    }
+
+    if (status) {
+        // Palette: Status bar at the bottom, exactly one row wide
+        const size_t status_width = static_cast<size_t>(width);
+        const size_t length = status->size() < status_width ? status->size() : status_width;
+        std::memcpy(out, status->data(), length);
+        std::memset(out + length, ' ', status_width - length);
+        out += status_width;
+        *out++ = '\n';
+    }
+    return static_cast<size_t>(out - begin);
+}
+
+void Renderer::render(const ImageView& image, std::string& out, const std::string* status) {
+    // Bolt: Size for the worst case, then trim to what was written (resizing within the
+    // capacity never reallocates)
+    out.resize(max_frame_bytes(image.width, image.height, status != nullptr));
+    out.resize(out.empty() ? 0 : render(image, &out[0], out.size(), status));
+}
+
+void Renderer::render(const ImageView& image, const TileHasher& tiles, std::string& out, const std::string* status) {
+    out.resize(max_frame_bytes(image.width, image.height, status != nullptr));
+    out.resize(out.empty() ? 0 : render(image, tiles, &out[0], out.size(), status));
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "color.h"
+#include "dither.h"
+#include "glyph_table.h"
+#include "image_view.h"
+#include "luma_kernels.h"
+#include "shape_table.h"
+#include "tile_hash.h"
+#include "tone.h"
+
+// A built-in character ramp, darkest glyph first
+struct AsciiRamp {
+    const char* name;
+    const char* glyphs; // UTF-8
+    size_t size;        // glyphs in the ramp; 0 if `glyphs` is not valid UTF-8
+
+    constexpr AsciiRamp(const char* ramp_name, const char* ramp_glyphs)
+        : name(ramp_name), glyphs(ramp_glyphs), size(utf8_glyph_count(ramp_glyphs)) {}
+};
+
+// The modes and their ramps, by name; built at compile time
+inline constexpr AsciiRamp ASCII_RAMPS[] = {
+    {"alphabetic", "ABCDEFGHIJKLMNOPQRSTUVWXYZ"},
+    {"alphanumeric", "ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890abcdefghijklmnopqrstuvwxyz"},
+    {"arrow", "↑↗→↘↓↙←↖"},
+    {"blockelement", "█"},
+    {"codepage437", "█▓▒░"},
+    {"extended", "@%#{}[]()<>^*+=~-:."},
+    {"grayscale", "@$BWM#*oahkbdpwmZO0QCJYXzcvnxrjft/|()1{}[]-_+~<>i!lI;:,\"^`'."},
+    //{"max", "\xc6\xd1\xcaŒ\xd8M\xc9\xcb\xc8\xc3\xc2WQB\xc5\xe6#N\xc1\xfeE\xc4\xc0HKRŽœXg\xd0\xeaq\xdbŠ\xd5\xd4A€\xdfpm\xe3\xe2G\xb6\xf8\xf0\xe98\xda\xdc$\xebd\xd9\xfd\xe8\xd3\xde\xd6\xe5\xff\xd2b\xa5FD\xf1\xe1ZP\xe4š\xc7\xe0h\xfb\xa7\xddkŸ\xaeS9žUTe6\xb5Oyx\xce\xbef4\xf55\xf4\xfa&a\xfc™2\xf9\xe7w\xa9Y\xa30V\xcdL\xb13\xcf\xcc\xf3C@n\xf6\xf2s\xa2u‰\xbd\xbc‡zJƒ%\xa4Itoc\xeerjv1l\xed=\xef\xec<>i7†[\xbf?\xd7}*{+()/\xbb\xab•\xac|!\xa1\xf7\xa6\xaf—^\xaa„”“~\xb3\xba\xb2–\xb0\xad\xb9‹›;:’‘‚’˜ˆ\xb8…\xb7\xa8\xb4`"},
+    {"math", "+-×÷=≠≈∞√π"},
+    {"minimalist", "#+-."},
+    {"normal", "@%#*+=-:."},
+    {"normal2", "&$Xx+;:."},
+    {"numerical", "0896452317"},
+};
+
+// The built-in ramp of mode `name`, or null if there is no such mode
+const AsciiRamp* find_ramp(const std::string& name);
+
+// Returns true if the ramp contains any non-ASCII (Unicode) characters
+bool ramp_has_unicode(const std::string& ramp);
+
+// Cell grid frames are rendered at
+struct Geometry {
+    int width;
+    int height;
+
+    bool operator==(const Geometry& other) const { return width == other.width && height == other.height; }
+    bool operator!=(const Geometry& other) const { return !(*this == other); }
+};
+
+// How the glyph for a cell is chosen
+enum class CellMode {
+    Ramp,  // one pixel per cell, mapped through the ramp by brightness
+    Shape, // a ShapeTable sample grid per cell, matched to a glyph by shape; flat cells use the ramp
+    Braille,   // 2x4 pixels per cell, one braille dot each
+    HalfBlock, // 1x2 pixels per cell; in color the upper half block takes the top pixel's color
+               // and the cell's background the bottom one's
+};
+
+/**
+ * @brief Parses "ramp", "shapes", "braille" or "halfblock"; returns false if unknown.
+ */
+bool parse_cell_mode(const char* name, CellMode& mode);
+
+/**
+ * @brief Converts frames to text: one glyph per cell, optionally colored, with an
+ * optional status line underneath.
+ *
+ * Frames come in as non-owning views at cell_width() x cell_height() pixels per cell; any
+ * stride works, so a region of a larger image renders without a copy. Any PixelFormat is
+ * read as it is: the conversion loop is instantiated per format, and the instantiation is
+ * picked once per band of rows, so no pixel is converted to BGRA first or tested for its
+ * layout. Shrink screen-sized images first, e.g. with AreaDownscaler to image_size(). Text
+ * goes into a caller-provided buffer, and once the renderer has seen its widest frame
+ * nothing is allocated per frame.
+ *
+ * A Renderer keeps per-frame scratch, so each rendering thread needs its own.
+ */
+class Renderer {
+public:
+    /**
+     * @param ramp Glyphs in ASCII_RAMPS order, UTF-8.
+     * @param color Mono for plain text, else the depth of the SGR color escapes to emit.
+     */
+    explicit Renderer(const std::string& ramp, GlyphEncoding encoding = GlyphEncoding::Utf8,
+                      ColorMode color = ColorMode::Mono, ColorLayer layer = ColorLayer::Foreground,
+                      CellMode cells = CellMode::Ramp);
+
+    // Braille and half-block pixels darker than this are drawn as ink
+    static const unsigned char DOT_THRESHOLD = 128;
+
+    // Pixels sampled per cell, across and down
+    int cell_width() const { return cell_width_; }
+    int cell_height() const { return cell_height_; }
+
+    // Image size to scale frames to for a grid of `cells`
+    Geometry image_size(const Geometry& cells) const {
+        return {cells.width * cell_width_, cells.height * cell_height_};
+    }
+
+    /**
+     * @brief Buffer size render() needs for a `width` x `height` pixel image, with or without
+     * a status line. Pixels past the last whole cell are ignored.
+     */
+    size_t max_frame_bytes(int width, int height, bool status_line) const;
+
+    /**
+     * @brief Renders `image` as rows of glyphs, each ending in '\n'.
+     * @param status Text for a last line under the picture, padded or cut to the image
+     *               width; null for none.
+     * @return Bytes written, or 0 (with nothing written) if `capacity` is below max_frame_bytes().
+     */
+    size_t render(const ImageView& image, char* out, size_t capacity, const std::string* status = nullptr);
+
+    /**
+     * @brief Renders into a string, reusing its capacity across frames.
+     */
+    void render(const ImageView& image, std::string& out, const std::string* status = nullptr);
+
+    /**
+     * @brief Like render(), but converts only the bands of rows under tiles that `tiles`
+     * reports dirty; the others reuse their text from the previous frame rendered this way.
+     * @param tiles Updated with `image` once for every frame rendered. Ignored (every band
+     *              converted) with Floyd-Steinberg dithering, whose error crosses bands.
+     */
+    size_t render(const ImageView& image, const TileHasher& tiles, char* out, size_t capacity,
+                  const std::string* status = nullptr);
+    void render(const ImageView& image, const TileHasher& tiles, std::string& out,
+                const std::string* status = nullptr);
+
+    /**
+     * @brief Dithers brightness between the ramp's glyphs, or between dot and no dot in the
+     * braille and half-block modes. Shapes and colored half blocks are not dithered.
+     * @param pool Threads for the Floyd-Steinberg wavefront; null to diffuse on the caller.
+     */
+    void set_dither(DitherMode mode, ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Adapts the mapping of gray levels to glyphs. The luma histogram is counted while
+     * each frame is converted (per band, so bands reused from the last frame keep their
+     * counts), and the curve it gives applies from the next frame on; when it changes, that
+     * frame is converted in full.
+     * @param mode Stretches the levels of the ramp modes and flat shape cells, or moves the
+     *             ink threshold of the braille and half-block dots to match.
+     * @param calibrate Places the ramp's glyphs by their measured ink (ink_levels()) rather
+     *                  than evenly. Dithering spreads levels between evenly spaced glyphs,
+     *                  so it keeps the even spacing and applies the curve to the luma.
+     */
+    void set_tone(ToneMode mode, bool calibrate = false);
+
+    /**
+     * @brief Converts bands of rows on `pool`'s threads, each straight into its own part of
+     * the output buffer; null (the default) converts on the calling thread. Frames with
+     * little to convert stay on the calling thread either way. The pool may be the one
+     * passed to set_dither(), but must not be running another job during render().
+     */
+    void set_pool(ThreadPool* pool);
+
+    // Name of the SIMD conversion kernel picked for this CPU
+    const char* kernel_name() const { return kernel_name_; }
+    bool colored() const { return color_ != nullptr; }
+
+private:
+    // Frames with less work than this (sample pixels read plus the bytes rows may take) are
+    // converted faster on one thread than by waking the pool
+    static const size_t PARALLEL_MIN_WORK = 1 << 16;
+
+    // Row scratch of one converting thread
+    struct RowScratch {
+        std::vector<unsigned char> gray_row;
+        std::vector<unsigned char> sample_luma; // cell_height_ rows of sample luma (shapes, braille)
+        std::vector<char> shape_row;            // each cell's shape glyph, 0 where flat
+        std::vector<unsigned char> cell_color;  // each cell's mean color, BGRA
+        std::vector<uint32_t> levels;           // luma sub-histograms of the band being converted
+    };
+
+    // Most bytes one row of `cells` cells takes, newline included
+    size_t row_bytes(size_t cells) const;
+    size_t render_frame(const ImageView& image, const TileHasher* tiles, char* out, size_t capacity,
+                        const std::string* status);
+    // Converts cell rows [y_begin, y_end) with the instantiation for the image's format
+    char* render_rows(const ImageView& image, int y_begin, int y_end, char* out, RowScratch& scratch);
+    template <PixelFormat F>
+    char* convert_rows(const ImageView& image, int y_begin, int y_end, char* out, RowScratch& scratch);
+    // Converts the bands in dirty_ on pool_, each into its slot of `out` (row_bytes() per
+    // cell row), and records their lengths in band_bytes_
+    void render_bands(const ImageView& image, int band_rows, bool keep, char* out);
+    void dither_rows(const ImageView& image, int row_begin, int row_end, RowScratch& scratch);
+    // Folds the thread's counts into band `band`'s histogram
+    void count_band(int band, RowScratch& scratch);
+    // Takes the frame's histogram into tone_ and, if the curve moved, the tables built on it
+    void retone();
+    // Rebuilds the glyph levels (or dot threshold) from tone_ and the calibration
+    void apply_levels();
+    char* write_shape_cells(const RowScratch& scratch, size_t begin, size_t end, char* out) const;
+    template <PixelFormat F>
+    char* write_half_blocks(const unsigned char* top, const unsigned char* bottom, size_t count, char* out) const;
+    // Mean color of each cell of cell row `y`, as BGRA
+    template <PixelFormat F>
+    void average_cells(const ImageView& image, int y, int width, RowScratch& scratch) const;
+
+    GlyphTable glyphs_;
+    // Row kernels for each PixelFormat, picked for this CPU once
+    AsciiRowFn ascii_rows_[PIXEL_FORMATS]; // used when every glyph is a single byte
+    LumaRowFn luma_rows_[PIXEL_FORMATS];   // used when glyphs are wider (Unicode ramps) or colored
+    const char* kernel_name_ = nullptr;
+    // Null for monochrome output; read-only, so copies of a renderer share it
+    std::shared_ptr<const ColorQuantizer> color_;
+
+    int cell_width_ = 1;
+    int cell_height_ = 1;
+    CellMode cell_mode_ = CellMode::Ramp;
+    // Null unless cells are matched by shape; shared like color_
+    std::shared_ptr<const ShapeTable> shapes_;
+    // Background colors of colored half blocks, whose foreground color_ then is
+    std::shared_ptr<const ColorQuantizer> back_color_;
+    BrailleRowFn braille_row_ = nullptr;
+    unsigned char threshold_ = DOT_THRESHOLD; // dot ink threshold, moved by the tone curve
+
+    ToneCurve tone_;
+    bool calibrated_ = false;
+    std::vector<uint32_t> band_levels_; // LEVEL_BINS luma counts per band, from its last conversion
+    std::vector<uint32_t> frame_levels_; // their sum over the frame
+
+    ThreadPool* pool_ = nullptr;
+    std::vector<RowScratch> scratch_; // one per thread of pool_; [0] is the caller's
+    std::vector<int> dirty_;          // bands to convert this frame
+    std::vector<size_t> band_bytes_;  // text each of them came to
+
+    Ditherer dither_{DitherMode::Off, 0}; // holds the whole frame's sample luma, dithered
+
+    // Text of each band of rows from the last frame rendered with tiles, and its width in cells
+    std::vector<std::string> band_text_;
+    int band_width_ = 0;
+};
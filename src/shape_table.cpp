@@ -0,0 +1,228 @@
+#include "shape_table.h"
+
+#include <cmath>
+
+namespace {
+
+// Glyph cell of the built-in font: 5x7 pixels of ink plus one column and one row of spacing
+const int FONT_CELL_WIDTH = 6;
+const int FONT_CELL_HEIGHT = 8;
+const int FONT_FIRST = 0x20;
+const int FONT_COUNT = 95;
+
+static_assert(FONT_CELL_WIDTH % ShapeTable::SAMPLE_WIDTH == 0 && FONT_CELL_HEIGHT % ShapeTable::SAMPLE_HEIGHT == 0,
+              "samples must cover whole font pixels");
+
+// Printable ASCII in a 5x7 font, one byte per row, bit 4 the leftmost pixel
+const unsigned char FONT_5X7[FONT_COUNT][7] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // space
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}, // !
+    {0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00}, // "
+    {0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A}, // #
+    {0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04}, // $
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, // %
+    {0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D}, // &
+    {0x0C, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00}, // '
+    {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}, // (
+    {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}, // )
+    {0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00}, // *
+    {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00}, // +
+    {0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08}, // ,
+    {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}, // -
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}, // .
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, // /
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // 0
+    {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 1
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, // 2
+    {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}, // 3
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // 4
+    {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // 5
+    {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // 6
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // 7
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // 8
+    {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}, // 9
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}, // :
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08}, // ;
+    {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02}, // <
+    {0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00}, // =
+    {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}, // >
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04}, // ?
+    {0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E}, // @
+    {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // A
+    {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}, // B
+    {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}, // C
+    {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}, // D
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}, // E
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}, // F
+    {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}, // G
+    {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // H
+    {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, // I
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}, // J
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // K
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}, // L
+    {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}, // M
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // N
+    {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // O
+    {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}, // P
+    {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}, // Q
+    {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}, // R
+    {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}, // S
+    {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // T
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // U
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}, // V
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}, // W
+    {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}, // X
+    {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}, // Y
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}, // Z
+    {0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E}, // [
+    {0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00}, // backslash
+    {0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E}, // ]
+    {0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00}, // ^
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F}, // _
+    {0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00}, // `
+    {0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F}, // a
+    {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1E}, // b
+    {0x00, 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E}, // c
+    {0x01, 0x01, 0x0D, 0x13, 0x11, 0x11, 0x0F}, // d
+    {0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E}, // e
+    {0x06, 0x09, 0x08, 0x1C, 0x08, 0x08, 0x08}, // f
+    {0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x0E}, // g
+    {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11}, // h
+    {0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x0E}, // i
+    {0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0C}, // j
+    {0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12}, // k
+    {0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, // l
+    {0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11}, // m
+    {0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11}, // n
+    {0x00, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E}, // o
+    {0x00, 0x00, 0x1E, 0x11, 0x1E, 0x10, 0x10}, // p
+    {0x00, 0x00, 0x0D, 0x13, 0x0F, 0x01, 0x01}, // q
+    {0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10}, // r
+    {0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E}, // s
+    {0x08, 0x08, 0x1C, 0x08, 0x08, 0x09, 0x06}, // t
+    {0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0D}, // u
+    {0x00, 0x00, 0x11, 0x11, 0x11, 0x0A, 0x04}, // v
+    {0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0A}, // w
+    {0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11}, // x
+    {0x00, 0x00, 0x11, 0x11, 0x0F, 0x01, 0x0E}, // y
+    {0x00, 0x00, 0x1F, 0x02, 0x04, 0x08, 0x1F}, // z
+    {0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02}, // {
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // |
+    {0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08}, // }
+    {0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00}, // ~
+};
+
+inline bool font_pixel(int glyph, int x, int y) {
+    return x < 5 && y < 7 && ((FONT_5X7[glyph][y] >> (4 - x)) & 1);
+}
+
+} // namespace
+
+double ink_coverage(uint32_t codepoint) {
+    switch (codepoint) {
+    case 0x2588: // full block
+        return 1.0;
+    case 0x2593: // dark shade
+        return 0.75;
+    case 0x2592: // medium shade
+        return 0.5;
+    case 0x2591: // light shade
+        return 0.25;
+    default:
+        break;
+    }
+    if (codepoint < static_cast<uint32_t>(FONT_FIRST) || codepoint >= static_cast<uint32_t>(FONT_FIRST + FONT_COUNT)) {
+        return -1.0;
+    }
+    // The spacing is part of the cell, so it counts as paper
+    int ink = 0;
+    for (int y = 0; y < 7; ++y) {
+        for (int x = 0; x < 5; ++x) ink += font_pixel(static_cast<int>(codepoint) - FONT_FIRST, x, y);
+    }
+    return static_cast<double>(ink) / (FONT_CELL_WIDTH * FONT_CELL_HEIGHT);
+}
+
+ShapeTable::ShapeTable() {
+    const int samples = SAMPLE_WIDTH * SAMPLE_HEIGHT;
+    const int block_width = FONT_CELL_WIDTH / SAMPLE_WIDTH;
+    const int block_height = FONT_CELL_HEIGHT / SAMPLE_HEIGHT;
+
+    // Ink coverage of each glyph per sample, centered on its mean and scaled to unit length,
+    // so matching compares where the ink is rather than how much there is
+    double shapes[FONT_COUNT][SAMPLE_WIDTH * SAMPLE_HEIGHT] = {};
+    bool usable[FONT_COUNT] = {};
+    for (int g = 0; g < FONT_COUNT; ++g) {
+        double mean = 0.0;
+        for (int s = 0; s < samples; ++s) {
+            const int x0 = (s % SAMPLE_WIDTH) * block_width;
+            const int y0 = (s / SAMPLE_WIDTH) * block_height;
+            int ink = 0;
+            for (int y = y0; y < y0 + block_height; ++y) {
+                for (int x = x0; x < x0 + block_width; ++x) ink += font_pixel(g, x, y);
+            }
+            shapes[g][s] = static_cast<double>(ink) / (block_width * block_height);
+            mean += shapes[g][s];
+        }
+        mean /= samples;
+        double norm = 0.0;
+        for (int s = 0; s < samples; ++s) {
+            shapes[g][s] -= mean;
+            norm += shapes[g][s] * shapes[g][s];
+        }
+        norm = std::sqrt(norm);
+        // A blank glyph has no shape to match
+        usable[g] = norm > 1e-9;
+        for (int s = 0; s < samples && usable[g]; ++s) shapes[g][s] /= norm;
+    }
+
+    // Bolt: Solve every signature up front; the per-cell cost is then a single lookup
+    for (uint32_t signature = 0; signature < SIGNATURE_COUNT; ++signature) {
+        // The signature's own mean term drops out: the glyph vectors sum to zero
+        int best = 0;
+        double best_score = -1e9;
+        for (int g = 0; g < FONT_COUNT; ++g) {
+            if (!usable[g]) continue;
+            double score = 0.0;
+            for (int s = 0; s < samples; ++s) {
+                if (signature & (1u << s)) score += shapes[g][s];
+            }
+            if (score > best_score + 1e-9) {
+                best_score = score;
+                best = g;
+            }
+        }
+        glyphs_[signature] = static_cast<char>(FONT_FIRST + best);
+    }
+}
+
+void ShapeTable::classify_row(const unsigned char* const* luma, size_t cells, unsigned char* mean,
+                              char* shape) const {
+    const int samples = SAMPLE_WIDTH * SAMPLE_HEIGHT;
+    for (size_t x = 0; x < cells; ++x) {
+        unsigned char values[SAMPLE_WIDTH * SAMPLE_HEIGHT];
+        int sum = 0;
+        int lo = 255;
+        int hi = 0;
+        for (int sy = 0; sy < SAMPLE_HEIGHT; ++sy) {
+            const unsigned char* row = luma[sy] + x * SAMPLE_WIDTH;
+            for (int sx = 0; sx < SAMPLE_WIDTH; ++sx) {
+                const int v = row[sx];
+                values[sy * SAMPLE_WIDTH + sx] = static_cast<unsigned char>(v);
+                sum += v;
+                lo = v < lo ? v : lo;
+                hi = v > hi ? v : hi;
+            }
+        }
+        mean[x] = static_cast<unsigned char>(sum / samples);
+        if (hi - lo < MIN_CONTRAST) {
+            shape[x] = 0;
+            continue;
+        }
+        // Darker than the mean is ink, as on the ramps, where the densest glyph is black
+        uint32_t signature = 0;
+        for (int s = 0; s < samples; ++s) {
+            signature |= static_cast<uint32_t>(values[s] * samples < sum) << s;
+        }
+        shape[x] = glyphs_[signature];
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Share of a terminal cell that `codepoint` inks, from the built-in 5x7 font for
+ * printable ASCII and from the block's area for the shaded and solid blocks; negative for
+ * glyphs the font does not have.
+ */
+double ink_coverage(uint32_t codepoint);
+
+/**
+ * @brief Picks glyphs by the shape of a cell rather than its average brightness.
+ *
+ * Each cell is sampled as a SAMPLE_WIDTH x SAMPLE_HEIGHT grid of luma values. Samples
+ * darker than the cell's mean become the set bits of a 12-bit signature, and the glyph for
+ * every possible signature is chosen once, at construction, by correlating it with the ink
+ * coverage of the printable ASCII glyphs of a built-in 5x7 bitmap font. A cell then costs
+ * one table lookup, with no search over glyphs per frame.
+ *
+ * Cells with too little contrast to have a shape are reported as flat, so the caller can
+ * fall back to the mode's brightness ramp for them.
+ */
+class ShapeTable {
+public:
+    // Samples per cell
+    static const int SAMPLE_WIDTH = 3;
+    static const int SAMPLE_HEIGHT = 4;
+    static const size_t SIGNATURE_COUNT = size_t(1) << (SAMPLE_WIDTH * SAMPLE_HEIGHT);
+    // Cells whose samples span fewer gray levels than this are flat
+    static const int MIN_CONTRAST = 48;
+
+    ShapeTable();
+
+    // Best matching glyph for a signature (bit sy * SAMPLE_WIDTH + sx set = sample is ink)
+    char glyph(uint32_t signature) const { return glyphs_[signature]; }
+
+    /**
+     * @brief Classifies a row of `cells` cells.
+     * @param luma SAMPLE_HEIGHT rows of luma, each cells * SAMPLE_WIDTH samples wide.
+     * @param mean Receives each cell's mean luma, for the ramp.
+     * @param shape Receives each cell's glyph, or 0 for a flat cell.
+     */
+    void classify_row(const unsigned char* const* luma, size_t cells, unsigned char* mean, char* shape) const;
+
+private:
+    char glyphs_[SIGNATURE_COUNT];
+};
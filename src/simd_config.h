@@ -0,0 +1,16 @@
+#pragma once
+
+// Which SIMD code paths this build can compile.
+
+// SSE2 is only guaranteed on x86-64; other targets use the scalar kernels.
+#if defined(__x86_64__) || defined(_M_X64)
+#define SCRN_X86 1
+#endif
+
+// GCC/Clang only emit AVX2 instructions in functions compiled for that target;
+// MSVC accepts the intrinsics anywhere.
+#if defined(SCRN_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SCRN_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SCRN_TARGET_AVX2
+#endif
@@ -0,0 +1,168 @@
+#include "stage_stats.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+void LatencyHistogram::record(uint64_t ns) {
+    buckets_[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max = max_ns_.load(std::memory_order_relaxed);
+    while (ns > max && !max_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::counts(Counts& out) const {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        out[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::bucket_of(uint64_t ns) {
+    if (ns < SUB_BUCKETS) return static_cast<size_t>(ns);
+    int exponent = 63;
+    while (!(ns >> exponent)) --exponent;
+    if (exponent > MAX_EXPONENT) return BUCKETS - 1;
+    // The top SUB_BITS bits below the leading one pick the bucket within this power of two
+    const uint64_t mantissa = (ns >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1);
+    return (static_cast<size_t>(exponent - SUB_BITS + 1) << SUB_BITS) + static_cast<size_t>(mantissa);
+}
+
+double LatencyHistogram::bucket_value(size_t bucket) {
+    if (bucket < SUB_BUCKETS) return static_cast<double>(bucket);
+    const int exponent = static_cast<int>(bucket >> SUB_BITS) + SUB_BITS - 1;
+    const uint64_t width = uint64_t(1) << (exponent - SUB_BITS);
+    const uint64_t lower = (SUB_BUCKETS + (bucket & (SUB_BUCKETS - 1))) * width;
+    return static_cast<double>(lower) + static_cast<double>(width) / 2.0;
+}
+
+double LatencyHistogram::percentile(const Counts& counts, uint64_t total, double quantile) {
+    if (total == 0) return 0.0;
+    // Rank of the sample we want, 1-based
+    uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(total) + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return bucket_value(i);
+    }
+    return bucket_value(BUCKETS - 1);
+}
+
+const char* StageStats::stage_name(size_t index) {
+    static const char* const NAMES[STAGE_COUNT] = {"capture", "scale", "convert", "output"};
+    return index < STAGE_COUNT ? NAMES[index] : "unknown";
+}
+
+StatsExporter::StatsExporter(StageStats& stats, std::string target, std::chrono::milliseconds interval)
+    : stats_(stats), target_(std::move(target)), interval_(interval) {}
+
+void StatsExporter::start() {
+    start_time_ = StageStats::Clock::now();
+    thread_ = std::thread(&StatsExporter::run, this);
+}
+
+void StatsExporter::stop() {
+    if (!thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    publish();
+}
+
+void StatsExporter::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto deadline = StageStats::Clock::now() + interval_;
+    while (!cv_.wait_until(lock, deadline, [this] { return stopping_; })) {
+        lock.unlock();
+        publish();
+        lock.lock();
+        deadline += interval_;
+    }
+}
+
+void StatsExporter::publish() {
+    const double uptime = std::chrono::duration<double>(StageStats::Clock::now() - start_time_).count();
+    const bool json = target_ == "-";
+
+    std::ostringstream out;
+    out.precision(6);
+    if (json) {
+        out << "{\"uptime_s\":" << uptime << ",\"stages\":{";
+    } else {
+        out << "# HELP scrn_stage_seconds Time one frame spent in each stage; quantiles cover the last "
+            << std::chrono::duration<double>(interval_).count() << " s.\n"
+            << "# TYPE scrn_stage_seconds summary\n";
+    }
+    std::ostringstream maxima;
+    maxima.precision(6);
+    maxima << "# HELP scrn_stage_max_seconds Longest time in each stage over the last interval.\n"
+           << "# TYPE scrn_stage_max_seconds gauge\n";
+
+    LatencyHistogram::Counts counts;
+    LatencyHistogram::Counts interval;
+    for (size_t s = 0; s < STAGE_COUNT; ++s) {
+        LatencyHistogram& histogram = stats_.stage(s);
+        histogram.counts(counts);
+        uint64_t total = 0;
+        uint64_t interval_total = 0;
+        for (size_t i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+            interval[i] = counts[i] - previous_[s][i];
+            total += counts[i];
+            interval_total += interval[i];
+        }
+        previous_[s] = counts;
+        const double max = static_cast<double>(histogram.take_max_ns());
+        // A bucket's midpoint can lie past the largest sample in it
+        const double p50 = std::min(LatencyHistogram::percentile(interval, interval_total, 0.50), max);
+        const double p99 = std::min(LatencyHistogram::percentile(interval, interval_total, 0.99), max);
+        const char* name = StageStats::stage_name(s);
+
+        if (json) {
+            out << (s ? "," : "") << '"' << name << "\":{\"count\":" << interval_total << ",\"p50_us\":" << p50 / 1e3
+                << ",\"p99_us\":" << p99 / 1e3 << ",\"max_us\":" << max / 1e3 << '}';
+            continue;
+        }
+        const std::string label = std::string("{stage=\"") + name + "\"";
+        out << "scrn_stage_seconds" << label << ",quantile=\"0.5\"} " << p50 / 1e9 << '\n'
+            << "scrn_stage_seconds" << label << ",quantile=\"0.99\"} " << p99 / 1e9 << '\n'
+            << "scrn_stage_seconds_sum" << label << "} " << static_cast<double>(histogram.sum_ns()) / 1e9 << '\n'
+            << "scrn_stage_seconds_count" << label << "} " << total << '\n';
+        maxima << "scrn_stage_max_seconds" << label << "} " << max / 1e9 << '\n';
+    }
+
+    if (json) {
+        out << "}}\n";
+        std::cerr << out.str() << std::flush;
+        return;
+    }
+    out << maxima.str();
+    if (!write_prometheus(out.str()) && !write_failed_) {
+        // Sentinel: Report once instead of flooding stderr every interval
+        std::cerr << "Warning: Failed to write stats to '" << target_ << "'." << std::endl;
+        write_failed_ = true;
+    }
+}
+
+bool StatsExporter::write_prometheus(const std::string& text) {
+    const std::string temp = target_ + ".tmp";
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    file.write(text.data(), static_cast<std::streamsize>(text.size()));
+    file.close();
+    if (!file) return false;
+#ifdef _WIN32
+    return MoveFileExA(temp.c_str(), target_.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return std::rename(temp.c_str(), target_.c_str()) == 0;
+#endif
+}
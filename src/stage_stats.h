@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Pipeline stages timed by --stats
+enum class Stage { Capture, Scale, Convert, Output };
+const size_t STAGE_COUNT = 4;
+
+/**
+ * @brief Lock-free latency histogram with log-linear buckets.
+ *
+ * Each power of two of nanoseconds is split into 8 buckets, so a percentile is known to
+ * within about 6%, and record() is two relaxed atomic adds (plus a compare-exchange on a
+ * new maximum). Any number of threads may record while another reads.
+ * Bolt: Histograms start on their own cache line, so threads timing different stages
+ * don't contend.
+ */
+class alignas(64) LatencyHistogram {
+public:
+    static const int SUB_BITS = 3;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    // Latencies are clamped to 2^36 ns (about 69 s)
+    static const int MAX_EXPONENT = 35;
+    static const size_t BUCKETS = static_cast<size_t>(MAX_EXPONENT - SUB_BITS + 2) << SUB_BITS;
+
+    using Counts = std::array<uint64_t, BUCKETS>;
+
+    void record(uint64_t ns);
+
+    // Bucket counts so far; subtract an earlier copy to get the counts for an interval
+    void counts(Counts& out) const;
+    // Sum of every recorded latency, in ns
+    uint64_t sum_ns() const { return sum_ns_.load(std::memory_order_relaxed); }
+    // Longest latency since the previous call, in ns
+    uint64_t take_max_ns() { return max_ns_.exchange(0, std::memory_order_relaxed); }
+
+    static size_t bucket_of(uint64_t ns);
+    // Midpoint of a bucket, in ns
+    static double bucket_value(size_t bucket);
+    /**
+     * @brief Latency below which `quantile` of the samples in `counts` fall (0 when empty).
+     */
+    static double percentile(const Counts& counts, uint64_t total, double quantile);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};
+    std::atomic<uint64_t> sum_ns_{0};
+    std::atomic<uint64_t> max_ns_{0};
+};
+
+/**
+ * @brief Per-stage latency histograms for one run.
+ */
+class StageStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void record(Stage stage, Clock::duration elapsed) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        stages_[static_cast<size_t>(stage)].record(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+    }
+
+    LatencyHistogram& stage(size_t index) { return stages_[index]; }
+
+    static const char* stage_name(size_t index);
+
+private:
+    std::array<LatencyHistogram, STAGE_COUNT> stages_;
+};
+
+/**
+ * @brief Times the enclosing scope as one stage of a frame. Does nothing (not even read the
+ * clock) when `stats` is null, so untimed runs pay only a pointer test.
+ */
+class StageTimer {
+public:
+    StageTimer(StageStats* stats, Stage stage) : stats_(stats), stage_(stage) {
+        if (stats_) start_ = StageStats::Clock::now();
+    }
+    ~StageTimer() {
+        if (stats_) stats_->record(stage_, StageStats::Clock::now() - start_);
+    }
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    StageStats* stats_;
+    Stage stage_;
+    StageStats::Clock::time_point start_;
+};
+
+/**
+ * @brief Publishes StageStats once per interval from its own thread.
+ *
+ * The target "-" writes one JSON line per interval to stderr; any other target is a file
+ * rewritten in the Prometheus text format, through a temporary file and a rename so a
+ * scraper never sees it half written. Percentiles and maxima cover the last interval;
+ * the Prometheus sums and counts are cumulative.
+ */
+class StatsExporter {
+public:
+    StatsExporter(StageStats& stats, std::string target,
+                  std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+    ~StatsExporter() { stop(); }
+    StatsExporter(const StatsExporter&) = delete;
+    StatsExporter& operator=(const StatsExporter&) = delete;
+
+    void start();
+    // Publishes a last report and stops the thread
+    void stop();
+
+private:
+    void run();
+    void publish();
+    bool write_prometheus(const std::string& text);
+
+    StageStats& stats_;
+    std::string target_;
+    std::chrono::milliseconds interval_;
+    StageStats::Clock::time_point start_time_;
+    std::array<LatencyHistogram::Counts, STAGE_COUNT> previous_{};
+    bool write_failed_ = false;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
@@ -0,0 +1,415 @@
+#ifdef _WIN32
+// Sentinel: select() handles at most FD_SETSIZE sockets; raise Winsock's default of 64
+#define FD_SETSIZE 512
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+#endif
+
+#include "stream_server.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+
+// Sentinel: Cap connections so a flood of clients can't exhaust descriptors or memory
+const size_t MAX_CLIENTS = 256;
+// Backlog a client may accumulate before it is skipped ahead to a keyframe
+const size_t MAX_QUEUE_BYTES = 2 << 20;
+// Sent once on connect: clear the screen the first keyframe is drawn over
+const char GREETING[] = "\033[2J";
+
+#ifdef _WIN32
+typedef SOCKET socket_t;
+const socket_t NO_SOCKET = INVALID_SOCKET;
+inline void close_socket(socket_t s) { closesocket(s); }
+inline bool would_block() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+inline bool set_nonblocking(socket_t s) {
+    u_long on = 1;
+    return ioctlsocket(s, FIONBIO, &on) == 0;
+}
+#else
+typedef int socket_t;
+const socket_t NO_SOCKET = -1;
+inline void close_socket(socket_t s) { ::close(s); }
+inline bool would_block() { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; }
+inline bool set_nonblocking(socket_t s) {
+    const int flags = fcntl(s, F_GETFL, 0);
+    return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+#endif
+
+inline socket_t as_socket(intptr_t s) { return static_cast<socket_t>(s); }
+
+} // namespace
+
+struct StreamServer::Client {
+    socket_t socket;
+    std::deque<Message> queue;
+    size_t offset = 0;        // bytes of queue.front() already sent
+    size_t queued_bytes = 0;  // total size of the queued messages
+    bool needs_keyframe = true;
+    bool want_write = false;  // registered for writability
+    bool dead = false;
+};
+
+StreamServer::StreamServer() = default;
+
+StreamServer::~StreamServer() { stop(); }
+
+bool StreamServer::start(const std::string& address, std::string& error) {
+    // "port" binds to loopback only; exposing the screen to the network takes an explicit host
+    std::string host = "127.0.0.1";
+    std::string port = address;
+    const size_t colon = address.rfind(':');
+    if (colon != std::string::npos) {
+        host = address.substr(0, colon);
+        port = address.substr(colon + 1);
+        // [::1]:7000
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+    }
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        error = "Winsock initialization failed";
+        return false;
+    }
+    winsock_ = true;
+#else
+    // Writes to a client that hung up must fail with EPIPE rather than kill the process
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+        error = "Invalid listen address '" + address + "'";
+        return false;
+    }
+    socket_t listener = NO_SOCKET;
+    for (addrinfo* ai = result; ai && listener == NO_SOCKET; ai = ai->ai_next) {
+        listener = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (listener == NO_SOCKET) continue;
+        const int on = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&on), sizeof(on));
+        if (bind(listener, ai->ai_addr, static_cast<int>(ai->ai_addrlen)) != 0 || listen(listener, 64) != 0 ||
+            !set_nonblocking(listener)) {
+            close_socket(listener);
+            listener = NO_SOCKET;
+        }
+    }
+    freeaddrinfo(result);
+    if (listener == NO_SOCKET) {
+        error = "Cannot listen on '" + address + "'";
+        return false;
+    }
+    listener_ = static_cast<intptr_t>(listener);
+
+#ifdef __linux__
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    const int wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_ < 0 || wake < 0) {
+        error = "Cannot create the event loop";
+        return false;
+    }
+    wake_read_ = wake_write_ = wake;
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = listener;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, listener, &ev);
+    ev.data.fd = wake;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, wake, &ev);
+#else
+    // A UDP socket connected to itself wakes select() portably (Winsock can't select on pipes)
+    socket_t wake = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in loopback = {};
+    loopback.sin_family = AF_INET;
+    loopback.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(loopback);
+    if (wake == NO_SOCKET || bind(wake, reinterpret_cast<sockaddr*>(&loopback), sizeof(loopback)) != 0 ||
+        getsockname(wake, reinterpret_cast<sockaddr*>(&loopback), &length) != 0 ||
+        connect(wake, reinterpret_cast<sockaddr*>(&loopback), sizeof(loopback)) != 0 || !set_nonblocking(wake)) {
+        error = "Cannot create the event loop";
+        return false;
+    }
+    wake_read_ = wake_write_ = static_cast<intptr_t>(wake);
+#endif
+
+    running_ = true;
+    thread_ = std::thread([this] { run(); });
+    return true;
+}
+
+void StreamServer::stop() {
+    if (running_) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake();
+        thread_.join();
+        running_ = false;
+    }
+    for (auto& client : clients_) close_socket(client->socket);
+    clients_.clear();
+    if (listener_ != -1) close_socket(as_socket(listener_));
+    listener_ = -1;
+#ifdef __linux__
+    if (wake_read_ != -1) ::close(static_cast<int>(wake_read_));
+    if (epoll_ >= 0) ::close(epoll_);
+    epoll_ = -1;
+#else
+    if (wake_read_ != -1) close_socket(as_socket(wake_read_));
+#endif
+    wake_read_ = wake_write_ = -1;
+#ifdef _WIN32
+    if (winsock_) WSACleanup();
+    winsock_ = false;
+#endif
+}
+
+void StreamServer::wake() {
+#ifdef __linux__
+    const uint64_t one = 1;
+    ssize_t ignored = ::write(static_cast<int>(wake_write_), &one, sizeof(one));
+    (void)ignored;
+#else
+    const char byte = 0;
+    send(as_socket(wake_write_), &byte, 1, 0);
+#endif
+}
+
+StreamServer::Message StreamServer::encode_keyframe(const std::string& frame) const {
+    // Cursor home, then the frame with CRLF line ends so raw TCP and telnet clients both
+    // return to the first column
+    auto message = std::make_shared<std::string>();
+    message->reserve(frame.size() + frame.size() / 64 + 8);
+    *message += "\033[H";
+    for (size_t start = 0; start < frame.size();) {
+        size_t end = frame.find('\n', start);
+        if (end == std::string::npos) end = frame.size();
+        message->append(frame, start, end - start);
+        if (end < frame.size()) *message += "\r\n";
+        start = end + 1;
+    }
+    return message;
+}
+
+void StreamServer::broadcast(const std::string& frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (clients_.empty()) {
+            // Nobody to diff for; the next client starts from a keyframe anyway
+            differ_.reset();
+            last_frame_ = frame;
+            last_keyframe_.reset();
+            return;
+        }
+    }
+
+    // Bolt: Encode once for everyone; the keyframe only if some client needs it
+    Message delta;
+    const bool has_delta = differ_.diff(frame, runs_);
+    if (has_delta && !runs_.empty()) {
+        auto text = std::make_shared<std::string>();
+        append_ansi_runs(frame, runs_, *text);
+        delta = text;
+    }
+    Message keyframe;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& client_ptr : clients_) {
+            Client& client = *client_ptr;
+            if (client.queued_bytes > MAX_QUEUE_BYTES) {
+                // Backpressure: this client can't keep up. Drop its backlog (except a message
+                // already partly on the wire) and skip it ahead to a fresh keyframe.
+                const bool in_flight = client.offset > 0;
+                while (client.queue.size() > (in_flight ? 1u : 0u)) client.queue.pop_back();
+                client.queued_bytes = in_flight ? client.queue.front()->size() : 0;
+                client.needs_keyframe = true;
+            }
+            Message message;
+            if (client.needs_keyframe || !has_delta) {
+                if (!keyframe) keyframe = encode_keyframe(frame);
+                message = keyframe;
+                client.needs_keyframe = false;
+            } else {
+                message = delta;
+            }
+            if (!message) continue; // nothing changed
+            client.queue.push_back(message);
+            client.queued_bytes += message->size();
+        }
+        // Under the same lock as the queues, so a client accepted later starts from this frame
+        // and one accepted earlier has it as a delta
+        last_frame_ = frame;
+        last_keyframe_ = keyframe;
+    }
+    wake();
+}
+
+void StreamServer::accept_clients() {
+    while (true) {
+        sockaddr_storage addr;
+        socklen_t length = sizeof(addr);
+        const socket_t s = accept(as_socket(listener_), reinterpret_cast<sockaddr*>(&addr), &length);
+        if (s == NO_SOCKET) return;
+#ifndef _WIN32
+        // select() can't watch descriptors past FD_SETSIZE
+        const bool fits = s < FD_SETSIZE;
+#else
+        const bool fits = true;
+#endif
+        if (clients_.size() >= MAX_CLIENTS || !fits || !set_nonblocking(s)) {
+            close_socket(s);
+            continue;
+        }
+        // Frames are latency sensitive and already written in large pieces
+        const int on = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+
+        std::unique_ptr<Client> client(new Client());
+        client->socket = s;
+        auto greeting = std::make_shared<std::string>(GREETING);
+        client->queued_bytes = greeting->size();
+        client->queue.push_back(greeting);
+        // The screen may not change for a while: draw the last frame now rather than at
+        // the next broadcast()
+        if (!last_frame_.empty()) {
+            if (!last_keyframe_) last_keyframe_ = encode_keyframe(last_frame_);
+            client->queued_bytes += last_keyframe_->size();
+            client->queue.push_back(last_keyframe_);
+            client->needs_keyframe = false;
+        }
+#ifdef __linux__
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = s;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, s, &ev);
+#endif
+        clients_.push_back(std::move(client));
+    }
+}
+
+bool StreamServer::flush(Client& client) {
+    while (!client.queue.empty()) {
+        const std::string& message = *client.queue.front();
+        const int sent = static_cast<int>(send(client.socket, message.data() + client.offset,
+                                               static_cast<int>(message.size() - client.offset), MSG_NOSIGNAL));
+        if (sent < 0) return would_block();
+        client.offset += static_cast<size_t>(sent);
+        if (client.offset == message.size()) {
+            client.queued_bytes -= message.size();
+            client.queue.pop_front();
+            client.offset = 0;
+        }
+    }
+    return true;
+}
+
+void StreamServer::drop(size_t index) {
+    close_socket(clients_[index]->socket); // also removes it from the epoll set
+    clients_[index] = std::move(clients_.back());
+    clients_.pop_back();
+}
+
+void StreamServer::run() {
+    const socket_t listener = as_socket(listener_);
+    char discard[512];
+    while (true) {
+#ifdef __linux__
+        epoll_event events[64];
+        const int count = epoll_wait(epoll_, events, 64, -1);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        for (int i = 0; i < count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == listener) {
+                accept_clients();
+            } else if (fd == wake_read_) {
+                uint64_t value;
+                ssize_t ignored = ::read(fd, &value, sizeof(value));
+                (void)ignored;
+            } else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                // Clients don't send anything we use; reading only detects hang-ups
+                for (auto& client : clients_) {
+                    if (client->socket != fd) continue;
+                    const ssize_t got = recv(fd, discard, sizeof(discard), 0);
+                    if (got == 0 || (got < 0 && !would_block())) client->dead = true;
+                }
+            }
+        }
+#else
+        fd_set readable, writable;
+        FD_ZERO(&readable);
+        FD_ZERO(&writable);
+        FD_SET(listener, &readable);
+        FD_SET(as_socket(wake_read_), &readable);
+        socket_t highest = listener > as_socket(wake_read_) ? listener : as_socket(wake_read_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& client : clients_) {
+                FD_SET(client->socket, &readable);
+                if (!client->queue.empty()) FD_SET(client->socket, &writable);
+                if (client->socket > highest) highest = client->socket;
+            }
+        }
+        select(static_cast<int>(highest) + 1, &readable, &writable, NULL, NULL);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        if (FD_ISSET(as_socket(wake_read_), &readable)) {
+            while (recv(as_socket(wake_read_), discard, sizeof(discard), 0) > 0) {
+            }
+        }
+        if (FD_ISSET(listener, &readable)) accept_clients();
+        for (auto& client : clients_) {
+            if (!FD_ISSET(client->socket, &readable)) continue;
+            const int got = static_cast<int>(recv(client->socket, discard, sizeof(discard), 0));
+            if (got == 0 || (got < 0 && !would_block())) client->dead = true;
+        }
+#endif
+
+        // Push out whatever is queued; sockets that would block are retried when writable
+        for (size_t i = 0; i < clients_.size();) {
+            Client& client = *clients_[i];
+            if (client.dead || !flush(client)) {
+                drop(i);
+                continue;
+            }
+#ifdef __linux__
+            const bool want_write = !client.queue.empty();
+            if (want_write != client.want_write) {
+                epoll_event ev = {};
+                ev.events = EPOLLIN | (want_write ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+                ev.data.fd = client.socket;
+                epoll_ctl(epoll_, EPOLL_CTL_MOD, client.socket, &ev);
+                client.want_write = want_write;
+            }
+#endif
+            ++i;
+        }
+    }
+}
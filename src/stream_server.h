@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "diff_output.h"
+
+/**
+ * @brief Mirrors rendered frames to any number of TCP clients (e.g. `nc host port`).
+ *
+ * Each frame is encoded once, as a delta of changed runs against the previous frame and,
+ * only when some client needs one, as a keyframe (cursor home plus the whole frame). The
+ * encoded messages are shared by every client's output queue. A client whose queue grows
+ * past its limit (a slow link or a stalled terminal) has its backlog dropped and is
+ * resynchronized with the next keyframe, so it never holds up the others. A client that
+ * connects is sent a keyframe of the last frame right away, so a screen that isn't changing
+ * still shows up.
+ *
+ * Sockets are serviced by a single event loop thread: epoll on Linux, select elsewhere.
+ */
+class StreamServer {
+public:
+    StreamServer();
+    ~StreamServer();
+    StreamServer(const StreamServer&) = delete;
+    StreamServer& operator=(const StreamServer&) = delete;
+
+    /**
+     * @brief Listens on `address` ("port" for localhost only, or "host:port") and starts the loop.
+     * @return False with `error` set on failure.
+     */
+    bool start(const std::string& address, std::string& error);
+
+    /**
+     * @brief Queues `frame` for every client. Called once per frame from the render loop.
+     */
+    void broadcast(const std::string& frame);
+
+    // Stops the loop and disconnects every client
+    void stop();
+
+private:
+    struct Client;
+    using Message = std::shared_ptr<const std::string>;
+
+    void run();
+    void accept_clients();
+    bool flush(Client& client);
+    void drop(size_t index);
+    void wake();
+    Message encode_keyframe(const std::string& frame) const;
+
+    intptr_t listener_ = -1;
+    intptr_t wake_read_ = -1;  // eventfd (Linux) or the read end of a loopback pair
+    intptr_t wake_write_ = -1;
+#ifdef __linux__
+    int epoll_ = -1;
+#endif
+#ifdef _WIN32
+    bool winsock_ = false;
+#endif
+    std::thread thread_;
+    bool running_ = false;
+
+    std::mutex mutex_; // guards clients_, stopping_ and the last frame
+    std::vector<std::unique_ptr<Client>> clients_;
+    bool stopping_ = false;
+    std::string last_frame_; // last frame broadcast, the first a new client is sent
+    Message last_keyframe_;  // its keyframe, once encoded
+
+    // Render-thread state
+    FrameDiffer differ_;
+    std::vector<DiffRun> runs_;
+};
@@ -0,0 +1,169 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    shares_.reset(new Share[threads]);
+    for (size_t i = 1; i < threads; ++i) {
+        workers_.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& t : workers_) t.join();
+}
+
+void ThreadPool::parallel_for(size_t count, size_t chunks, const RangeFn& fn) {
+    if (count == 0) return;
+    if (chunks > count) chunks = count;
+    if (chunks <= 1 || workers_.empty()) {
+        // Bolt: Nothing to split; skip the wake-up round trip entirely
+        fn(0, count, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = &fn;
+        count_ = count;
+        chunks_ = chunks;
+        next_chunk_.store(0);
+        stealing_ = false;
+        busy_ = workers_.size();
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    run_chunks(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busy_ == 0; });
+    fn_ = nullptr;
+}
+
+void ThreadPool::parallel_steal(size_t count, const RangeFn& fn) {
+    if (count == 0) return;
+    if (count == 1 || workers_.empty()) {
+        for (size_t i = 0; i < count; ++i) fn(i, i + 1, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = &fn;
+        // Shares are published before the wake-up, under the same lock the workers take
+        const size_t threads = size();
+        for (size_t t = 0; t < threads; ++t) {
+            const uint64_t begin = count * t / threads;
+            const uint64_t end = count * (t + 1) / threads;
+            shares_[t].range.store(end << 32 | begin, std::memory_order_relaxed);
+        }
+        stealing_ = true;
+        busy_ = workers_.size();
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    run_shares(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busy_ == 0; });
+    fn_ = nullptr;
+}
+
+void ThreadPool::run_job(size_t worker) {
+    if (stealing_) {
+        run_shares(worker);
+    } else {
+        run_chunks(worker);
+    }
+}
+
+bool ThreadPool::take(size_t worker, size_t& item) {
+    std::atomic<uint64_t>& range = shares_[worker].range;
+    uint64_t current = range.load(std::memory_order_acquire);
+    while (true) {
+        const uint32_t begin = static_cast<uint32_t>(current);
+        const uint32_t end = static_cast<uint32_t>(current >> 32);
+        if (begin >= end) return false;
+        // Thieves shrink the end, so the front item is only ours if the range is unchanged
+        if (range.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            item = begin;
+            return true;
+        }
+    }
+}
+
+bool ThreadPool::steal(size_t worker) {
+    const size_t threads = size();
+    while (true) {
+        // Victim: the share with the most items left
+        size_t victim = threads;
+        uint64_t victim_range = 0;
+        uint32_t most = 0;
+        for (size_t t = 0; t < threads; ++t) {
+            if (t == worker) continue;
+            const uint64_t current = shares_[t].range.load(std::memory_order_acquire);
+            const uint32_t begin = static_cast<uint32_t>(current);
+            const uint32_t end = static_cast<uint32_t>(current >> 32);
+            if (begin < end && end - begin > most) {
+                victim = t;
+                victim_range = current;
+                most = end - begin;
+            }
+        }
+        if (victim == threads) return false;
+
+        const uint64_t begin = static_cast<uint32_t>(victim_range);
+        const uint64_t end = victim_range >> 32;
+        const uint64_t split = end - (most + 1) / 2;
+        if (shares_[victim].range.compare_exchange_strong(victim_range, split << 32 | begin,
+                                                          std::memory_order_acq_rel)) {
+            // Our own share is empty, so nobody else writes it until this store
+            shares_[worker].range.store(end << 32 | split, std::memory_order_release);
+            return true;
+        }
+        // The owner took an item or another thief got there first; look again
+    }
+}
+
+void ThreadPool::run_shares(size_t worker) {
+    // Bolt: A thread works through its own share front to back, touching other threads'
+    // shares only when it runs dry
+    size_t item;
+    do {
+        while (take(worker, item)) (*fn_)(item, item + 1, worker);
+    } while (steal(worker));
+}
+
+void ThreadPool::run_chunks(size_t worker) {
+    // Chunks are claimed dynamically, so a thread that finishes early takes the next one
+    for (size_t chunk = next_chunk_.fetch_add(1); chunk < chunks_; chunk = next_chunk_.fetch_add(1)) {
+        const size_t begin = count_ * chunk / chunks_;
+        const size_t end = count_ * (chunk + 1) / chunks_;
+        (*fn_)(begin, end, worker);
+    }
+}
+
+void ThreadPool::worker_loop(size_t worker) {
+    size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+        }
+        run_job(worker);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --busy_;
+        }
+        done_.notify_one();
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Persistent worker threads for splitting one frame's work into bands.
+ *
+ * Threads are started once and parked between frames, so a parallel_for costs a wake-up
+ * rather than a thread creation. The calling thread takes part in the work too.
+ */
+class ThreadPool {
+public:
+    // Body of a parallel_for: processes items [begin, end) on worker `worker`
+    // (0 is the calling thread), so callers can keep per-worker scratch buffers.
+    using RangeFn = std::function<void(size_t begin, size_t end, size_t worker)>;
+
+    /**
+     * @param threads Total threads including the caller; 0 picks the hardware concurrency.
+     */
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads that may run a body, including the caller
+    size_t size() const { return workers_.size() + 1; }
+
+    /**
+     * @brief Runs `fn` over [0, count) split into `chunks` contiguous ranges and waits for all of them.
+     * Only one parallel_for may run at a time.
+     */
+    void parallel_for(size_t count, size_t chunks, const RangeFn& fn);
+
+    /**
+     * @brief Runs `fn` on each item of [0, count), one call per item, and waits for all of them.
+     *
+     * Every thread starts on an even share of the items; one that runs out steals the back
+     * half of whichever share has the most left, so items of uneven cost still finish
+     * together. Unlike parallel_for, items are not claimed in order. Only one job may run
+     * at a time.
+     */
+    void parallel_steal(size_t count, const RangeFn& fn);
+
+private:
+    // A thread's share of a parallel_steal job: items [low half, high half), updated by CAS
+    struct alignas(64) Share {
+        std::atomic<uint64_t> range{0};
+    };
+
+    void worker_loop(size_t worker);
+    void run_job(size_t worker);
+    void run_chunks(size_t worker);
+    void run_shares(size_t worker);
+    // Takes the next item of `worker`'s own share; false once it is empty
+    bool take(size_t worker, size_t& item);
+    // Moves the back half of the fullest share to `worker`'s; false if nothing is left
+    bool steal(size_t worker);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    size_t generation_ = 0;
+    size_t busy_ = 0;
+    bool stop_ = false;
+
+    // Current job
+    const RangeFn* fn_ = nullptr;
+    size_t count_ = 0;
+    size_t chunks_ = 0;
+    std::atomic<size_t> next_chunk_{0};
+    bool stealing_ = false;           // parallel_steal rather than parallel_for
+    std::unique_ptr<Share[]> shares_; // one per thread
+};
@@ -0,0 +1,183 @@
+#include "tile_hash.h"
+
+#include <cstring>
+
+#include "luma_kernels.h"
+
+#ifdef SCRN_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Words per pixel row of a tile
+const int TILE_WORDS = TileHasher::TILE_WIDTH * 4 / 8;
+
+// Folds word `i` of a tile's pixel row into its two-word hash
+inline void fold_word(uint64_t word, int i, const uint64_t* keys, uint64_t* hash) {
+    const uint64_t keyed = word ^ keys[i];
+    hash[(i & 1) ^ 1] += word;
+    hash[i & 1] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+}
+
+// Folds the first `bytes` bytes of a tile's pixel row; the last word may be partial and is
+// zero-extended (a lone BGRA pixel, or the end of a narrower format's row)
+void fold_bytes(const unsigned char* p, size_t bytes, const uint64_t* keys, uint64_t* hash) {
+    const size_t words = bytes / 8;
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t word;
+        std::memcpy(&word, p + i * 8, 8);
+        fold_word(word, static_cast<int>(i), keys, hash);
+    }
+    if (bytes % 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, p + words * 8, bytes % 8);
+        fold_word(word, static_cast<int>(words), keys, hash);
+    }
+}
+
+// Position keys: one per word of each pixel row of a tile (splitmix64 output)
+struct TileKeys {
+    uint64_t keys[TileHasher::TILE_HEIGHT][TILE_WORDS];
+
+    TileKeys() {
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        for (auto& row : keys) {
+            for (uint64_t& key : row) {
+                uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                key = z ^ (z >> 31);
+            }
+        }
+    }
+};
+
+const TileKeys TILE_KEYS;
+
+} // namespace
+
+void tile_row_scalar(const unsigned char* row, size_t tiles, const uint64_t* keys, uint64_t* hashes) {
+    for (size_t t = 0; t < tiles; ++t) {
+        fold_bytes(row + t * TileHasher::TILE_WIDTH * 4, TileHasher::TILE_WIDTH * 4, keys, hashes + t * 2);
+    }
+}
+
+#ifdef SCRN_X86
+void tile_row_sse2(const unsigned char* row, size_t tiles, const uint64_t* keys, uint64_t* hashes) {
+    static_assert(TILE_WORDS == 8, "four blocks per tile row");
+    const __m128i* k = reinterpret_cast<const __m128i*>(keys);
+    const __m128i key0 = _mm_loadu_si128(k);
+    const __m128i key1 = _mm_loadu_si128(k + 1);
+    const __m128i key2 = _mm_loadu_si128(k + 2);
+    const __m128i key3 = _mm_loadu_si128(k + 3);
+    for (size_t t = 0; t < tiles; ++t) {
+        const __m128i* src = reinterpret_cast<const __m128i*>(row + t * TileHasher::TILE_WIDTH * 4);
+        __m128i* hash = reinterpret_cast<__m128i*>(hashes + t * 2);
+        // Each word goes to the other lane, and the product of its keyed halves to its own
+        auto fold = [](__m128i acc, __m128i data, __m128i key) {
+            const __m128i keyed = _mm_xor_si128(data, key);
+            const __m128i product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+            return _mm_add_epi64(acc, _mm_add_epi64(_mm_shuffle_epi32(data, 0x4E), product));
+        };
+        __m128i acc = _mm_loadu_si128(hash);
+        acc = fold(acc, _mm_loadu_si128(src), key0);
+        acc = fold(acc, _mm_loadu_si128(src + 1), key1);
+        acc = fold(acc, _mm_loadu_si128(src + 2), key2);
+        acc = fold(acc, _mm_loadu_si128(src + 3), key3);
+        _mm_storeu_si128(hash, acc);
+    }
+}
+
+SCRN_TARGET_AVX2
+void tile_row_avx2(const unsigned char* row, size_t tiles, const uint64_t* keys, uint64_t* hashes) {
+    const __m256i* k = reinterpret_cast<const __m256i*>(keys);
+    const __m256i key01 = _mm256_loadu_si256(k);
+    const __m256i key23 = _mm256_loadu_si256(k + 1);
+    for (size_t t = 0; t < tiles; ++t) {
+        const __m256i* src = reinterpret_cast<const __m256i*>(row + t * TileHasher::TILE_WIDTH * 4);
+        const __m256i data01 = _mm256_loadu_si256(src);
+        const __m256i data23 = _mm256_loadu_si256(src + 1);
+        const __m256i keyed01 = _mm256_xor_si256(data01, key01);
+        const __m256i keyed23 = _mm256_xor_si256(data23, key23);
+        __m256i sum = _mm256_add_epi64(_mm256_shuffle_epi32(data01, 0x4E), _mm256_shuffle_epi32(data23, 0x4E));
+        sum = _mm256_add_epi64(sum, _mm256_mul_epu32(keyed01, _mm256_srli_epi64(keyed01, 32)));
+        sum = _mm256_add_epi64(sum, _mm256_mul_epu32(keyed23, _mm256_srli_epi64(keyed23, 32)));
+        // The sums are mod 2^64, so folding both halves last matches the block-by-block order
+        __m128i* hash = reinterpret_cast<__m128i*>(hashes + t * 2);
+        const __m128i folded = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        _mm_storeu_si128(hash, _mm_add_epi64(_mm_loadu_si128(hash), folded));
+    }
+    _mm256_zeroupper();
+}
+#endif
+
+TileRowFn select_tile_row_kernel(const char** name) {
+#ifdef SCRN_X86
+    if (cpu_has_avx2()) {
+        if (name) *name = "avx2";
+        return tile_row_avx2;
+    }
+    if (name) *name = "sse2";
+    return tile_row_sse2;
+#else
+    if (name) *name = "scalar";
+    return tile_row_scalar;
+#endif
+}
+
+TileHasher::TileHasher() : tile_row_(select_tile_row_kernel()) {}
+
+size_t TileHasher::update(const ImageView& image) {
+    const int columns = (image.width + TILE_WIDTH - 1) / TILE_WIDTH;
+    const int rows = (image.height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+    const size_t tiles = static_cast<size_t>(columns) * rows;
+    if (image.width != width_ || image.height != height_ || image.format != format_) {
+        width_ = image.width;
+        height_ = image.height;
+        format_ = image.format;
+        columns_ = columns;
+        rows_ = rows;
+        hashes_.clear();
+    }
+    current_.assign(tiles * 2, 0);
+    dirty_.resize(tiles);
+    row_dirty_.resize(rows);
+
+    // Bolt: Row-major, so the frame streams through once; the tiles of a row are
+    // independent sums the CPU can overlap
+    const size_t pixel_bytes = bytes_per_pixel(image.format);
+    const int full_columns = image.width / TILE_WIDTH;
+    const size_t tail_bytes = (image.width - full_columns * TILE_WIDTH) * pixel_bytes;
+    for (int y = 0; y < image.height; ++y) {
+        const unsigned char* row = image.row(y);
+        const uint64_t* keys = TILE_KEYS.keys[y % TILE_HEIGHT];
+        uint64_t* hash = &current_[static_cast<size_t>(y / TILE_HEIGHT) * columns * 2];
+        if (pixel_bytes == 4) {
+            tile_row_(row, full_columns, keys, hash);
+        } else {
+            // Narrower formats have fewer words per tile row than the kernels expect
+            for (int t = 0; t < full_columns; ++t) {
+                fold_bytes(row + t * TILE_WIDTH * pixel_bytes, TILE_WIDTH * pixel_bytes, keys, hash + t * 2);
+            }
+        }
+        if (tail_bytes) fold_bytes(row + full_columns * TILE_WIDTH * pixel_bytes, tail_bytes, keys, hash + full_columns * 2);
+    }
+
+    const bool all = hashes_.size() != current_.size();
+    dirty_count_ = 0;
+    for (int ty = 0; ty < rows; ++ty) {
+        uint8_t any = 0;
+        for (int tx = 0; tx < columns; ++tx) {
+            const size_t i = static_cast<size_t>(ty) * columns + tx;
+            const uint8_t changed = all || current_[i * 2] != hashes_[i * 2] || current_[i * 2 + 1] != hashes_[i * 2 + 1];
+            dirty_[i] = changed;
+            any |= changed;
+            dirty_count_ += changed;
+        }
+        row_dirty_[ty] = any;
+    }
+    hashes_.swap(current_);
+    return dirty_count_;
+}
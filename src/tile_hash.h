@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "image_view.h"
+#include "simd_config.h"
+
+/**
+ * @brief Folds one pixel row of `tiles` whole tiles into their hashes.
+ * @param row TileHasher::TILE_WIDTH BGRA pixels per tile.
+ * @param keys Eight 64-bit keys for this pixel row's position within its tile.
+ * @param hashes Two words per tile.
+ *
+ * Each 8-byte word is added to the other lane and the product of the two halves of the
+ * word xor its key to its own, as in XXH3's accumulate step. The kernels are
+ * interchangeable bit for bit.
+ */
+using TileRowFn = void (*)(const unsigned char* row, size_t tiles, const uint64_t* keys, uint64_t* hashes);
+
+void tile_row_scalar(const unsigned char* row, size_t tiles, const uint64_t* keys, uint64_t* hashes);
+#ifdef SCRN_X86
+// One 16-byte block per step.
+void tile_row_sse2(const unsigned char* row, size_t tiles, const uint64_t* keys, uint64_t* hashes);
+// Two blocks per step. Only call when cpu_has_avx2() is true.
+void tile_row_avx2(const unsigned char* row, size_t tiles, const uint64_t* keys, uint64_t* hashes);
+#endif
+
+/**
+ * @brief Tile hashing counterpart of select_ascii_row_kernel().
+ */
+TileRowFn select_tile_row_kernel(const char** name = nullptr);
+
+/**
+ * @brief Finds the parts of a frame that changed since the last one, by hashing fixed tiles.
+ *
+ * Each TILE_WIDTH x TILE_HEIGHT pixel tile gets a fast non-cryptographic 128-bit hash,
+ * computed with SIMD a 16-byte block at a time, and is compared with its hash from the
+ * previous update, so nothing but the hashes of the last frame is kept. Every word is keyed
+ * by its position in the tile, and a change to any single word always changes the hash.
+ * Any PixelFormat can be hashed; BGRA and RGBA rows go through the SIMD kernels. After the
+ * first update, a size or format change or reset(), every tile is dirty.
+ */
+class TileHasher {
+public:
+    // Tile size in pixels. The height is a multiple of every cell height and of the Bayer
+    // matrix, so a row of tiles always covers whole rows of cells.
+    static const int TILE_WIDTH = 16;
+    static const int TILE_HEIGHT = 8;
+
+    TileHasher();
+
+    /**
+     * @brief Hashes `image` and marks the tiles that differ from the last update.
+     * @return Number of dirty tiles.
+     */
+    size_t update(const ImageView& image);
+
+    // Makes every tile dirty on the next update (e.g. after the screen was redrawn)
+    void reset() { hashes_.clear(); }
+
+    // Size of the image last hashed, in pixels
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // Tiles across and down
+    int columns() const { return columns_; }
+    int rows() const { return rows_; }
+
+    bool dirty(int column, int row) const { return dirty_[static_cast<size_t>(row) * columns_ + column] != 0; }
+    // True if any tile in tile row `row` changed
+    bool row_dirty(int row) const { return row_dirty_[row] != 0; }
+
+    // Dirty tiles as a fraction of all tiles; 0 when nothing changed
+    double dirty_fraction() const { return dirty_.empty() ? 0.0 : static_cast<double>(dirty_count_) / dirty_.size(); }
+
+private:
+    TileRowFn tile_row_;
+    int width_ = 0;
+    int height_ = 0;
+    PixelFormat format_ = PixelFormat::Bgra;
+    int columns_ = 0;
+    int rows_ = 0;
+    std::vector<uint64_t> hashes_;  // last update's hashes, two words per tile, row-major
+    std::vector<uint64_t> current_; // scratch: this update's hashes
+    std::vector<uint8_t> dirty_;
+    std::vector<uint8_t> row_dirty_;
+    size_t dirty_count_ = 0;
+};
@@ -0,0 +1,150 @@
+#include "tone.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "shape_table.h"
+
+bool parse_tone_mode(const char* name, ToneMode& mode) {
+    if (std::strcmp(name, "none") == 0) {
+        mode = ToneMode::Off;
+    } else if (std::strcmp(name, "auto") == 0) {
+        mode = ToneMode::Auto;
+    } else if (std::strcmp(name, "equalize") == 0) {
+        mode = ToneMode::Equalize;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+// sRGB transfer curve: linear light (0..1) to the encoded level (0..1)
+double srgb_encode(double linear) {
+    return linear <= 0.0031308 ? 12.92 * linear : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+}
+
+// A run of glyphs sharing one level after the monotone fit
+struct Block {
+    double level;
+    size_t first;
+    size_t count;
+};
+
+} // namespace
+
+LevelTable ink_levels(const std::vector<uint32_t>& glyphs) {
+    const size_t count = glyphs.size() < 256 ? glyphs.size() : 256;
+    std::vector<double> ink(count);
+    double least = 1.0;
+    double most = 0.0;
+    for (size_t g = 0; g < count; ++g) {
+        ink[g] = ink_coverage(glyphs[g]);
+        if (ink[g] < 0.0) return linear_levels(count);
+        least = ink[g] < least ? ink[g] : least;
+        most = ink[g] > most ? ink[g] : most;
+    }
+    if (count < 2 || most - least < 1e-9) return linear_levels(count);
+
+    // The level each glyph looks like, with the ramp's inkiest glyph as black and its
+    // lightest as white. Pool adjacent violators: a glyph darker than the one before it is
+    // averaged with it, which gives the closest levels that rise along the ramp
+    std::vector<Block> blocks;
+    for (size_t g = 0; g < count; ++g) {
+        const double paper = 1.0 - (ink[g] - least) / (most - least);
+        blocks.push_back({255.0 * srgb_encode(paper), g, 1});
+        while (blocks.size() > 1 && blocks[blocks.size() - 2].level >= blocks.back().level) {
+            const Block last = blocks.back();
+            blocks.pop_back();
+            Block& merged = blocks.back();
+            merged.level = (merged.level * merged.count + last.level * last.count) / (merged.count + last.count);
+            merged.count += last.count;
+        }
+    }
+
+    // Each level takes the nearest block; the glyphs of a block split its levels evenly
+    LevelTable levels{};
+    size_t b = 0;
+    for (int v = 0; v < 256; ++v) {
+        const double center = v + 0.5;
+        while (b + 1 < blocks.size() && center >= (blocks[b].level + blocks[b + 1].level) / 2) ++b;
+        const double low = b == 0 ? 0.0 : (blocks[b - 1].level + blocks[b].level) / 2;
+        const double high = b + 1 == blocks.size() ? 256.0 : (blocks[b].level + blocks[b + 1].level) / 2;
+        size_t g = static_cast<size_t>((center - low) / (high - low) * blocks[b].count);
+        if (g >= blocks[b].count) g = blocks[b].count - 1;
+        levels[v] = static_cast<uint8_t>(blocks[b].first + g);
+    }
+    return levels;
+}
+
+ToneCurve::ToneCurve(ToneMode mode) : mode_(mode) {
+    for (int v = 0; v < 256; ++v) curve_[v] = static_cast<uint8_t>(v);
+}
+
+bool ToneCurve::update(const uint32_t* histogram) {
+    if (mode_ == ToneMode::Off) return false;
+    uint64_t total = 0;
+    for (int v = 0; v < 256; ++v) total += histogram[v];
+    if (total == 0) return false;
+
+    // Bolt: Compare distributions before building anything; on a steady screen this is
+    // the only work per frame
+    if (built_) {
+        double change = 0.0;
+        uint64_t below = 0;
+        for (int v = 0; v < 256; ++v) {
+            below += histogram[v];
+            const double difference = std::fabs(static_cast<double>(below) / total - cdf_[v]);
+            change = difference > change ? difference : change;
+        }
+        if (change <= MIN_CHANGE) return false;
+    }
+    const LevelTable previous = curve_;
+    build(histogram, total);
+    return curve_ != previous;
+}
+
+void ToneCurve::build(const uint32_t* histogram, uint64_t total) {
+    uint64_t below = 0;
+    for (int v = 0; v < 256; ++v) {
+        below += histogram[v];
+        cdf_[v] = static_cast<double>(below) / total;
+    }
+    built_ = true;
+
+    if (mode_ == ToneMode::Auto) {
+        // The levels below which, and above which, CLIP of the pixels lie
+        int low = 0;
+        while (low < 255 && cdf_[low] <= CLIP) ++low;
+        int high = 255;
+        while (high > 0 && cdf_[high - 1] >= 1.0 - CLIP) --high;
+        if (high - low < MIN_SPAN) {
+            // Too little range to stretch: widen it around its middle, within 0..255
+            const int middle = (low + high) / 2;
+            low = middle - MIN_SPAN / 2 < 0 ? 0 : middle - MIN_SPAN / 2;
+            low = low + MIN_SPAN > 255 ? 255 - MIN_SPAN : low;
+            high = low + MIN_SPAN;
+        }
+        for (int v = 0; v < 256; ++v) {
+            const int level = (v - low) * 255 / (high - low);
+            curve_[v] = static_cast<uint8_t>(level < 0 ? 0 : level > 255 ? 255 : level);
+        }
+        return;
+    }
+
+    // Equalize with each count clipped to EQUALIZE_LIMIT times the mean and the excess
+    // spread over every level, so a large flat background doesn't take most of the range
+    const double limit = static_cast<double>(total) * EQUALIZE_LIMIT / 256;
+    double excess = 0.0;
+    for (int v = 0; v < 256; ++v) excess += histogram[v] > limit ? histogram[v] - limit : 0.0;
+    const double spread = excess / 256;
+    double sum = 0.0;
+    for (int v = 0; v < 256; ++v) {
+        const double clipped = (histogram[v] > limit ? limit : histogram[v]) + spread;
+        // Each level maps to the middle of its share of the range
+        const double level = 255.0 * (sum + clipped / 2) / total;
+        curve_[v] = static_cast<uint8_t>(level + 0.5 > 255 ? 255 : level + 0.5);
+        sum += clipped;
+    }
+}
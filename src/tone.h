@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "glyph_table.h"
+
+// How the gray levels of a frame are stretched before they pick glyphs
+enum class ToneMode {
+    Off,      // levels as captured
+    Auto,     // auto-levels: the frame's darkest and lightest levels become black and white
+    Equalize, // histogram equalization, contrast-limited so flat areas don't turn to noise
+};
+
+/**
+ * @brief Parses "none", "auto" or "equalize"; returns false if unknown.
+ */
+bool parse_tone_mode(const char* name, ToneMode& mode);
+
+/**
+ * @brief Gray levels to glyphs of `glyphs`, placed by how much of the cell each one inks
+ * rather than evenly by their position in the ramp.
+ *
+ * A glyph's ink coverage gives the share of light the cell reflects, which goes through
+ * the sRGB transfer curve to the gray level it looks like; each level then takes the glyph
+ * nearest to it. Ramps run from most ink to least, and a glyph that inks more than the one
+ * before it shares that glyph's level (a monotone fit), so the ramp order is kept. Ramps
+ * with glyphs the built-in font does not have keep linear_levels().
+ */
+LevelTable ink_levels(const std::vector<uint32_t>& glyphs);
+
+/**
+ * @brief The level-to-level curve of the next frame, built from the luma histogram of the
+ * frames converted so far.
+ *
+ * The curve only follows the histogram once it has moved by more than MIN_CHANGE (the
+ * largest difference between the two cumulative distributions), so small changes such as
+ * a clock ticking or a cursor blinking don't re-map, and redraw, the whole screen.
+ */
+class ToneCurve {
+public:
+    // Share of the pixels that must have changed level before the curve is rebuilt
+    static constexpr double MIN_CHANGE = 0.02;
+    // Share of the pixels auto-levels lets clip at each end
+    static constexpr double CLIP = 0.005;
+    // Fewest levels auto-levels stretches to the full range, so a blank screen stays flat
+    static const int MIN_SPAN = 32;
+    // Equalization limits each level's count to this multiple of the mean count
+    static const int EQUALIZE_LIMIT = 4;
+
+    explicit ToneCurve(ToneMode mode = ToneMode::Off);
+
+    ToneMode mode() const { return mode_; }
+
+    // Level of the next frame for each level captured; the identity until update()
+    const LevelTable& curve() const { return curve_; }
+
+    /**
+     * @brief Takes the LEVEL_BINS-count luma histogram of a frame.
+     * @return True if the curve changed, so frames converted with the old one are stale.
+     */
+    bool update(const uint32_t* histogram);
+
+private:
+    void build(const uint32_t* histogram, uint64_t total);
+
+    ToneMode mode_;
+    LevelTable curve_;
+    std::array<double, 256> cdf_{}; // cumulative share of the histogram curve_ was built from
+    bool built_ = false;
+};
@@ -0,0 +1,447 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Checks that every fast path of the render library produces exactly what its reference
+// does: the SIMD kernels against the scalar ones, other pixel formats against BGRA, banded
+// conversion against one thread, Floyd-Steinberg against a plain implementation, and diffs
+// against a full redraw. Run by ctest; prints each failed check and exits 1 if there was one.
+#include "diff_output.h"
+#include "dither.h"
+#include "downscale.h"
+#include "glyph_table.h"
+#include "luma_kernels.h"
+#include "render.h"
+#include "synthetic_desktop.h"
+#include "thread_pool.h"
+#include "tile_hash.h"
+#include "tone.h"
+
+namespace {
+
+// Cell grids: a classic terminal, the default grid, and a large terminal on a 4K screen
+const Geometry GRIDS[] = {{80, 24}, {240, 80}, {400, 120}};
+
+// The live loop's status bar, so frames have the same shape as on screen
+const std::string STATUS_LINE = " [ AsciiScreen ] Mode: normal | FPS: 60 | [P]ause [Q]uit";
+
+int g_failures = 0;
+
+/**
+ * @brief Records a failed check when `actual` differs from `expected`.
+ */
+template <typename T>
+void expect_equal(const std::string& name, const T& actual, const T& expected) {
+    if (actual == expected) return;
+    std::cout << "FAIL " << name << std::endl;
+    ++g_failures;
+}
+
+std::string grid_name(const Geometry& grid) {
+    return std::to_string(grid.width) + "x" + std::to_string(grid.height);
+}
+
+ImageView bgra_view(const std::vector<unsigned char>& pixels, int width, int height) {
+    return {pixels.data(), width, height, static_cast<size_t>(width) * 4};
+}
+
+/**
+ * @brief What a terminal shows after drawing text: each cell's glyph and the colors it was
+ * drawn in. Understands what frames and diffs contain: cursor positioning, SGR colors, UTF-8
+ * glyphs and line breaks.
+ */
+class TerminalModel {
+public:
+    void draw(const std::string& text) {
+        for (size_t i = 0; i < text.size();) {
+            if (text[i] == '\n') {
+                ++row_;
+                col_ = 0;
+                ++i;
+            } else if (text[i] == '\r') {
+                col_ = 0;
+                ++i;
+            } else if (text[i] == '\033' && i + 1 < text.size() && text[i + 1] == '[') {
+                size_t end = i + 2;
+                while (end < text.size() && (text[end] < 0x40 || text[end] > 0x7E)) ++end;
+                if (end == text.size()) break;
+                escape(text.substr(i + 2, end - i - 2), text[end]);
+                i = end + 1;
+            } else {
+                size_t length = 1;
+                while (i + length < text.size() && (static_cast<unsigned char>(text[i + length]) & 0xC0) == 0x80) {
+                    ++length;
+                }
+                cells_[{row_, col_++}] = {text.substr(i, length), fore_, back_};
+                i += length;
+            }
+        }
+    }
+
+    bool operator==(const TerminalModel& other) const { return cells_ == other.cells_; }
+
+private:
+    struct Cell {
+        std::string glyph;
+        std::string fore;
+        std::string back;
+        bool operator==(const Cell& other) const {
+            return glyph == other.glyph && fore == other.fore && back == other.back;
+        }
+    };
+
+    void escape(const std::string& params, char final) {
+        if (final == 'H') {
+            const size_t separator = params.find(';');
+            row_ = params.empty() ? 0 : std::atoi(params.c_str()) - 1;
+            col_ = separator == std::string::npos ? 0 : std::atoi(params.c_str() + separator + 1) - 1;
+        } else if (final == 'm') {
+            if (params.empty() || params == "0") {
+                fore_.clear();
+                back_.clear();
+            } else if (params[0] == '4' || params.compare(0, 2, "10") == 0) {
+                back_ = params;
+            } else {
+                fore_ = params;
+            }
+        }
+    }
+
+    std::map<std::pair<int, int>, Cell> cells_;
+    int row_ = 0;
+    int col_ = 0;
+    std::string fore_;
+    std::string back_;
+};
+
+/**
+ * @brief Draws `from`, then what FrameDiffer sends to turn it into `to`, and checks the
+ * terminal then shows what drawing `to` in full would.
+ */
+void expect_diff_redraws(const std::string& name, const std::string& from, const std::string& to) {
+    FrameDiffer differ;
+    std::vector<DiffRun> runs;
+    differ.diff(from, runs);
+    std::string encoded = "\033[H" + to;
+    if (differ.diff(to, runs)) {
+        encoded.clear();
+        append_ansi_runs(to, runs, encoded);
+    }
+    TerminalModel shown;
+    TerminalModel expected;
+    shown.draw("\033[H" + from);
+    shown.draw(encoded);
+    expected.draw("\033[H" + to);
+    expect_equal(name, shown, expected);
+}
+
+struct Desktop {
+    std::vector<unsigned char> pixels = synthetic_desktop(0);
+    std::vector<unsigned char> next = synthetic_desktop(1);
+    ImageView view() const { return bgra_view(pixels, DESKTOP_WIDTH, DESKTOP_HEIGHT); }
+    ImageView next_view() const { return bgra_view(next, DESKTOP_WIDTH, DESKTOP_HEIGHT); }
+};
+
+// Packed RGB, as a decoder hands frames over, scales to the same cells as BGRA
+void test_scale_formats(const Desktop& desktop, AreaDownscaler& scaler) {
+    std::vector<unsigned char> rgb(static_cast<size_t>(DESKTOP_WIDTH) * DESKTOP_HEIGHT * 3);
+    for (size_t i = 0; i < rgb.size() / 3; ++i) {
+        rgb[i * 3] = desktop.pixels[i * 4 + 2];
+        rgb[i * 3 + 1] = desktop.pixels[i * 4 + 1];
+        rgb[i * 3 + 2] = desktop.pixels[i * 4];
+    }
+    const ImageView rgb_view = {rgb.data(), DESKTOP_WIDTH, DESKTOP_HEIGHT, static_cast<size_t>(DESKTOP_WIDTH) * 3,
+                                PixelFormat::Rgb24};
+    for (const Geometry& grid : GRIDS) {
+        std::vector<unsigned char> cells(static_cast<size_t>(grid.width) * grid.height * 4);
+        std::vector<unsigned char> cells_rgb(cells.size());
+        scaler.scale(desktop.view(), grid.width, grid.height, cells.data());
+        scaler.scale(rgb_view, grid.width, grid.height, cells_rgb.data());
+        expect_equal("scale/rgb24/" + grid_name(grid), cells_rgb, cells);
+    }
+}
+
+// Conversion split into bands over 1, 2 and 4 threads comes out exactly as on the calling
+// thread alone
+void test_banded_conversion(const Desktop& desktop, AreaDownscaler& scaler) {
+    struct CellCase { const char* name; CellMode cells; ColorMode color; };
+    std::vector<char> buffer;
+    for (const Geometry& grid : GRIDS) {
+        for (const CellCase& c : {CellCase{"truecolor", CellMode::Ramp, ColorMode::Rgb24},
+                                  CellCase{"shapes", CellMode::Shape, ColorMode::Mono},
+                                  CellCase{"braille", CellMode::Braille, ColorMode::Mono}}) {
+            Renderer renderer(find_ramp("normal")->glyphs, GlyphEncoding::Utf8, c.color, ColorLayer::Foreground, c.cells);
+            const Geometry samples = renderer.image_size(grid);
+            std::vector<unsigned char> sampled(static_cast<size_t>(samples.width) * samples.height * 4);
+            scaler.scale(desktop.view(), samples.width, samples.height, sampled.data());
+            const ImageView picture = bgra_view(sampled, samples.width, samples.height - renderer.cell_height());
+            buffer.resize(renderer.max_frame_bytes(picture.width, picture.height, true));
+            const std::string expected(buffer.data(),
+                                       renderer.render(picture, buffer.data(), buffer.size(), &STATUS_LINE));
+            for (size_t threads : {1, 2, 4}) {
+                ThreadPool pool(threads);
+                renderer.set_pool(&pool);
+                const size_t length = renderer.render(picture, buffer.data(), buffer.size(), &STATUS_LINE);
+                expect_equal(std::string("convert/threads-") + std::to_string(threads) + "/" + c.name + "/" +
+                                 grid_name(grid),
+                             std::string(buffer.data(), length), expected);
+                renderer.set_pool(nullptr);
+            }
+        }
+    }
+}
+
+// Colored half blocks set two colors per cell; the diff has to follow both
+void test_diff_halfblock(const Desktop& desktop, AreaDownscaler& scaler) {
+    for (const Geometry& grid : GRIDS) {
+        Renderer half(find_ramp("normal")->glyphs, GlyphEncoding::Utf8, ColorMode::Rgb24, ColorLayer::Foreground,
+                      CellMode::HalfBlock);
+        const Geometry samples = half.image_size(grid);
+        std::vector<unsigned char> cells(static_cast<size_t>(samples.width) * samples.height * 4);
+        std::vector<unsigned char> cells_next(cells.size());
+        scaler.scale(desktop.view(), samples.width, samples.height, cells.data());
+        scaler.scale(desktop.next_view(), samples.width, samples.height, cells_next.data());
+        const int height = samples.height - half.cell_height();
+        std::string frame;
+        std::string frame_next;
+        half.render(bgra_view(cells, samples.width, height), frame, &STATUS_LINE);
+        half.render(bgra_view(cells_next, samples.width, height), frame_next, &STATUS_LINE);
+        expect_diff_redraws("output/diff-halfblock/" + grid_name(grid), frame, frame_next);
+    }
+
+    // A half-block row where only the first cell's upper color changes: its background
+    // escape is the same in both frames, the cell is not
+    std::string before;
+    std::string after;
+    for (int x = 0; x < 40; ++x) {
+        const std::string back = "\033[48;2;0;0;" + std::to_string(x) + "m\xE2\x96\x80";
+        before += "\033[38;2;" + std::to_string(x) + ";0;0m" + back;
+        after += (x ? "\033[38;2;" + std::to_string(x) + ";0;0m" : std::string("\033[38;2;255;255;255m")) + back;
+    }
+    expect_diff_redraws("output/diff-halfblock/foreground-only", before, after);
+}
+
+// Each SIMD kernel produces exactly what the scalar one does, and every pixel format the
+// same text as BGRA; the counting cases also count every cell's level
+void test_row_kernels(const Desktop& desktop, AreaDownscaler& scaler) {
+    struct KernelCase { const char* name; PixelFormat format; AsciiRowFn fn; bool count; };
+    std::vector<KernelCase> kernels = {{"scalar", PixelFormat::Bgra, ascii_row_scalar<PixelFormat::Bgra>, false}};
+    kernels.push_back({"scalar-counted", PixelFormat::Bgra, ascii_row_scalar<PixelFormat::Bgra>, true});
+#ifdef SCRN_X86
+    kernels.push_back({"sse2", PixelFormat::Bgra, ascii_row_sse2<PixelFormat::Bgra>, false});
+    kernels.push_back({"sse2-counted", PixelFormat::Bgra, ascii_row_sse2<PixelFormat::Bgra>, true});
+    if (cpu_has_avx2()) {
+        kernels.push_back({"avx2", PixelFormat::Bgra, ascii_row_avx2<PixelFormat::Bgra>, false});
+        kernels.push_back({"avx2-counted", PixelFormat::Bgra, ascii_row_avx2<PixelFormat::Bgra>, true});
+    }
+    kernels.push_back({"rgba-sse2", PixelFormat::Rgba, ascii_row_sse2<PixelFormat::Rgba>, false});
+    if (cpu_has_avx2()) kernels.push_back({"rgba-avx2", PixelFormat::Rgba, ascii_row_avx2<PixelFormat::Rgba>, false});
+#endif
+    kernels.push_back({"rgb24-scalar", PixelFormat::Rgb24, ascii_row_scalar<PixelFormat::Rgb24>, false});
+    kernels.push_back({"gray8-scalar", PixelFormat::Gray8, ascii_row_scalar<PixelFormat::Gray8>, false});
+
+    const Geometry grid = GRIDS[1];
+    const size_t pixels = static_cast<size_t>(grid.width) * grid.height;
+    std::vector<unsigned char> cells(pixels * 4);
+    scaler.scale(desktop.view(), grid.width, grid.height, cells.data());
+    // The same cells in every format
+    std::vector<unsigned char> formats[PIXEL_FORMATS];
+    formats[static_cast<int>(PixelFormat::Bgra)] = cells;
+    std::vector<unsigned char>& rgba = formats[static_cast<int>(PixelFormat::Rgba)];
+    std::vector<unsigned char>& rgb = formats[static_cast<int>(PixelFormat::Rgb24)];
+    std::vector<unsigned char>& gray = formats[static_cast<int>(PixelFormat::Gray8)];
+    rgba.resize(pixels * 4);
+    rgb.resize(pixels * 3);
+    gray.resize(pixels);
+    for (size_t i = 0; i < pixels; ++i) {
+        const unsigned char* p = &cells[i * 4];
+        const unsigned char swapped[4] = {p[2], p[1], p[0], p[3]};
+        std::memcpy(&rgba[i * 4], swapped, 4);
+        std::memcpy(&rgb[i * 3], swapped, 3);
+    }
+    luma_row_scalar<PixelFormat::Bgra>(cells.data(), pixels, gray.data());
+
+    std::vector<uint32_t> levels(LEVEL_HISTOGRAMS * LEVEL_BINS);
+    std::vector<uint32_t> expected_levels(LEVEL_BINS);
+    std::vector<uint32_t> counted(LEVEL_BINS);
+    count_levels(gray.data(), pixels, levels.data());
+    fold_levels(levels.data(), expected_levels.data());
+
+    const GlyphTable table(find_ramp("normal")->glyphs);
+    const size_t row_stride = grid.width + 1;
+    std::string expected;
+    for (const KernelCase& k : kernels) {
+        const unsigned char* source = formats[static_cast<int>(k.format)].data();
+        const size_t source_stride = grid.width * bytes_per_pixel(k.format);
+        std::string frame(row_stride * grid.height, '\n');
+        for (int y = 0; y < grid.height; ++y) {
+            k.fn(source + y * source_stride, grid.width, table.ascii_lut(), &frame[y * row_stride],
+                 k.count ? levels.data() : nullptr);
+        }
+        if (k.count) {
+            fold_levels(levels.data(), counted.data());
+            expect_equal(std::string("kernel/") + k.name + "/histogram", counted, expected_levels);
+        }
+        if (expected.empty()) expected = frame;
+        expect_equal(std::string("kernel/") + k.name, frame, expected);
+    }
+}
+
+// The braille packing kernels against the scalar one, on 2x4 samples per cell
+void test_braille_kernels(const Desktop& desktop, AreaDownscaler& scaler) {
+    struct BrailleCase { const char* name; BrailleRowFn fn; };
+    std::vector<BrailleCase> packers = {{"scalar", braille_row_scalar}};
+#ifdef SCRN_X86
+    packers.push_back({"sse2", braille_row_sse2});
+    if (cpu_has_avx2()) packers.push_back({"avx2", braille_row_avx2});
+#endif
+    const Geometry grid = GRIDS[1];
+    const int samples = grid.width * 2;
+    std::vector<unsigned char> pixels(static_cast<size_t>(samples) * grid.height * 4 * 4);
+    scaler.scale(desktop.view(), samples, grid.height * 4, pixels.data());
+    std::vector<unsigned char> luma(static_cast<size_t>(samples) * grid.height * 4);
+    for (int y = 0; y < grid.height * 4; ++y) {
+        luma_row_scalar<PixelFormat::Bgra>(&pixels[static_cast<size_t>(y) * samples * 4], samples,
+                                           &luma[static_cast<size_t>(y) * samples]);
+    }
+    std::vector<unsigned char> expected;
+    for (const BrailleCase& k : packers) {
+        std::vector<unsigned char> patterns(static_cast<size_t>(grid.width) * grid.height);
+        for (int y = 0; y < grid.height; ++y) {
+            const unsigned char* rows[4];
+            for (int r = 0; r < 4; ++r) rows[r] = &luma[static_cast<size_t>(y * 4 + r) * samples];
+            k.fn(rows, grid.width, Renderer::DOT_THRESHOLD, &patterns[static_cast<size_t>(y) * grid.width]);
+        }
+        if (expected.empty()) expected = patterns;
+        expect_equal(std::string("kernel/braille-") + k.name, patterns, expected);
+    }
+}
+
+// The tile hashing kernels against the scalar one, over the desktop itself
+void test_tile_kernels(const Desktop& desktop) {
+    struct TileCase { const char* name; TileRowFn fn; };
+    std::vector<TileCase> hashers = {{"scalar", tile_row_scalar}};
+#ifdef SCRN_X86
+    hashers.push_back({"sse2", tile_row_sse2});
+    if (cpu_has_avx2()) hashers.push_back({"avx2", tile_row_avx2});
+#endif
+    const size_t columns = DESKTOP_WIDTH / TileHasher::TILE_WIDTH;
+    const uint64_t keys[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    const ImageView view = desktop.view();
+    std::vector<uint64_t> expected;
+    for (const TileCase& k : hashers) {
+        std::vector<uint64_t> hashes(columns * 2);
+        for (int y = 0; y < DESKTOP_HEIGHT; ++y) k.fn(view.row(y), columns, keys, hashes.data());
+        if (expected.empty()) expected = hashes;
+        expect_equal(std::string("kernel/tiles-") + k.name, hashes, expected);
+    }
+}
+
+/**
+ * @brief Textbook Floyd-Steinberg over a plain `width` x `height` plane, each pixel scattering
+ * its error right and into the row below, in the 8.8 arithmetic DiffusionRamp describes.
+ */
+void diffuse_reference(const DiffusionRamp& ramp, unsigned char* plane, int width, int height) {
+    // 16-bit lane arithmetic: unsigned multiply-high, and rounding signed multiply-high
+    auto mulhi = [](int a, int b) { return static_cast<int>((static_cast<uint32_t>(a) & 0xFFFF) * b >> 16); };
+    auto mulhrs = [](int a, int b) { return (static_cast<int16_t>(a) * b + 0x4000) >> 15; };
+    const size_t padded = static_cast<size_t>(width) + 2;
+    std::vector<int> errors((static_cast<size_t>(height) + 1) * padded);
+    for (int y = 0; y < height; ++y) {
+        unsigned char* row = plane + static_cast<size_t>(y) * width;
+        const int* in = &errors[y * padded + 1];
+        int* below = &errors[(y + 1) * padded + 1];
+        int carry = 0;
+        for (int x = 0; x < width; ++x) {
+            const int sum = (mulhi(row[x] << 8, ramp.scale) + in[x] + carry) & 0xFFFF;
+            const int fraction = static_cast<int16_t>((sum & 0xFF) << 8);
+            const int glyph = (sum + 128) & 0xFF00;
+            row[x] = static_cast<unsigned char>(std::min(mulhi(glyph | 0xFF, ramp.snap_scale) >> ramp.snap_shift, 255));
+            carry = mulhrs(fraction, 56);
+            below[x - 1] += mulhrs(fraction, 24);
+            below[x] += mulhrs(fraction, 40);
+            below[x + 1] += mulhrs(fraction, 8);
+        }
+    }
+}
+
+// Every Floyd-Steinberg kernel, on one thread and on a pool, matches the reference: on
+// planes narrower and wider than a lane kernel's lead, and heights that leave the last
+// strip partly filled. Only the pixels of the plane change, not the bytes past its width.
+void test_diffusion_kernels() {
+    struct DiffusionCase { const char* name; DiffusionKernel kernel; };
+    std::vector<DiffusionCase> kernels = {{"scalar", {diffuse_strip_scalar, 1}}};
+#ifdef SCRN_X86
+    kernels.push_back({"sse2", {diffuse_strip_sse2, 16}});
+    if (cpu_has_avx2()) kernels.push_back({"avx2", {diffuse_strip_avx2, 32}});
+#endif
+    const Geometry sizes[] = {{1, 1},  {5, 40},  {16, 16}, {33, 17},  {47, 3},   {80, 24},
+                              {93, 70}, {94, 65}, {95, 33}, {96, 64}, {241, 79}, {400, 120}};
+    ThreadPool pool(4);
+    std::mt19937 rng(7);
+    for (int levels : {2, 3, 5, 10, 17, 70, 255}) {
+        const DiffusionRamp ramp(levels);
+        for (const Geometry& size : sizes) {
+            // Noise over a gradient, so errors of every size and sign occur
+            const size_t pixels = static_cast<size_t>(size.width) * size.height;
+            std::vector<unsigned char> source(pixels);
+            for (size_t i = 0; i < pixels; ++i) {
+                source[i] = static_cast<unsigned char>(i % 3 ? i * 7 / (size.width + 1) : rng());
+            }
+            std::vector<unsigned char> expected = source;
+            diffuse_reference(ramp, expected.data(), size.width, size.height);
+
+            const size_t stride = static_cast<size_t>(size.width) * 2;
+            for (const DiffusionCase& k : kernels) {
+                for (ThreadPool* threads : {static_cast<ThreadPool*>(nullptr), &pool}) {
+                    Ditherer ditherer(DitherMode::FloydSteinberg, levels, threads);
+                    ditherer.set_diffusion_kernel(k.kernel);
+                    std::vector<unsigned char> plane(stride * size.height, 0xAB);
+                    for (int y = 0; y < size.height; ++y) {
+                        std::memcpy(&plane[y * stride], &source[y * static_cast<size_t>(size.width)], size.width);
+                    }
+                    ditherer.apply(plane.data(), stride, size.width, size.height);
+                    std::vector<unsigned char> diffused(pixels);
+                    bool padding_intact = true;
+                    for (int y = 0; y < size.height; ++y) {
+                        const unsigned char* row = &plane[y * stride];
+                        std::memcpy(&diffused[y * static_cast<size_t>(size.width)], row, size.width);
+                        for (int x = size.width; x < size.width * 2; ++x) padding_intact &= row[x] == 0xAB;
+                    }
+                    const std::string name = std::string("kernel/fs-") + k.name + (threads ? "-pool/" : "/") +
+                                             std::to_string(levels) + "-levels/" + grid_name(size);
+                    expect_equal(name, diffused, expected);
+                    expect_equal(name + "/padding", padding_intact, true);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    const Desktop desktop;
+    ThreadPool pool;
+    AreaDownscaler scaler(&pool);
+
+    test_scale_formats(desktop, scaler);
+    test_banded_conversion(desktop, scaler);
+    test_diff_halfblock(desktop, scaler);
+    test_row_kernels(desktop, scaler);
+    test_braille_kernels(desktop, scaler);
+    test_tile_kernels(desktop);
+    test_diffusion_kernels();
+
+    if (g_failures) {
+        std::cout << g_failures << " check(s) failed." << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed." << std::endl;
+    return 0;
+}